@@ -57,5 +57,13 @@ ISR(AC0_AC_vect)
 	LowBattery();
 }
 
+#if DEF_UART_COMMAND_ENABLE == 1u
+ISR(USART0_RXC_vect)
+{
+	/* reading RXDATAL clears the receive complete flag */
+	cmd_rx_byte(USART0.RXDATAL);
+}
+#endif
+
 
 
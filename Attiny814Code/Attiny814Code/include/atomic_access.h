@@ -0,0 +1,75 @@
+/*============================================================================
+Filename : atomic_access.h
+Project : Attiny814Code
+Purpose : Atomic reads and writes of the 16 and 32-bit variables shared
+          between an interrupt and the main loop. The AVR moves one byte at
+          a time, an interrupt between the bytes sees or leaves a torn
+          value. Each helper only holds the interrupts off for the move
+          itself, ENTER_CRITICAL() / EXIT_CRITICAL() of atomic.h around 2
+          or 4 byte loads or stores: about 11 cycles for 16 bits and 17
+          for 32 bits from the cli to the SREG restore.
+
+          Only the side that can be interrupted needs them: a level 0
+          handler is not preempted by the main loop, its own accesses are
+          atomic already. Hardware independent, plain accesses on the host.
+============================================================================*/
+
+#ifndef ATOMIC_ACCESS_H
+#define ATOMIC_ACCESS_H
+
+#include <stdint.h>
+
+#ifdef __AVR__
+#include <atomic.h>
+#define ATOMIC_ACCESS_ENTER() ENTER_CRITICAL(A)
+#define ATOMIC_ACCESS_EXIT() EXIT_CRITICAL(A)
+#else
+#define ATOMIC_ACCESS_ENTER()
+#define ATOMIC_ACCESS_EXIT()
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline uint16_t atomic_read16(const volatile uint16_t *value)
+{
+	uint16_t result;
+
+	ATOMIC_ACCESS_ENTER();
+	result = *value;
+	ATOMIC_ACCESS_EXIT();
+
+	return result;
+}
+
+static inline void atomic_write16(volatile uint16_t *value, uint16_t data)
+{
+	ATOMIC_ACCESS_ENTER();
+	*value = data;
+	ATOMIC_ACCESS_EXIT();
+}
+
+static inline uint32_t atomic_read32(const volatile uint32_t *value)
+{
+	uint32_t result;
+
+	ATOMIC_ACCESS_ENTER();
+	result = *value;
+	ATOMIC_ACCESS_EXIT();
+
+	return result;
+}
+
+static inline void atomic_write32(volatile uint32_t *value, uint32_t data)
+{
+	ATOMIC_ACCESS_ENTER();
+	*value = data;
+	ATOMIC_ACCESS_EXIT();
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ATOMIC_ACCESS_H */
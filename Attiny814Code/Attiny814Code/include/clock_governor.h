@@ -0,0 +1,70 @@
+/*============================================================================
+Filename : clock_governor.h
+Project : Attiny814Code
+Purpose : Picks the CPU clock the work in flight needs. Work that needs the
+          full clock holds a lock, the PTC acquisition up to the end of the
+          detection for one; without a lock, and with the USART idle, the
+          main loop drops to the low clock before it sleeps. Housekeeping
+          of the RTC interrupt and its busy-waits then run slow, at the
+          same wall time for a fraction of the energy. The valve pulse of
+          a tap runs at F_CPU, the clock only drops after it.
+
+          The clock never switches while the USART sends or receives, the
+          baud rate would change in the middle of a byte. clock_lock()
+          tells whether the clock is up, the PTC acquisition waits for it.
+
+          The prescaler of MCLKCTRLB moves between 2 (F_CPU, 10 MHz) and
+          2 << CLOCK_LOW_SHIFT. The USART baud register is scaled with it.
+          _delay_ms() counts F_CPU cycles, delays that may run at the low
+          clock use clock_delay_ms() instead.
+============================================================================*/
+
+#ifndef CLOCK_GOVERNOR_H
+#define CLOCK_GOVERNOR_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* Enable / Disable the low clock, the CPU stays at F_CPU when disabled.
+ * Off until its flash and current are measured on the target.
+ * Range: 0u or 1u
+ * Default value: 0u
+ */
+#ifndef DEF_CLOCK_GOVERNOR_ENABLE
+#define DEF_CLOCK_GOVERNOR_ENABLE 0u
+#endif
+
+/* Low clock, F_CPU >> shift. The USART baud register has to stay at 64 or
+ * more, 2 is the limit at 115200 baud.
+ * Range: 1 to 2
+ * Default value: 2 (2.5 MHz)
+ */
+#define CLOCK_LOW_SHIFT 2
+
+/* Locks, each keeps the CPU at F_CPU until released */
+#define CLOCK_LOCK_PTC 0x01u /* acquisition and detection, the PTC timing */
+
+/* Clock levels */
+#define CLOCK_FULL 0u
+#define CLOCK_LOW 1u
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *----------------------------------------------------------------------------*/
+uint8_t clock_lock(uint8_t lock);
+void    clock_unlock(uint8_t lock);
+void    clock_governor_update(void);
+uint8_t clock_governor_level(void);
+void    clock_delay_ms(uint16_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CLOCK_GOVERNOR_H */
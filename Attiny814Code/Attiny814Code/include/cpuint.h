@@ -34,6 +34,21 @@
 extern "C" {
 #endif
 
+/* Vector number of the interrupt at level 1, it preempts every level 0
+ * handler; 0 for none. The PTC end of conversion by default: a late EOC
+ * stretches the acquisition, the RTC handler runs the 4 ms battery check.
+ * Range: 0, 3 to 25
+ * Default value: ADC0_RESRDY_vect_num
+ */
+#define CPUINT_LVL1_VECTOR ADC0_RESRDY_vect_num
+
+/* Round-robin scheduling of the level 0 interrupts, otherwise the lower
+ * vector number wins
+ * Range: 0 / 1
+ * Default value: 0
+ */
+#define CPUINT_LVL0_ROUND_ROBIN 0
+
 int8_t CPUINT_init();
 
 #ifdef __cplusplus
@@ -36,6 +36,9 @@
 #ifndef DRIVER_INIT_H_INCLUDED
 #define DRIVER_INIT_H_INCLUDED
 
+/* ahead of the includes: touch.h, included from here, reads it */
+#define _DEBUG
+
 #include <compiler.h>
 #include <clock_config.h>
 #include <port.h>
@@ -54,16 +57,20 @@
 #include "touch.h"
 #include <ac.h>
 #include <vref.h>
+#include "uart_command.h"
+#include "sleep_governor.h"
+#include "clock_governor.h"
+#include "stack_monitor.h"
+#include "touch_detect.h"
 
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define _DEBUG
-
 void system_init(void);
 void RTC_CallBack(void);
+void LowBattery(void);
 int16_t TOUCH_DeltaSmoothing(int16_t curDelta);
 int16_t TOUCH_GetTouchSignal(void);
 void TOUCH_SetMeasureBusyFlag(void);
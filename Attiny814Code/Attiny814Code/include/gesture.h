@@ -0,0 +1,69 @@
+/*============================================================================
+Filename : gesture.h
+Project : Attiny814Code
+Purpose : Gesture recognizer on the edge events of touch_detect.h: tap,
+          double-tap and long-press. Hardware independent, also built on
+          the host for the tests and tracescore.
+
+          A press is a rising edge, its release the next falling edge. A
+          press held fingerOnMinTime..fingerOnMaxTime is a tap, one held
+          longPressTime is a long-press, reported while the finger is
+          still on. A tap followed by a second tap whose press starts
+          within doubleTapWindow after the first release is a double-tap.
+
+          A single tap is reported doubleTapWindow after its release, when
+          no second press has started; with doubleTapWindow 0 double-taps
+          are off and a tap is reported at the release, as the plain touch
+          state machine does. longPressTime 0 turns long-presses off.
+
+          A release is a tap only when the touch state machine does not
+          take it for a false touch, with TOUCH_FUSION_CONFIRM the key
+          module has to have seen the finger as well. A long-press needs
+          the finger still held, touch_detect_held(); a press without one,
+          a water drop or the ringing after a valve pulse, ends at
+          fingerOnMaxTime like in the touch state machine. The timings
+          are clamped to GESTURE_TICKS_MAX RTC periods.
+
+          gesture_sample() runs once per measurement with its edge, result
+          and held state, gesture_tick() once per RTC period from the interrupt.
+          The state is a few bytes, neither function has a loop.
+============================================================================*/
+
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* Gesture of a sample */
+#define GESTURE_NONE 0u
+#define GESTURE_TAP 1u
+#define GESTURE_DOUBLE_TAP 2u
+#define GESTURE_LONG_PRESS 3u
+
+/* RTC periods a gesture can time, the tick counter saturates there */
+#define GESTURE_TICKS_MAX 255u
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *----------------------------------------------------------------------------*/
+uint8_t gesture_sample(uint8_t edge, uint8_t result, uint8_t held);
+void    gesture_tick(void);
+void    gesture_reset(void);
+
+/* tuning parameters, see cmd_param_table; ms, up to GESTURE_TICKS_MAX
+ * RTC periods */
+extern uint16_t doubleTapWindow;
+extern uint16_t longPressTime;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GESTURE_H */
@@ -0,0 +1,73 @@
+/*============================================================================
+Filename : gpio.h
+Project : Attiny814Code
+Purpose : Single instruction access to the application pins on the hot
+          paths: valve drive, battery divider enable and the debug marker.
+          Every pin of the table below expands to an sbi or cbi on its
+          VPORT, in the I/O space. That is one cycle, and no read-modify-write
+          an interrupt could split, so there is never a reason to mask the
+          interrupts around a pin edge. A toggle writes the bit of VPORTx.IN,
+          which flips the output. The result does not depend on the
+          optimization level, unlike the START functions of
+          atmel_start_pins.h.
+
+          The pins are names of the table, not values: gpio_high(VALVE_OPEN).
+          The "I" constraint of the sbi / cbi operands makes a register or
+          bit that is not a compile-time constant a compile error.
+
+          atmel_start_pins.h is overwritten when the START project is
+          reconfigured, this file is kept. The directions and initial levels
+          stay with system_init().
+============================================================================*/
+
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <avr/io.h>
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* Enable / Disable the debug marker output on PA5, which is an input with
+ * pull-up otherwise
+ * Range: 0u or 1u
+ * Default value: 0u
+ */
+#define DEF_GPIO_MARKER_ENABLE 0u
+
+/* Pin table: VPORT letter and bit of every pin */
+#define GPIO_VALVE_OPEN_PORT B /* IO1, pulse opens the valve */
+#define GPIO_VALVE_OPEN_BIT 0
+#define GPIO_VALVE_CLOSE_PORT B /* IO2, pulse closes the valve */
+#define GPIO_VALVE_CLOSE_BIT 1
+#define GPIO_DIVIDER_PORT A /* PA6, battery divider of the AC */
+#define GPIO_DIVIDER_BIT 6
+#define GPIO_MARKER_PORT A /* PA5, debug marker for a scope */
+#define GPIO_MARKER_BIT 5
+
+#define GPIO_VPORT_REG(PORT, REG) GPIO_VPORT_REG_(PORT, REG)
+#define GPIO_VPORT_REG_(PORT, REG) VPORT##PORT##_##REG
+
+#define GPIO_SBI(REG, BIT) __asm__ __volatile__("sbi %0, %1" ::"I"(_SFR_IO_ADDR(REG)), "I"(BIT))
+#define GPIO_CBI(REG, BIT) __asm__ __volatile__("cbi %0, %1" ::"I"(_SFR_IO_ADDR(REG)), "I"(BIT))
+
+/* Output level of a pin of the table */
+#define gpio_high(PIN) GPIO_SBI(GPIO_VPORT_REG(GPIO_##PIN##_PORT, OUT), GPIO_##PIN##_BIT)
+#define gpio_low(PIN) GPIO_CBI(GPIO_VPORT_REG(GPIO_##PIN##_PORT, OUT), GPIO_##PIN##_BIT)
+#define gpio_toggle(PIN) GPIO_SBI(GPIO_VPORT_REG(GPIO_##PIN##_PORT, IN), GPIO_##PIN##_BIT)
+
+/* Direction of a pin of the table */
+#define gpio_output(PIN) GPIO_SBI(GPIO_VPORT_REG(GPIO_##PIN##_PORT, DIR), GPIO_##PIN##_BIT)
+
+/* Debug marker, nothing with DEF_GPIO_MARKER_ENABLE 0 */
+#if DEF_GPIO_MARKER_ENABLE == 1u
+#define gpio_marker_init() gpio_output(MARKER)
+#define gpio_marker_high() gpio_high(MARKER)
+#define gpio_marker_low() gpio_low(MARKER)
+#else
+#define gpio_marker_init()
+#define gpio_marker_high()
+#define gpio_marker_low()
+#endif
+
+#endif /* GPIO_H */
@@ -0,0 +1,78 @@
+/*============================================================================
+Filename : perf_counter.h
+Project : Attiny814Code
+Purpose : Registry of event counters for field diagnostics. Every
+          subsystem counts its events into a fixed slot of one table of
+          16-bit counters; a counter stops at PERF_COUNTER_MAX instead of
+          wrapping, so a large value means "at least". Hardware independent,
+          also built on the host for the tests and tscmd-sim.
+
+          The table sits in .noinit on the device and survives a watchdog
+          or software reset, perf_init() only clears it after a power-on
+          or brown-out reset. A consistent copy of all counters is read
+          with CMD_PERF over the UART command channel, see uart_command.h,
+          and decoded by tscmd.
+============================================================================*/
+
+#ifndef PERF_COUNTER_H
+#define PERF_COUNTER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* Enable / Disable the counter registry, 2 * PERF_COUNT + 2 bytes of RAM.
+ * Off until its size is measured on the target.
+ * Range: 0u or 1u
+ * Default value: 0u
+ */
+#ifndef DEF_PERF_COUNTER_ENABLE
+#define DEF_PERF_COUNTER_ENABLE 0u
+#endif
+
+/* Counters, grouped by the subsystem that counts them */
+/* sleep_governor.c */
+#define PERF_WAKES 0u /* returns from sleep */
+/* qtouch/touch.c */
+#define PERF_ACQUISITIONS 1u /* measurements post processed */
+#define PERF_REBURSTS 2u     /* reburst requests of the key module */
+#define PERF_QTM_ERRORS 3u   /* qtm_error_callback() calls */
+/* touch_detect.c */
+#define PERF_EDGES_RISING 4u
+#define PERF_EDGES_FALLING 5u
+#define PERF_THRESHOLD_UP 6u   /* samples that raised the edge threshold */
+#define PERF_THRESHOLD_DOWN 7u /* samples that lowered it */
+#define PERF_TOUCH_TOO_SHORT 8u
+#define PERF_TOUCH_TOO_LONG 9u
+/* main.c */
+#define PERF_ACTUATIONS 10u    /* valve pulses */
+#define PERF_BATTERY_CHECKS 11u
+#define PERF_WDT_RESETS 12u
+/* datastreamer */
+#define PERF_DS_FRAMES 13u /* frames sent or recorded */
+#define PERF_COUNT 14u
+
+#define PERF_COUNTER_MAX 0xFFFFu
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *----------------------------------------------------------------------------*/
+#if DEF_PERF_COUNTER_ENABLE == 1u
+void perf_init(uint8_t cold);
+void perf_count(uint8_t id);
+#else
+#define perf_init(cold) ((void)0)
+#define perf_count(id) ((void)0)
+#endif
+void perf_snapshot(uint16_t *counters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERF_COUNTER_H */
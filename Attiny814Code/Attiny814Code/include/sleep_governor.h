@@ -0,0 +1,56 @@
+/*============================================================================
+Filename : sleep_governor.h
+Project : Attiny814Code
+Purpose : Picks the deepest sleep mode the work in flight allows. Drivers
+          hold a lock while a peripheral needs a clock that would stop in a
+          deeper mode; the governor sleeps in idle while any lock is held,
+          otherwise in standby or power-down, and keeps residency counters
+          per mode.
+============================================================================*/
+
+#ifndef SLEEP_GOVERNOR_H
+#define SLEEP_GOVERNOR_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* Locks, each keeps the device in idle until released */
+#define SLEEP_LOCK_PTC 0x01u     /* PTC acquisition running */
+#define SLEEP_LOCK_UART_TX 0x02u /* USART transmitter draining */
+
+/* Power states, index of the residency counters */
+#define SLEEP_STATE_ACTIVE 0u
+#define SLEEP_STATE_IDLE 1u
+#define SLEEP_STATE_STANDBY 2u
+#define SLEEP_STATE_PWR_DOWN 3u
+#define SLEEP_STATE_COUNT 4u
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+typedef struct {
+	uint16_t entries[SLEEP_STATE_COUNT]; /* sleeps entered, per mode */
+	uint16_t ticks[SLEEP_STATE_COUNT];   /* state at each RTC tick, wraps */
+} sleep_stats_t;
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *----------------------------------------------------------------------------*/
+void    sleep_lock(uint8_t lock);
+void    sleep_unlock(uint8_t lock);
+uint8_t sleep_governor_select(void);
+void    sleep_governor_sleep(void);
+void    sleep_governor_tick(void);
+void    sleep_governor_read_stats(sleep_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SLEEP_GOVERNOR_H */
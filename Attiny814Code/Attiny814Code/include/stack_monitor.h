@@ -0,0 +1,45 @@
+/*============================================================================
+Filename : stack_monitor.h
+Project : Attiny814Code
+Purpose : Runtime stack high-water mark. The free RAM between the end of
+          .bss and the top of the stack is painted with a pattern before
+          the C runtime starts; the lowest overwritten byte marks the
+          deepest stack the firmware has reached since reset.
+          tools/stackusage gives the static worst case to compare with.
+============================================================================*/
+
+#ifndef STACK_MONITOR_H
+#define STACK_MONITOR_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* Enables the stack painting and the high-water mark. Off until its size
+ * is measured on the target.
+ * Range: 0u or 1u
+ * Default value: 0u
+ */
+#ifndef DEF_STACK_MONITOR_ENABLE
+#define DEF_STACK_MONITOR_ENABLE 0u
+#endif
+
+/* Fill pattern of the unused RAM */
+#define STACK_PAINT_PATTERN 0x5Au
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *----------------------------------------------------------------------------*/
+uint16_t stack_monitor_size(void);
+uint16_t stack_monitor_peak(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STACK_MONITOR_H */
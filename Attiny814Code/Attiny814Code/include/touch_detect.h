@@ -0,0 +1,260 @@
+/*============================================================================
+Filename : touch_detect.h
+Project : Attiny814Code
+Purpose : Edge based touch detection on the delta (signal - reference) of
+          the sensor node. A touch is a rising edge followed by a falling
+          edge FINGER_ON_MINIMUM..MAXIMUM later. Hardware independent, also
+          built on the host for the fuzz harness.
+
+          Edges are steps of the delta after the filter stage selected by
+          TOUCH_FILTER. Every filter uses shifts and adds only and is scaled
+          so that a clean step of the delta gives a step of the same size,
+          the edge thresholds keep their meaning:
+
+          TOUCH_FILTER_NONE  x[n] - x[n-1], no delay, full noise
+          TOUCH_FILTER_EMA   x[n] - y[n-1], y the exponential average of
+                             the delta (weight 2^-TOUCH_FILTER_EMA_SHIFT):
+                             no delay, lower noise, slow edges add up
+          TOUCH_FILTER_FIR   mean(x[n], x[n-1]) - mean(x[n-2], x[n-3]):
+                             half the noise power of NONE, one period
+                             later, one sample spikes count half
+
+          The edge threshold is noiseFactor times a running estimate of the
+          noise, the exponentially weighted mean absolute step, within
+          edgeThresholdMin..Max. The estimate follows a larger step with
+          the time constant 2^noiseAttackShift samples and a smaller one
+          with 2^noiseReleaseShift samples. Steps count up to twice the
+          estimate, so a touch edge only nudges it while an EMI burst
+          doubles it every few samples.
+
+          A valve pulse disturbs the sensor for a while. touch_detect_freeze()
+          blanks the edges for TOUCH_BLANK_ONSET_SAMPLES samples and takes
+          the delta they moved as the disturbance, which then decays by
+          2^-TOUCH_BLANK_DECAY_SHIFT per sample. Meanwhile the edges come
+          from the delta without the disturbance, so a finger right after
+          the pulse still counts. Once the disturbance is below the edge
+          threshold, or after freezeTime, the filter moves to the plain
+          delta and the blanking ends.
+
+          The fusion stage selected by TOUCH_FUSION combines the edges with
+          the debounced state of the qtlib key module, passed in with
+          touch_detect_key() ahead of every sample:
+
+          TOUCH_FUSION_NONE     edges alone, the key state is unused
+          TOUCH_FUSION_GATE     a rising edge needs the key over its
+                                threshold (filter-in or detect). While the
+                                key is quiet, no finger is on and nothing
+                                is blanked, the edge detection is skipped:
+                                the filter follows the delta, the noise
+                                estimate and the threshold hold
+          TOUCH_FUSION_CONFIRM  a touch is only valid when the key reached
+                                detect while the finger was on, otherwise
+                                it is a false touch
+
+          touch_detect_baseline() tracks the reference of the node when
+          the qtlib key module is left out (DEF_TOUCH_KEY_MODULE 0). The
+          reference drifts one count at a time towards the signal, not at
+          all while a finger is on, during the blanking and for
+          TOUCH_BASELINE_HOLD_MS after. A signal that stays below the
+          reference by TOUCH_BASELINE_RECAL_THRESHOLD is taken as the new
+          reference: the finger was on when it was calibrated.
+
+          touch_detect_sample() runs once per measurement from the main
+          loop, touch_detect_tick() once per RTC period from the interrupt.
+          Neither has a loop, the cost per sample is constant.
+============================================================================*/
+
+#ifndef TOUCH_DETECT_H
+#define TOUCH_DETECT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* RTC period in ms, the time base of touch_detect_tick() */
+#define RTC_WAKE_UP_TIME 32
+
+#define FINGER_ON_MINIMUM_TIME_MS(TIME) (uint16_t)(TIME / RTC_WAKE_UP_TIME)
+#define FINGER_ON_MAXIMUM_TIME_MS(TIME) (uint16_t)(TIME / RTC_WAKE_UP_TIME)
+#define RADIOTUBE_FREEZE_TIME_MS(TIME) (uint16_t)(TIME / RTC_WAKE_UP_TIME)
+
+#define TOUCH_FILTER_NONE 0
+#define TOUCH_FILTER_EMA 1
+#define TOUCH_FILTER_FIR 2
+
+/* Filter stage in front of the edge detection, see above
+ * Range: TOUCH_FILTER_NONE, TOUCH_FILTER_EMA, TOUCH_FILTER_FIR
+ * Default value: TOUCH_FILTER_NONE
+ */
+#ifndef TOUCH_FILTER
+#define TOUCH_FILTER TOUCH_FILTER_NONE
+#endif
+
+/* Weight of a new sample in the exponential average, 2^-shift
+ * Range: 1 to 4
+ * Default value: 1
+ */
+#define TOUCH_FILTER_EMA_SHIFT 1
+
+/* Samples after a strong edge in which the filter still carries the step,
+ * the noise adaptation skips them */
+#if TOUCH_FILTER == TOUCH_FILTER_EMA
+#define TOUCH_FILTER_SETTLE (1 << TOUCH_FILTER_EMA_SHIFT)
+#elif TOUCH_FILTER == TOUCH_FILTER_FIR
+#define TOUCH_FILTER_SETTLE 2
+#else
+#define TOUCH_FILTER_SETTLE 0
+#endif
+
+#define TOUCH_FUSION_NONE 0
+#define TOUCH_FUSION_GATE 1
+#define TOUCH_FUSION_CONFIRM 2
+
+/* Fusion of the edges with the key state, see above
+ * Range: TOUCH_FUSION_NONE, TOUCH_FUSION_GATE, TOUCH_FUSION_CONFIRM
+ * Default value: TOUCH_FUSION_NONE
+ */
+#ifndef TOUCH_FUSION
+#define TOUCH_FUSION TOUCH_FUSION_NONE
+#endif
+
+/* Samples after a valve pulse that are all disturbance
+ * Range: 1 to 4
+ * Default value: 1
+ */
+#ifndef TOUCH_BLANK_ONSET_SAMPLES
+#define TOUCH_BLANK_ONSET_SAMPLES 1
+#endif
+
+/* Decay of the valve disturbance per sample, 2^-shift
+ * Range: 1 to 4
+ * Default value: 2
+ */
+#ifndef TOUCH_BLANK_DECAY_SHIFT
+#define TOUCH_BLANK_DECAY_SHIFT 2
+#endif
+
+/* Time for one count of reference drift towards a higher signal, ms
+ * Range: RTC_WAKE_UP_TIME to 255 * RTC_WAKE_UP_TIME
+ * Default value: 1000, DEF_TCH_DRIFT_RATE of the key module
+ */
+#ifndef TOUCH_BASELINE_DRIFT_UP_MS
+#define TOUCH_BASELINE_DRIFT_UP_MS 1000
+#endif
+
+/* Time for one count of reference drift towards a lower signal, ms
+ * Range: RTC_WAKE_UP_TIME to 255 * RTC_WAKE_UP_TIME
+ * Default value: 800, DEF_ANTI_TCH_DRIFT_RATE of the key module
+ */
+#ifndef TOUCH_BASELINE_DRIFT_DOWN_MS
+#define TOUCH_BASELINE_DRIFT_DOWN_MS 800
+#endif
+
+/* Drift hold after a finger or a valve pulse, ms
+ * Range: 0 to 255 * RTC_WAKE_UP_TIME
+ * Default value: 4000, DEF_DRIFT_HOLD_TIME of the key module
+ */
+#ifndef TOUCH_BASELINE_HOLD_MS
+#define TOUCH_BASELINE_HOLD_MS 4000
+#endif
+
+/* Signal below the reference that recalibrates it, counts
+ * Range: 1 to 65535
+ * Default value: 100, the key threshold
+ */
+#ifndef TOUCH_BASELINE_RECAL_THRESHOLD
+#define TOUCH_BASELINE_RECAL_THRESHOLD 100u
+#endif
+
+/* Samples in a row below the reference before it recalibrates
+ * Range: 1 to 255
+ * Default value: 5, DEF_ANTI_TCH_DET_INT of the key module
+ */
+#ifndef TOUCH_BASELINE_RECAL_SAMPLES
+#define TOUCH_BASELINE_RECAL_SAMPLES 5u
+#endif
+
+/* Fraction bits of noiseLevel */
+#define NOISE_LEVEL_FRAC 4
+
+/* Largest noiseLevel, 255 counts; noiseLevel * noiseFactor fits 16 bits */
+#define NOISE_LEVEL_MAX 4095u
+
+/* Largest delta magnitude. Larger deltas saturate, so the difference of two
+ * deltas always fits in an int16_t. */
+#define TOUCH_DELTA_LIMIT 16383
+
+/* Edge of a sample */
+#define EDGE_NONE 0
+#define EDGE_RISING 1
+#define EDGE_FALLING 2
+
+/* Key state of touch_detect_key() */
+#define KEY_QUIET 0u     /* no detect, calibrating or anti-touch */
+#define KEY_FILTER_IN 1u /* over the key threshold, debouncing */
+#define KEY_DETECT 2u    /* detect, also while debouncing the release */
+
+/* Result of a sample */
+#define TOUCH_NONE 0u
+#define TOUCH_VALID 1u
+#define TOUCH_FALSE 2u
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+typedef enum {
+	FINGER_ON_DETECT = 0,
+	FINGER_OFF_DETECT,
+} SensorStateDef;
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *----------------------------------------------------------------------------*/
+int16_t touch_detect_delta(uint16_t signal, uint16_t reference);
+int16_t touch_detect_derivative(int16_t delta);
+uint8_t touch_detect_edge(int16_t delta);
+uint8_t touch_detect_sample(uint16_t signal, uint16_t reference, uint8_t *edge);
+void    touch_detect_tick(void);
+void    touch_detect_freeze(void);
+void    touch_detect_reset(void);
+void    touch_detect_baseline(uint16_t signal);
+void    touch_detect_key(uint8_t state);
+uint8_t touch_detect_held(void);
+
+/* filter state: previous delta, or its average with TOUCH_FILTER_EMA */
+extern int16_t filteredDeltaValue;
+
+/* reference of touch_detect_baseline() */
+extern uint16_t baselineValue;
+
+/* adaptive edge threshold and the noise estimate behind it */
+extern uint16_t STRONG_EDGE_THRESHOLD;
+extern uint16_t noiseLevel; /* counts, NOISE_LEVEL_FRAC fraction bits */
+
+/* tuning parameters, see cmd_param_table */
+extern uint8_t  noiseFactor;
+extern uint8_t  noiseAttackShift;
+extern uint8_t  noiseReleaseShift;
+extern uint16_t edgeThresholdMin;
+extern uint16_t edgeThresholdMax;
+extern uint16_t fingerOnMinTime; /* ms */
+extern uint16_t fingerOnMaxTime; /* ms */
+extern uint16_t freezeTime;      /* ms, longest blanking */
+
+extern volatile SensorStateDef SensorState;
+extern volatile uint16_t       fingerOnCnt;
+extern volatile uint8_t        edgeDetectFreeze;
+extern volatile uint16_t       edgeFreezeCnt;
+extern uint16_t                touchCnt;
+extern uint16_t                falseTouchCnt;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TOUCH_DETECT_H */
@@ -0,0 +1,178 @@
+/*============================================================================
+Filename : uart_command.h
+Project : Attiny814Code
+Purpose : Binary UART command channel for reading and writing tuning
+          parameters at runtime. Shared with the host tools, so it must not
+          depend on any AVR header.
+
+Request  : 0xC3 LEN CMD [payload] CRC
+Response : 0xC5 LEN CMD|0x80 STATUS [payload] CRC
+
+LEN counts the bytes from CMD up to the last payload byte, CRC is the
+CRC-16/CCITT-FALSE of the datastreamer (ds_crc16_update) over LEN..payload,
+sent little endian. All multi-byte values are little endian.
+
+CMD_PING        -                   -> protocol version, parameter count
+CMD_PARAM_READ  id                  -> value (u16)
+CMD_PARAM_WRITE id, value (u16)     -> value (u16) as stored, read-only
+                                       parameters answer
+                                       CMD_STATUS_READ_ONLY
+CMD_RECALIBRATE -                   -> -
+CMD_COUNTERS    -                   -> frames, crc errors, overruns of the
+                                       receiver, application counters (u16)
+CMD_PERF        -                   -> PERF_COUNT event counters (u16), see
+                                       perf_counter.h
+
+Wake from standby: with DEF_UART_COMMAND_SFD_WAKE the receiver uses start
+of frame detection, the start bit of a byte requests the main clock and the
+receive complete interrupt wakes the CPU. The oscillator start-up takes in
+the order of one bit time at 115200 baud, so the first byte after standby
+may be lost. The host therefore sends CMD_WAKE_PREAMBLE in front of every
+request. Any received byte keeps the device out of standby until the line
+has been quiet for CMD_RX_TIMEOUT_TICKS measurement periods, so requests
+sent back to back run at full speed (a ping is 15 bytes on the wire, about
+1.3 ms at 115200 baud) and only the first one pays the wake-up latency.
+============================================================================*/
+
+#ifndef UART_COMMAND_H
+#define UART_COMMAND_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* Enable / Disable the UART command channel. The release build keeps the
+ * USART and its receiver powered only when it is enabled.
+ * Range: 0 / 1
+ * Default value: 0
+ */
+#ifndef DEF_UART_COMMAND_ENABLE
+#define DEF_UART_COMMAND_ENABLE 0u
+#endif
+
+/* Enable / Disable wake from standby by a received byte (start of frame
+ * detection). Without it the release build sleeps in power-down and only
+ * receives while it is awake.
+ * Range: 0 / 1
+ * Default value: 1
+ */
+#define DEF_UART_COMMAND_SFD_WAKE 1u
+
+/* Measurement periods without a received byte after which the receiver
+ * gives up a partial request and the device may enter standby again
+ * Range: 1 to 255
+ * Default value: 3
+ */
+#define CMD_RX_TIMEOUT_TICKS 3u
+
+#define CMD_PROTOCOL_VERSION 4u
+
+#define CMD_REQUEST_SOF 0xC3u
+#define CMD_RESPONSE_SOF 0xC5u
+#define CMD_RESPONSE_FLAG 0x80u
+#define CMD_WAKE_PREAMBLE 0xFFu
+
+/* Largest LEN of a request or response */
+#define CMD_MAX_LEN 32u
+
+/* Commands */
+#define CMD_PING 0x01u
+#define CMD_PARAM_READ 0x02u
+#define CMD_PARAM_WRITE 0x03u
+#define CMD_RECALIBRATE 0x04u
+#define CMD_COUNTERS 0x05u
+#define CMD_PERF 0x06u
+
+/* Response status */
+#define CMD_STATUS_OK 0x00u
+#define CMD_STATUS_UNKNOWN_CMD 0x01u
+#define CMD_STATUS_BAD_LENGTH 0x02u
+#define CMD_STATUS_BAD_PARAM 0x03u
+#define CMD_STATUS_OUT_OF_RANGE 0x04u
+#define CMD_STATUS_READ_ONLY 0x05u
+
+/* Parameter ids */
+/* read only: noiseFactor times the noise estimate, within
+ * PARAM_EDGE_THRESHOLD_MIN..MAX, see touch_detect.h */
+#define PARAM_EDGE_THRESHOLD 0u
+#define PARAM_NOISE_FACTOR 1u
+#define PARAM_KEY_THRESHOLD 2u
+#define PARAM_FINGER_ON_MIN 3u
+#define PARAM_FINGER_ON_MAX 4u
+#define PARAM_FREEZE_TIME 5u
+#define PARAM_EDGE_THRESHOLD_MIN 6u
+#define PARAM_EDGE_THRESHOLD_MAX 7u
+#define PARAM_NOISE_ATTACK 8u
+#define PARAM_AUTO_CLOSE_TIME 9u
+#define PARAM_NOISE_RELEASE 10u
+#define PARAM_DOUBLE_TAP_WINDOW 11u
+#define PARAM_LONG_PRESS_TIME 12u
+#define PARAM_TIMED_RUN_TIME 13u
+#define PARAM_COUNT 14u
+
+/* Application counters of CMD_COUNTERS, after the three receive statistics */
+#define COUNTER_TOUCHES 0u
+#define COUNTER_FALSE_TOUCHES 1u
+#define COUNTER_ERROR_CODE 2u
+#define COUNTER_LOW_BATTERY 3u
+#define COUNTER_SENSOR_STATE 4u
+#define COUNTER_RADIOTUBE_STATE 5u
+/* noise estimate in counts, see touch_detect.h */
+#define COUNTER_NOISE_LEVEL 6u
+/* RTC ticks spent active, in idle, standby and power-down, see sleep_governor.h */
+#define COUNTER_RESIDENCY_ACTIVE 7u
+#define COUNTER_RESIDENCY_IDLE 8u
+#define COUNTER_RESIDENCY_STANDBY 9u
+#define COUNTER_RESIDENCY_PWR_DOWN 10u
+/* stack high-water mark in bytes, see stack_monitor.h */
+#define COUNTER_STACK_PEAK 11u
+#define COUNTER_COUNT 12u
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+/* Entry of the parameter table, indexed by parameter id. An entry without
+ * a variable (value NULL) is not in this build, CMD_STATUS_BAD_PARAM. A
+ * read-only entry is derived by the application, writes are rejected. */
+typedef struct {
+	void *   value;
+	uint8_t  size; /* 1 or 2 bytes */
+	uint16_t min;
+	uint16_t max;
+	uint8_t  read_only;
+} cmd_param_t;
+
+/* Receive statistics */
+typedef struct {
+	uint16_t frames;
+	uint16_t crc_errors;
+	uint16_t overruns;
+} cmd_stats_t;
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *----------------------------------------------------------------------------*/
+void    cmd_init(void);
+void    cmd_rx_byte(uint8_t data);
+uint8_t cmd_process(void);
+void    cmd_tick(void);
+uint8_t cmd_rx_busy(void);
+
+extern cmd_stats_t cmd_stats;
+
+/* Provided by the application */
+extern const cmd_param_t cmd_param_table[PARAM_COUNT];
+void                     cmd_tx_byte(uint8_t data);
+void                     cmd_recalibrate(void);
+uint8_t                  cmd_read_counters(uint16_t *counters, uint8_t max_counters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UART_COMMAND_H */
@@ -6,27 +6,21 @@
 #include "touch.h"
 #include "touch_api_ptc.h"
 #include "driver_init.h"
+#include "datastreamer.h"
+#include "uart_command.h"
+#include "touch_detect.h"
+#include "gesture.h"
+#include "perf_counter.h"
+#include "atomic_access.h"
+#include "gpio.h"
 
-#define EDGE_NONE				0
-#define EDGE_RISING				1
-#define EDGE_FALLING			2
-
-#define RTC_WAKE_UP_TIME							32
-#define FINGER_ON_MINIMUM_TIME_MS(TIME)				(uint16_t)(TIME/RTC_WAKE_UP_TIME)
-#define FINGER_ON_MAXIMUM_TIME_MS(TIME)				(uint16_t)(TIME/RTC_WAKE_UP_TIME)
-#define RADIOTUBE_FREEZE_TIME_MS(TIME)				(uint16_t)(TIME/RTC_WAKE_UP_TIME)		
 #define RADIOTUBE_AUTO_CLOSE_TIME_MIN(TIME)			(uint32_t)((TIME * 60000)/RTC_WAKE_UP_TIME)
+#define RADIOTUBE_TIMED_RUN_TIME_S(TIME)			(uint32_t)((TIME * 1000UL)/RTC_WAKE_UP_TIME)
 #define AC_CHECK_TIME_MS(TIME)						(uint16_t)(TIME/RTC_WAKE_UP_TIME)	
 
-uint16_t STRONG_EDGE_THRESHOLD = 50;
-uint16_t noiseTolerance = 25;
-uint8_t noiseCnt = 0;
-
-typedef enum
-{
-	FINGER_ON_DETECT = 0,
-	FINGER_OFF_DETECT,
-}SensorStateDef;
+/* tuning parameters, can be changed at runtime over the UART command channel */
+uint8_t autoCloseTime = 3;				/* min */
+uint8_t timedRunTime = 30;				/* s */
 
 typedef enum
 {
@@ -34,28 +28,91 @@ typedef enum
 	OFF,
 }RadiotubeStateDef;
 
-volatile SensorStateDef SensorState = FINGER_ON_DETECT;
 volatile RadiotubeStateDef RadiotubeState = OFF;
 
 volatile uint8_t measeurePeriod = RTC_WAKE_UP_TIME;
 
-volatile uint16_t fingerOnCnt = 0;
 uint8_t radiotubeCnt = 0;
-uint32_t RadiotubeOnTime = 0;
+/* counted by the RTC interrupt, reset with atomic_write32() */
+volatile uint32_t RadiotubeOnTime = 0;
+
+/* double-tap: the valve closes after timedRunTime instead of autoCloseTime */
+volatile uint8_t radiotubeTimedRun = 0;
+/* long-press: taps leave the valve alone until the next long-press */
+uint8_t radiotubeLocked = 0;
 
 extern volatile uint8_t measurement_done_touch;
-volatile uint8_t measureBusyFlag = 0;
 
 volatile uint8_t edgeFreezeStart = 0;
-volatile uint8_t edgeDetectFreeze = 0;
-uint16_t edgeFreezeCnt = 0;
-
-/* filter variable */
-int16_t filteredDeltaValue = 0;
 
 uint8_t lowBatteryWarming = 0;
 uint16_t AC_TimeCnt = 0;
 
+#if DEF_TOUCH_KEY_MODULE == 1u
+extern qtm_touch_key_config_t qtlib_key_configs_set1[DEF_NUM_SENSORS];
+#endif
+extern uint8_t module_error_code;
+
+#if DEF_UART_COMMAND_ENABLE == 1u
+const cmd_param_t cmd_param_table[PARAM_COUNT] = {
+	/* derived from the noise estimate on every sample */
+	[PARAM_EDGE_THRESHOLD] = {&STRONG_EDGE_THRESHOLD, 2, 0, 1023, 1},
+	[PARAM_NOISE_FACTOR] = {&noiseFactor, 1, 1, 16},
+#if DEF_TOUCH_KEY_MODULE == 1u
+	[PARAM_KEY_THRESHOLD] = {&qtlib_key_configs_set1[0].channel_threshold, 1, 1, 255},
+#endif
+	[PARAM_FINGER_ON_MIN] = {&fingerOnMinTime, 2, 0, 10000},
+	[PARAM_FINGER_ON_MAX] = {&fingerOnMaxTime, 2, 0, 10000},
+	[PARAM_FREEZE_TIME] = {&freezeTime, 2, 0, 10000},
+	[PARAM_EDGE_THRESHOLD_MIN] = {&edgeThresholdMin, 2, 0, 1023},
+	[PARAM_EDGE_THRESHOLD_MAX] = {&edgeThresholdMax, 2, 0, 1023},
+	[PARAM_NOISE_ATTACK] = {&noiseAttackShift, 1, 0, 7},
+	[PARAM_AUTO_CLOSE_TIME] = {&autoCloseTime, 1, 1, 60},
+	[PARAM_NOISE_RELEASE] = {&noiseReleaseShift, 1, 0, 10},
+	[PARAM_DOUBLE_TAP_WINDOW] = {&doubleTapWindow, 2, 0, GESTURE_TICKS_MAX * RTC_WAKE_UP_TIME},
+	[PARAM_LONG_PRESS_TIME] = {&longPressTime, 2, 0, GESTURE_TICKS_MAX * RTC_WAKE_UP_TIME},
+	[PARAM_TIMED_RUN_TIME] = {&timedRunTime, 1, 1, 255},
+};
+
+void cmd_tx_byte(uint8_t data)
+{
+	/* TXCIF tells the sleep governor when the last byte has left */
+	USART0.STATUS = USART_TXCIF_bm;
+	USART_write(data);
+	sleep_lock(SLEEP_LOCK_UART_TX);
+}
+
+void cmd_recalibrate(void)
+{
+	calibrate_node(0);
+	touch_detect_reset();
+	gesture_reset();
+}
+
+uint8_t cmd_read_counters(uint16_t *counters, uint8_t max_counters)
+{
+	sleep_stats_t sleepStats;
+	uint8_t i;
+	
+	if (max_counters < COUNTER_COUNT)
+		return 0;
+	
+	counters[COUNTER_TOUCHES] = touchCnt;
+	counters[COUNTER_FALSE_TOUCHES] = falseTouchCnt;
+	counters[COUNTER_ERROR_CODE] = module_error_code;
+	counters[COUNTER_LOW_BATTERY] = lowBatteryWarming;
+	counters[COUNTER_SENSOR_STATE] = SensorState;
+	counters[COUNTER_RADIOTUBE_STATE] = RadiotubeState;
+	counters[COUNTER_NOISE_LEVEL] = noiseLevel >> NOISE_LEVEL_FRAC;
+	
+	sleep_governor_read_stats(&sleepStats);
+	for (i = 0; i < SLEEP_STATE_COUNT; i++)
+		counters[COUNTER_RESIDENCY_ACTIVE + i] = sleepStats.ticks[i];
+	counters[COUNTER_STACK_PEAK] = stack_monitor_peak();
+	return COUNTER_COUNT;
+}
+#endif
+
 int16_t TOUCH_GetTouchSignal(void)
 {
 	return STRONG_EDGE_THRESHOLD;
@@ -63,7 +120,7 @@ int16_t TOUCH_GetTouchSignal(void)
 
 void TOUCH_SetMeasureBusyFlag(void)
 {
-	measureBusyFlag = 1;
+	sleep_lock(SLEEP_LOCK_PTC);
 }
 
 void Radiotube_Handle(void)
@@ -71,10 +128,11 @@ void Radiotube_Handle(void)
 	if (RadiotubeState == OFF)
 	{
 		RadiotubeState = ON;
-		IO1_set_level(true);
-		_delay_ms(30);
-		IO1_set_level(false);
-		edgeDetectFreeze = 1;
+		gpio_high(VALVE_OPEN);
+		clock_delay_ms(30);
+		gpio_low(VALVE_OPEN);
+		touch_detect_freeze();
+		perf_count(PERF_ACTUATIONS);
 		
 		if (lowBatteryWarming == 1)
 		{
@@ -87,23 +145,52 @@ void Radiotube_Handle(void)
 	else
 	{
 		RadiotubeState = OFF;
-		IO2_set_level(true);
-		_delay_ms(30);
-		IO2_set_level(false);
-		edgeDetectFreeze = 1;
-		RadiotubeOnTime = 0;
+		gpio_high(VALVE_CLOSE);
+		clock_delay_ms(30);
+		gpio_low(VALVE_CLOSE);
+		touch_detect_freeze();
+		perf_count(PERF_ACTUATIONS);
+		atomic_write32(&RadiotubeOnTime, 0);
+		radiotubeTimedRun = 0;
 	}
 }
 
-void MCU_GoToSleep(int mode)
+void Radiotube_Gesture(uint8_t gesture)
 {
-	// Set sleep mode to Power Down mode
-	set_sleep_mode(mode);
-	sleep_enable();
-	sleep_cpu();
-	sleep_disable();
+	switch (gesture)
+	{
+	case GESTURE_TAP:
+		if (radiotubeLocked == 0)
+			Radiotube_Handle();
+		break;
+		
+	case GESTURE_DOUBLE_TAP:
+		/* open the valve for timedRunTime, or restart the time */
+		if (radiotubeLocked == 0)
+		{
+			if (RadiotubeState == OFF)
+				Radiotube_Handle();
+			atomic_write32(&RadiotubeOnTime, 0);
+			radiotubeTimedRun = 1;
+		}
+		break;
+		
+	case GESTURE_LONG_PRESS:
+		radiotubeLocked ^= 1;
+		if (radiotubeLocked == 1 && RadiotubeState == ON)
+			Radiotube_Handle();
+		break;
+		
+	default:
+		break;
+	}
 }
 
+/* AC interrupt, the battery dropped below the reference */
+void LowBattery(void)
+{
+	lowBatteryWarming = 1;
+}
 
 void RTC_CallBack(void)
 {
@@ -113,38 +200,34 @@ void RTC_CallBack(void)
 	if (AC_TimeCnt >= AC_CHECK_TIME_MS(1000) && lowBatteryWarming == 0)
 	{
 		AC_TimeCnt = 0;
-		PA6_set_level(true);
-		_delay_ms(2);
+		perf_count(PERF_BATTERY_CHECKS);
+		gpio_high(DIVIDER);
+		clock_delay_ms(2);
 		AC_0_init();
-		_delay_ms(2);
+		clock_delay_ms(2);
 		
 		if ((AC0.STATUS & AC_STATE_bm) == 0)
 			lowBatteryWarming = 1;
 		
 		AC_0_Disable();
-		PA6_set_level(false);
+		gpio_low(DIVIDER);
 	}
 	
-	/* count the time when the  finger on */
-	if (SensorState == FINGER_OFF_DETECT)
-		fingerOnCnt++; 
+#if DEF_UART_COMMAND_ENABLE == 1u
+	cmd_tick();
+#endif
+	sleep_governor_tick();
 	
-	/* freeze the edge detection for 100 ms after open the radiotube */
-	if(edgeDetectFreeze == 1)
-		edgeFreezeCnt++;
-
-	if (edgeFreezeCnt > RADIOTUBE_FREEZE_TIME_MS(100))
-	{
-		edgeFreezeCnt = 0;
-		edgeDetectFreeze = 0;
-	}
+	touch_detect_tick();
+	gesture_tick();
 	
 	/* radiotube will close automatically 
-		when it open more than 3 mins */
+		when it open more than 3 mins, or after the timed run */
 	if(RadiotubeState == ON)
 	{
 		RadiotubeOnTime++;
-		if(RadiotubeOnTime > RADIOTUBE_AUTO_CLOSE_TIME_MIN(3))
+		if(RadiotubeOnTime > (radiotubeTimedRun ? RADIOTUBE_TIMED_RUN_TIME_S(timedRunTime)
+		                                        : RADIOTUBE_AUTO_CLOSE_TIME_MIN(autoCloseTime)))
 		{
 			RadiotubeOnTime = 0;
 			Radiotube_Handle();
@@ -158,107 +241,66 @@ int16_t TOUCH_DeltaSmoothing(int16_t curDelta)
 	if (edgeDetectFreeze == 1)
 		return 0;
 	else
-		return abs(curDelta - filteredDeltaValue);
+		return abs(touch_detect_derivative(curDelta));
 }
 
-static uint8_t TOUCH_DeltaEdgeDetct(void)
+#if TOUCH_FUSION != TOUCH_FUSION_NONE
+#if DEF_TOUCH_KEY_MODULE == 0u
+#error "TOUCH_FUSION needs the qtlib key module"
+#endif
+
+/* qtlib key state of the node for the fusion stage of the detection */
+static uint8_t TOUCH_KeyState(const touch_snapshot_t *snapshot)
 {
-	int16_t curDelta;
-	int16_t deltaDerivativeAbs,deltaDerivative;
-	uint8_t edgeStatus = EDGE_NONE;
-	
-	curDelta = get_sensor_node_signal(0);
-	curDelta -= get_sensor_node_reference(0);
-	
-	deltaDerivative = curDelta - filteredDeltaValue;
-	deltaDerivativeAbs = abs(deltaDerivative);
-	filteredDeltaValue = curDelta;
-	
-	if (deltaDerivativeAbs >= STRONG_EDGE_THRESHOLD)
-	{
-		/* this is an strong edge */
-		if(deltaDerivative > 0)
-			edgeStatus = EDGE_RISING;
-		else 
-			edgeStatus = EDGE_FALLING;
+	switch (snapshot->node[0].state) {
+	case QTM_KEY_STATE_FILT_IN:
+		return KEY_FILTER_IN;
+	case QTM_KEY_STATE_DETECT:
+	case QTM_KEY_STATE_FILT_OUT:
+		return KEY_DETECT;
+	default:
+		return KEY_QUIET;
 	}
-	else if (deltaDerivativeAbs >= noiseTolerance)
-	{
-		/* if the amplitude of noise exceed the noise tolerance,
-			the edge threshold should go up.*/
-		STRONG_EDGE_THRESHOLD++;
-		noiseCnt = 0;
-	}
-	else
-	{
-		/* if the fluctuation of noise within the noise tolerance for 3 second,
-			the edge threshold should go down.*/
-		noiseCnt++;
-		if (noiseCnt >= 100)
-		{
-			STRONG_EDGE_THRESHOLD--;
-			noiseCnt = 0;
-		}
-	}
-	
-	if (STRONG_EDGE_THRESHOLD >= 80)
-		STRONG_EDGE_THRESHOLD = 80;
-	else if (STRONG_EDGE_THRESHOLD <= 35)
-		STRONG_EDGE_THRESHOLD = 35;
-	
-	noiseTolerance = STRONG_EDGE_THRESHOLD/2;
-	
-	return edgeStatus;
 }
+#endif
 
 static uint8_t TOUCH_TouchDetect(void)
 {
-	uint8_t keyStatus = 0;
+	const touch_snapshot_t *snapshot;
+	uint8_t gesture = GESTURE_NONE;
 	uint8_t edgeStatus = EDGE_NONE;
+	uint8_t result;
 	
 	///* Does acquisition and post-processing */
 	touch_process();
 	
 	if (measurement_done_touch == 0)
-		return keyStatus;
-		
-	if (edgeDetectFreeze == 1)
-		return keyStatus;
-		
-	edgeStatus = TOUCH_DeltaEdgeDetct();
+		return gesture;
 	
-	switch(SensorState)
-	{
-		case FINGER_ON_DETECT:
-			if (edgeStatus == EDGE_RISING)
-				SensorState = FINGER_OFF_DETECT;
-		break;
+	/* signal and reference of the same acquisition */
+	snapshot = touch_get_snapshot();
 		
-		case FINGER_OFF_DETECT:
-			/* state will roll back if rising edge appears. */
-			if (edgeStatus == EDGE_RISING)
-				fingerOnCnt = 0;
-			/* the time duration of effective touch should between 70ms to 500ms */
-			else if (fingerOnCnt >= FINGER_ON_MAXIMUM_TIME_MS(500))
-			{
-				fingerOnCnt = 0;
-				SensorState = FINGER_ON_DETECT;
-			}
-			else if (edgeStatus == EDGE_FALLING)
-			{
-				if (fingerOnCnt >= FINGER_ON_MINIMUM_TIME_MS(70))
-					keyStatus = 1;
-					
-				fingerOnCnt = 0;
-				SensorState = FINGER_ON_DETECT;
-			}
-			break;
-	}
+#if TOUCH_FUSION != TOUCH_FUSION_NONE
+	touch_detect_key(TOUCH_KeyState(snapshot));
+#endif
+	/* also during the blanking after a valve pulse, the samples end it */
+	result = touch_detect_sample(snapshot->node[0].signal, snapshot->node[0].reference, &edgeStatus);
+	
+	if (edgeStatus != EDGE_NONE)
+		datastreamer_capture_trigger(CAPTURE_TRIGGER_EDGE);
+	
+	if (result == TOUCH_VALID)
+		datastreamer_capture_trigger(CAPTURE_TRIGGER_TOUCH);
+	else if (result == TOUCH_FALSE)
+		datastreamer_capture_trigger(CAPTURE_TRIGGER_FALSE);
+	
+	gesture = gesture_sample(edgeStatus, result, touch_detect_held());
 	
 	/* one cycle of measurement is done */
 	measurement_done_touch = 0;
-	measureBusyFlag = 0;
-	return keyStatus;
+	sleep_unlock(SLEEP_LOCK_PTC);
+	clock_unlock(CLOCK_LOCK_PTC);
+	return gesture;
 }
 
 //static void Radiotube_Test(void)
@@ -279,9 +321,21 @@ static uint8_t TOUCH_TouchDetect(void)
 
 int main(void)
 {
+	uint8_t resetFlags = RSTCTRL.RSTFR;
+	
+	/* counters survive any reset but a power cycle */
+	RSTCTRL.RSTFR = resetFlags;
+	perf_init((resetFlags & (RSTCTRL_PORF_bm | RSTCTRL_BORF_bm)) != 0);
+	if (resetFlags & RSTCTRL_WDRF_bm)
+		perf_count(PERF_WDT_RESETS);
 	
 	/* Initializes MCU, drivers and middleware */
 	atmel_start_init();
+	gpio_marker_init();
+	
+#if DEF_UART_COMMAND_ENABLE == 1u
+	cmd_init();
+#endif
 		
 	//Radiotube_Test();
 	
@@ -290,17 +344,19 @@ int main(void)
 	{
 		wdt_reset();
 		
-		if(TOUCH_TouchDetect() == 1)
-			Radiotube_Handle();
+		Radiotube_Gesture(TOUCH_TouchDetect());
 		
-		if (measureBusyFlag == 0)
-		{
-#ifdef _DEBUG
-			MCU_GoToSleep(SLEEP_MODE_IDLE);
-#else
-			MCU_GoToSleep(SLEEP_MODE_PWR_DOWN);
+		/* frames of the measurement, after the valve has been driven */
+		datastreamer_process();
+		
+#if DEF_UART_COMMAND_ENABLE == 1u
+		cmd_process();
 #endif
-		}
+		
+		/* the RTC interrupt runs slow, unless the PTC measures */
+		clock_governor_update();
+		/* sleeps in idle while the PTC measures */
+		sleep_governor_sleep();
 	}
 }
 
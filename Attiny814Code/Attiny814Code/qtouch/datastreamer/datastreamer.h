@@ -38,12 +38,67 @@ Copyright (c) 2017 Microchip. All rights reserved.
 #define MEGA_328PB_XPLAINED_MINI 0xF015
 #define MEGA_324PB_XPLAINED_PRO 0xF016
 
+/* Capture trigger reasons */
+#define CAPTURE_TRIGGER_EDGE 0x01u
+#define CAPTURE_TRIGGER_TOUCH 0x02u
+#define CAPTURE_TRIGGER_FALSE 0x04u
+#define CAPTURE_TRIGGER_ERROR 0x08u
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+/* One channel of a datastreamer frame */
+typedef struct {
+	uint16_t signal;
+	uint16_t reference;
+	int16_t  delta;
+	uint16_t threshold;
+	uint8_t  state;
+} datastreamer_node_t;
+
+/* One datastreamer frame, as recorded into the capture buffer. Every field
+ * is taken when the frame is built, a frame sent later from the capture
+ * buffer shows the acquisition it was recorded for. */
+typedef struct {
+#if (DEF_TOUCH_DATA_STREAMER_TIMESTAMP == 1u)
+	uint16_t timestamp;
+#endif
+	datastreamer_node_t node[DEF_NUM_CHANNELS];
+} datastreamer_frame_t;
+
+/* Fields that follow the calibration and the configuration rather than the
+ * acquisition. Held once per capture burst, taken with its newest frame,
+ * and sent with every frame of the burst. */
+typedef struct {
+	uint16_t comp_caps[DEF_NUM_CHANNELS];
+	uint8_t  key_threshold[DEF_NUM_CHANNELS];
+	uint8_t  error_code;
+} datastreamer_status_t;
+
 /*----------------------------------------------------------------------------
  *   prototypes
  *----------------------------------------------------------------------------*/
 void datastreamer_init(void);
 void datastreamer_output(void);
+void datastreamer_process(void);
+void datastreamer_send_frame(const datastreamer_frame_t *frame, const datastreamer_status_t *status);
+void datastreamer_set_event(uint8_t reason);
+
+#if (DEF_TOUCH_DATA_STREAMER_CAPTURE == 1u)
+void datastreamer_capture_init(void);
+void datastreamer_capture_record(const datastreamer_frame_t *frame, const datastreamer_status_t *status);
+void datastreamer_capture_trigger(uint8_t reason);
+void datastreamer_capture_process(void);
+#endif
+
+#endif
+
+#if (DEF_TOUCH_DATA_STREAMER_ENABLE != 1u)
+#define datastreamer_process()
+#endif
 
+#if (DEF_TOUCH_DATA_STREAMER_ENABLE != 1u) || (DEF_TOUCH_DATA_STREAMER_CAPTURE != 1u)
+#define datastreamer_capture_trigger(reason)
 #endif
 
 #endif
@@ -24,7 +24,9 @@ Copyright (c) 2017 Microchip. All rights reserved.
   include files
 ----------------------------------------------------------------------------*/
 #include "datastreamer.h"
+#include "datastreamer_frame.h"
 #include "driver_init.h"
+#include "perf_counter.h"
 
 
 #if (DEF_TOUCH_DATA_STREAMER_ENABLE == 1u)
@@ -39,17 +41,45 @@ Copyright (c) 2017 Microchip. All rights reserved.
 
 #define SCROLLER_MODULE_OUTPUT 0
 
+#define DS_NUM_FIELDS DS_FRAME_NUM_FIELDS(DEF_NUM_CHANNELS, DEF_TOUCH_DATA_STREAMER_TIMESTAMP)
+
+#if (DEF_TOUCH_DATA_STREAMER_FORMAT == DATASTREAMER_FORMAT_COMPACT) && (DS_FRAME_LEN_MAX(DS_NUM_FIELDS) > DS_FRAME_MAX_LEN)
+#error "Too many channels for the compact datastreamer frame"
+#endif
+
 /*----------------------------------------------------------------------------
   global variables
 ----------------------------------------------------------------------------*/
 extern qtm_acquisition_control_t qtlib_acq_set1;
-extern qtm_touch_key_control_t   qtlib_key_set1;
-extern qtm_touch_key_config_t    qtlib_key_configs_set1[DEF_NUM_SENSORS];
+#if DEF_TOUCH_KEY_MODULE == 1u
+extern qtm_touch_key_config_t qtlib_key_configs_set1[DEF_NUM_SENSORS];
+
+#define DS_KEY_THRESHOLD(NODE) qtlib_key_configs_set1[NODE].channel_threshold
+#else
+/* no key module, no key threshold */
+#define DS_KEY_THRESHOLD(NODE) 0u
+#endif
 
 extern uint8_t module_error_code;
 
-uint8_t data[] = {
+#if (DEF_TOUCH_DATA_STREAMER_FORMAT == DATASTREAMER_FORMAT_LEGACY)
+/* frame header and footer, read only in the mapped flash */
+static const uint8_t data[] = {
     0x5F, 0xB4, 0x00, 0x86, 0x4A, 0x03, 0xEB, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xAA, 0x55, 0x01, 0x6E, 0xA0};
+#else
+static ds_encoder_t ds_encoder;
+static uint16_t     ds_prev_fields[DS_NUM_FIELDS];
+#endif
+
+/* trigger reason attached to the next frame, 0 for none */
+static uint8_t datastreamer_event;
+
+#if (DEF_TOUCH_DATA_STREAMER_CAPTURE != 1u)
+/* frame of datastreamer_output() waiting for datastreamer_process() */
+static datastreamer_frame_t  datastreamer_queued_frame;
+static datastreamer_status_t datastreamer_queued_status;
+static uint8_t               datastreamer_queued;
+#endif
 
 /*----------------------------------------------------------------------------
   prototypes
@@ -70,6 +100,12 @@ Notes  :
 ============================================================================*/
 void datastreamer_init(void)
 {
+#if (DEF_TOUCH_DATA_STREAMER_FORMAT == DATASTREAMER_FORMAT_COMPACT)
+	ds_encoder_init(&ds_encoder, ds_prev_fields, DS_NUM_FIELDS, DEF_TOUCH_DATA_STREAMER_KEYFRAME_INTERVAL);
+#endif
+#if (DEF_TOUCH_DATA_STREAMER_CAPTURE == 1u)
+	datastreamer_capture_init();
+#endif
 }
 
 /*============================================================================
@@ -96,16 +132,160 @@ void datastreamer_transmit(uint8_t data_byte)
 /*============================================================================
 void datastreamer_output(void)
 ------------------------------------------------------------------------------
+Purpose: Collects the module data of the current acquisition into a frame.
+         The frame is either queued for datastreamer_process() or recorded
+         into the capture buffer, depending on
+         DEF_TOUCH_DATA_STREAMER_CAPTURE.
+Input  : none
+Output : none
+Notes  : Called from the library callbacks, so nothing is transmitted here.
+         The sensor data comes from the acquisition snapshot, never a mix
+         of two acquisitions while the EOC interrupt stores the next one.
+         Compensation, key threshold and error code are taken here as well,
+         into the status that goes with the frame.
+============================================================================*/
+void datastreamer_output(void)
+{
+	const touch_snapshot_t *snapshot = touch_get_snapshot();
+	datastreamer_frame_t    frame;
+	datastreamer_status_t   status;
+	uint16_t                count_bytes_out;
+	int16_t                 temp_int_calc;
+
+#if (DEF_TOUCH_DATA_STREAMER_TIMESTAMP == 1u)
+	frame.timestamp = snapshot->timestamp;
+#endif
+
+	for (count_bytes_out = 0u; count_bytes_out < DEF_NUM_CHANNELS; count_bytes_out++) {
+		frame.node[count_bytes_out].signal    = snapshot->node[count_bytes_out].signal;
+		frame.node[count_bytes_out].reference = snapshot->node[count_bytes_out].reference;
+
+		/* Touch delta */
+		temp_int_calc = touch_detect_delta(frame.node[count_bytes_out].signal, frame.node[count_bytes_out].reference);
+
+		/* delta smoothing */
+		frame.node[count_bytes_out].delta = TOUCH_DeltaSmoothing(temp_int_calc);
+
+		frame.node[count_bytes_out].threshold = TOUCH_GetTouchSignal();
+		frame.node[count_bytes_out].state     = snapshot->node[count_bytes_out].state;
+
+		status.comp_caps[count_bytes_out]     = snapshot->node[count_bytes_out].comp_caps;
+		status.key_threshold[count_bytes_out] = DS_KEY_THRESHOLD(count_bytes_out);
+	}
+	status.error_code = module_error_code;
+
+#if (DEF_TOUCH_DATA_STREAMER_CAPTURE == 1u)
+	datastreamer_capture_record(&frame, &status);
+#else
+	/* a frame not sent yet is replaced by the newer one */
+	datastreamer_queued_frame  = frame;
+	datastreamer_queued_status = status;
+	datastreamer_queued        = 1u;
+#endif
+	perf_count(PERF_DS_FRAMES);
+}
+
+/*============================================================================
+void datastreamer_process(void)
+------------------------------------------------------------------------------
+Purpose: Transmits the frame queued by datastreamer_output(), or a finished
+         capture burst.
+Input  : none
+Output : none
+Notes  : Called from the main loop after the detection has acted on the
+         measurement, the transmission no longer delays it.
+============================================================================*/
+void datastreamer_process(void)
+{
+#if (DEF_TOUCH_DATA_STREAMER_CAPTURE == 1u)
+	datastreamer_capture_process();
+#else
+	if (datastreamer_queued) {
+		datastreamer_queued = 0u;
+		datastreamer_send_frame(&datastreamer_queued_frame, &datastreamer_queued_status);
+	}
+#endif
+}
+
+/*============================================================================
+void datastreamer_set_event(uint8_t reason)
+------------------------------------------------------------------------------
+Purpose: Attaches a trigger reason to the next transmitted frame.
+Input  : CAPTURE_TRIGGER_xxx reason, 0 for none
+Output : none
+Notes  : Only the compact frame format has room for the reason.
+============================================================================*/
+void datastreamer_set_event(uint8_t reason)
+{
+	datastreamer_event = reason;
+}
+
+#if (DEF_TOUCH_DATA_STREAMER_FORMAT == DATASTREAMER_FORMAT_COMPACT)
+
+/*============================================================================
+void datastreamer_send_frame(const datastreamer_frame_t *frame,
+                             const datastreamer_status_t *status)
+------------------------------------------------------------------------------
+Purpose: Encodes the frame in the compact format and transmits it through the
+         UART port.
+Input  : frame and status recorded by datastreamer_output()
+Output : none
+Notes  : Field order is defined in datastreamer_frame.h.
+============================================================================*/
+void datastreamer_send_frame(const datastreamer_frame_t *frame, const datastreamer_status_t *status)
+{
+	uint16_t fields[DS_NUM_FIELDS];
+	uint8_t  buffer[DS_FRAME_LEN_MAX(DS_NUM_FIELDS) + DS_FRAME_OVERHEAD];
+	uint8_t  flags = 0u;
+	uint8_t  i, len, node;
+
+	i = 0u;
+#if (DEF_TOUCH_DATA_STREAMER_TIMESTAMP == 1u)
+	flags |= DS_FLAG_TIMESTAMP;
+	fields[i++] = frame->timestamp;
+#endif
+
+	for (node = 0u; node < DEF_NUM_CHANNELS; node++) {
+		fields[i++] = frame->node[node].signal;
+		fields[i++] = frame->node[node].reference;
+		fields[i++] = (uint16_t)frame->node[node].delta;
+		fields[i++] = frame->node[node].threshold;
+		fields[i++] = status->comp_caps[node];
+		fields[i++] = frame->node[node].state;
+		fields[i++] = status->key_threshold[node];
+	}
+	fields[i++] = status->error_code;
+
+	if (datastreamer_event != 0u) {
+		flags |= DS_FLAG_EVENT;
+	}
+
+	len                = ds_frame_encode(&ds_encoder, buffer, fields, DEF_NUM_CHANNELS, flags, datastreamer_event);
+	datastreamer_event = 0u;
+
+	for (i = 0u; i < len; i++) {
+		datastreamer_transmit(buffer[i]);
+	}
+}
+
+#else
+
+/*============================================================================
+void datastreamer_send_frame(const datastreamer_frame_t *frame,
+                             const datastreamer_status_t *status)
+------------------------------------------------------------------------------
 Purpose: Forms the datastreamer frame based on the configured modules, Tranmits
          the frame as single packet through UART port.
-Input  : none
+Input  : frame and status recorded by datastreamer_output()
 Output : none
 Notes  : The data visualizer scripts that are generated in the project should be
          set on the data visualizer software.
+         The Reference0 slot carries the edge threshold, the channel reference
+         is only kept in the frame.
 ============================================================================*/
-void datastreamer_output(void)
+void datastreamer_send_frame(const datastreamer_frame_t *frame, const datastreamer_status_t *status)
 {
-	int16_t           i, temp_int_calc;
+	int16_t           i;
 	static uint8_t    sequence = 0u;
 	uint16_t          u16temp_output;
 	uint8_t           u8temp_output, send_header;
@@ -126,31 +306,22 @@ void datastreamer_output(void)
 
 	for (count_bytes_out = 0u; count_bytes_out < DEF_NUM_CHANNELS; count_bytes_out++) {
 		/* Signals */
-		u16temp_output = get_sensor_node_signal(count_bytes_out);
+		u16temp_output = frame->node[count_bytes_out].signal;
 		datastreamer_transmit((uint8_t)u16temp_output);
 		datastreamer_transmit((uint8_t)(u16temp_output >> 8u));
 
 		/* Reference */
-		u16temp_output = get_sensor_node_reference(count_bytes_out);
-		u16temp_output = TOUCH_GetTouchSignal();
+		u16temp_output = frame->node[count_bytes_out].threshold;
 		datastreamer_transmit((uint8_t)u16temp_output);
 		datastreamer_transmit((uint8_t)(u16temp_output >> 8u));
-		
-		
 
 		/* Touch delta */
-		temp_int_calc = get_sensor_node_signal(count_bytes_out);
-		temp_int_calc -= get_sensor_node_reference(count_bytes_out);
-		
-		/* delta smoothing */
-		temp_int_calc = TOUCH_DeltaSmoothing(temp_int_calc);
-		
-		u16temp_output = (uint16_t)(temp_int_calc);
+		u16temp_output = (uint16_t)(frame->node[count_bytes_out].delta);
 		datastreamer_transmit((uint8_t)u16temp_output);
 		datastreamer_transmit((uint8_t)(u16temp_output >> 8u));
 
 		/* Comp Caps */
-		u16temp_output = get_sensor_cc_val(count_bytes_out);
+		u16temp_output = status->comp_caps[count_bytes_out];
 		//u16temp_output = TOUCH_SNR();
 		
 		datastreamer_transmit((uint8_t)u16temp_output);
@@ -169,7 +340,7 @@ void datastreamer_output(void)
 #endif
 #endif
 		/* State */
-		u8temp_output = get_sensor_state(count_bytes_out);
+		u8temp_output = frame->node[count_bytes_out].state;
 		if (0u != (u8temp_output & 0x80)) {
 			datastreamer_transmit(0x01);
 		} else {
@@ -177,7 +348,7 @@ void datastreamer_output(void)
 		}
 
 		/* Threshold */
-		datastreamer_transmit(qtlib_key_configs_set1[count_bytes_out].channel_threshold);
+		datastreamer_transmit(status->key_threshold[count_bytes_out]);
 	}
 
 #if (SCROLLER_MODULE_OUTPUT == 1)
@@ -223,13 +394,17 @@ void datastreamer_output(void)
 #endif
 		
 	/* Other Debug Parameters */
-	datastreamer_transmit(module_error_code);
+	datastreamer_transmit(status->error_code);
 	
 	/* Frame End */
 	datastreamer_transmit(sequence++);
 
 	/* End token */
 	datastreamer_transmit(~0x55);
+
+	datastreamer_event = 0u;
 }
 
+#endif /* DEF_TOUCH_DATA_STREAMER_FORMAT */
+
 #endif
@@ -0,0 +1,185 @@
+/*============================================================================
+Filename : datastreamer_capture.c
+Project : Attiny814Code
+Purpose : Pre-trigger capture buffer for the datastreamer. Every frame is
+          recorded into a RAM ring buffer; the buffer is only transmitted as
+          a burst once a trigger has fired and the post-trigger frames have
+          been recorded. The burst goes out from the main loop, in
+          datastreamer_capture_process().
+============================================================================*/
+
+/*----------------------------------------------------------------------------
+  include files
+----------------------------------------------------------------------------*/
+#include "datastreamer.h"
+
+#if (DEF_TOUCH_DATA_STREAMER_ENABLE == 1u) && (DEF_TOUCH_DATA_STREAMER_CAPTURE == 1u)
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *--------------------------------------------------------------------------*/
+#if (DEF_CAPTURE_DEPTH & (DEF_CAPTURE_DEPTH - 1u)) != 0u
+#error "DEF_CAPTURE_DEPTH must be a power of two"
+#endif
+
+#if DEF_CAPTURE_POST_FRAMES >= DEF_CAPTURE_DEPTH
+#error "DEF_CAPTURE_POST_FRAMES must be smaller than DEF_CAPTURE_DEPTH"
+#endif
+
+#define CAPTURE_INDEX_MASK (DEF_CAPTURE_DEPTH - 1u)
+
+/* post_count value while no trigger is pending */
+#define CAPTURE_IDLE 0xFFu
+
+/*----------------------------------------------------------------------------
+  global variables
+----------------------------------------------------------------------------*/
+static datastreamer_frame_t capture_buffer[DEF_CAPTURE_DEPTH];
+
+/* status of the newest frame in the buffer, sent with the whole burst */
+static datastreamer_status_t capture_status;
+
+/* index of the slot the next frame is written to */
+static uint8_t capture_head;
+
+/* number of valid frames in the buffer, saturates at DEF_CAPTURE_DEPTH */
+static uint8_t capture_fill;
+
+/* frames still to be recorded before the burst is sent */
+static uint8_t capture_post_count = CAPTURE_IDLE;
+
+/* OR of the trigger reasons seen since the last burst */
+static uint8_t capture_trigger_reason;
+
+/* burst complete, waiting for datastreamer_capture_process() */
+static uint8_t capture_flush_pending;
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *--------------------------------------------------------------------------*/
+static void datastreamer_capture_flush(void);
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *--------------------------------------------------------------------------*/
+
+/*============================================================================
+void datastreamer_capture_init(void)
+------------------------------------------------------------------------------
+Purpose: Empties the capture buffer and disarms any pending trigger.
+Input  : none
+Output : none
+Notes  :
+============================================================================*/
+void datastreamer_capture_init(void)
+{
+	capture_head           = 0u;
+	capture_fill           = 0u;
+	capture_post_count     = CAPTURE_IDLE;
+	capture_trigger_reason = 0u;
+	capture_flush_pending  = 0u;
+}
+
+/*============================================================================
+void datastreamer_capture_record(const datastreamer_frame_t *frame,
+                                 const datastreamer_status_t *status)
+------------------------------------------------------------------------------
+Purpose: Stores one frame into the ring buffer, overwriting the oldest frame
+         once the buffer is full. Marks the burst for sending when the last
+         post-trigger frame has been recorded.
+Input  : frame to be recorded, status of its acquisition
+Output : none
+Notes  : Called once per acquisition from datastreamer_output(). Only the
+         newest status is kept, one per burst instead of one per frame.
+============================================================================*/
+void datastreamer_capture_record(const datastreamer_frame_t *frame, const datastreamer_status_t *status)
+{
+	capture_buffer[capture_head] = *frame;
+	capture_status               = *status;
+	capture_head                 = (capture_head + 1u) & CAPTURE_INDEX_MASK;
+
+	if (capture_fill < DEF_CAPTURE_DEPTH) {
+		capture_fill++;
+	}
+
+	/* 0: the burst waits for datastreamer_capture_process() */
+	if (capture_post_count == CAPTURE_IDLE || capture_post_count == 0u) {
+		return;
+	}
+
+	if (--capture_post_count == 0u) {
+		capture_flush_pending = 1u;
+	}
+}
+
+/*============================================================================
+void datastreamer_capture_trigger(uint8_t reason)
+------------------------------------------------------------------------------
+Purpose: Arms the capture buffer. The burst is sent after
+         DEF_CAPTURE_POST_FRAMES further frames have been recorded.
+Input  : CAPTURE_TRIGGER_xxx reason
+Output : none
+Notes  : The frame of the triggering acquisition has already been recorded.
+         A trigger that fires while another one is pending only adds its
+         reason; it does not extend the post-trigger window.
+============================================================================*/
+void datastreamer_capture_trigger(uint8_t reason)
+{
+	capture_trigger_reason |= reason;
+
+	if (capture_post_count != CAPTURE_IDLE) {
+		return;
+	}
+
+#if DEF_CAPTURE_POST_FRAMES == 0u
+	capture_flush_pending = 1u;
+#else
+	capture_post_count = DEF_CAPTURE_POST_FRAMES;
+#endif
+}
+
+/*============================================================================
+void datastreamer_capture_process(void)
+------------------------------------------------------------------------------
+Purpose: Sends a complete burst.
+Input  : none
+Output : none
+Notes  : Called from datastreamer_process() in the main loop.
+============================================================================*/
+void datastreamer_capture_process(void)
+{
+	if (capture_flush_pending) {
+		datastreamer_capture_flush();
+	}
+}
+
+/*============================================================================
+static void datastreamer_capture_flush(void)
+------------------------------------------------------------------------------
+Purpose: Transmits all valid frames of the ring buffer, oldest first, and
+         empties the buffer.
+Input  : none
+Output : none
+Notes  :
+============================================================================*/
+static void datastreamer_capture_flush(void)
+{
+	uint8_t index;
+
+	index = (capture_head - capture_fill) & CAPTURE_INDEX_MASK;
+
+	/* first frame of the burst carries the trigger reason */
+	datastreamer_set_event(capture_trigger_reason);
+
+	while (capture_fill != 0u) {
+		datastreamer_send_frame(&capture_buffer[index], &capture_status);
+		index = (index + 1u) & CAPTURE_INDEX_MASK;
+		capture_fill--;
+	}
+
+	capture_post_count     = CAPTURE_IDLE;
+	capture_trigger_reason = 0u;
+	capture_flush_pending  = 0u;
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*============================================================================
+Filename : datastreamer_frame.c
+Project : Attiny814Code
+Purpose : Encoder for the compact datastreamer frame format described in
+          datastreamer_frame.h. Hardware independent, also built on the host.
+============================================================================*/
+
+/*----------------------------------------------------------------------------
+  include files
+----------------------------------------------------------------------------*/
+#include "datastreamer_frame.h"
+
+#ifdef __AVR__
+#include <util/crc16.h>
+#endif
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *--------------------------------------------------------------------------*/
+static uint8_t ds_put_varint(uint8_t *out, uint16_t value);
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *--------------------------------------------------------------------------*/
+
+/*============================================================================
+uint16_t ds_crc16_update(uint16_t crc, uint8_t data)
+------------------------------------------------------------------------------
+Purpose: CRC-16/CCITT-FALSE (polynomial 0x1021, MSB first) of one byte.
+Input  : running crc, start with DS_CRC16_INIT; next data byte
+Output : updated crc
+Notes  : Uses the avr-libc inline assembler version on the target.
+============================================================================*/
+uint16_t ds_crc16_update(uint16_t crc, uint8_t data)
+{
+#ifdef __AVR__
+	return _crc_xmodem_update(crc, data);
+#else
+	uint8_t i;
+
+	crc ^= (uint16_t)data << 8u;
+	for (i = 0u; i < 8u; i++) {
+		if (crc & 0x8000u) {
+			crc = (uint16_t)(crc << 1u) ^ 0x1021u;
+		} else {
+			crc <<= 1u;
+		}
+	}
+	return crc;
+#endif
+}
+
+/*============================================================================
+void ds_encoder_init(ds_encoder_t *enc, uint16_t *prev, uint8_t num_fields,
+                     uint8_t keyframe_interval)
+------------------------------------------------------------------------------
+Purpose: Initializes the encoder state. The first frame is a keyframe.
+Input  : encoder; history storage of num_fields entries; number of fields of
+         every frame; a keyframe is sent every keyframe_interval frames
+Output : none
+Notes  :
+============================================================================*/
+void ds_encoder_init(ds_encoder_t *enc, uint16_t *prev, uint8_t num_fields, uint8_t keyframe_interval)
+{
+	enc->prev              = prev;
+	enc->num_fields        = num_fields;
+	enc->seq               = 0u;
+	enc->keyframe_interval = keyframe_interval;
+	enc->keyframe_count    = 0u;
+}
+
+/*============================================================================
+static uint8_t ds_put_varint(uint8_t *out, uint16_t value)
+------------------------------------------------------------------------------
+Purpose: Writes value as LEB128 varint.
+Input  : output buffer, value
+Output : number of bytes written (1 to 3)
+Notes  :
+============================================================================*/
+static uint8_t ds_put_varint(uint8_t *out, uint16_t value)
+{
+	uint8_t len = 0u;
+
+	while (value >= 0x80u) {
+		out[len++] = (uint8_t)value | 0x80u;
+		value >>= 7u;
+	}
+	out[len++] = (uint8_t)value;
+
+	return len;
+}
+
+/*============================================================================
+uint8_t ds_frame_encode(ds_encoder_t *enc, uint8_t *out, const uint16_t *fields,
+                        uint8_t num_channels, uint8_t flags, uint8_t event)
+------------------------------------------------------------------------------
+Purpose: Encodes one complete frame, SOF to CRC, into out.
+Input  : encoder; output buffer of at least
+         DS_FRAME_LEN_MAX(num_fields) + DS_FRAME_OVERHEAD bytes;
+         enc->num_fields field values; channel count; DS_FLAG_TIMESTAMP and
+         DS_FLAG_EVENT as required; trigger reason for DS_FLAG_EVENT
+Output : number of bytes written to out
+Notes  : DS_FLAG_KEYFRAME is added by the encoder itself. The timestamp flag
+         must not change between frames of the same encoder.
+============================================================================*/
+uint8_t ds_frame_encode(ds_encoder_t *enc, uint8_t *out, const uint16_t *fields, uint8_t num_channels, uint8_t flags,
+                        uint8_t event)
+{
+	uint8_t  len, i;
+	uint16_t diff, crc;
+
+	flags &= (uint8_t) ~DS_FLAG_KEYFRAME;
+
+	if (enc->keyframe_count == 0u) {
+		flags |= DS_FLAG_KEYFRAME;
+		for (i = 0u; i < enc->num_fields; i++) {
+			enc->prev[i] = 0u;
+		}
+		enc->keyframe_count = enc->keyframe_interval;
+	}
+	enc->keyframe_count--;
+
+	out[0] = DS_FRAME_SOF;
+	len    = 2u; /* out[1] is LEN, filled in below */
+
+	out[len++] = (uint8_t)(DS_FRAME_VERSION << 4u) | flags;
+	out[len++] = enc->seq++;
+	if (flags & DS_FLAG_EVENT) {
+		out[len++] = event;
+	}
+	out[len++] = num_channels;
+
+	for (i = 0u; i < enc->num_fields; i++) {
+		/* zigzag coded 16-bit difference */
+		diff         = fields[i] - enc->prev[i];
+		diff         = (uint16_t)(diff << 1u) ^ (uint16_t)(0u - (diff >> 15u));
+		enc->prev[i] = fields[i];
+		len += ds_put_varint(&out[len], diff);
+	}
+
+	out[1] = len - 2u;
+
+	crc = DS_CRC16_INIT;
+	for (i = 1u; i < len; i++) {
+		crc = ds_crc16_update(crc, out[i]);
+	}
+	out[len++] = (uint8_t)crc;
+	out[len++] = (uint8_t)(crc >> 8u);
+
+	return len;
+}
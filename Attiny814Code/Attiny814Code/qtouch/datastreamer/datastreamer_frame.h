@@ -0,0 +1,101 @@
+/*============================================================================
+Filename : datastreamer_frame.h
+Project : Attiny814Code
+Purpose : Compact datastreamer frame format. Shared between the firmware
+          encoder and the host decoder, so it must not depend on any AVR
+          header.
+
+Frame layout (all multi-byte values little endian):
+
+    SOF    0xA5
+    LEN    number of bytes from VER up to the last payload byte
+    VER    (DS_FRAME_VERSION << 4) | DS_FLAG_xxx
+    SEQ    frame sequence number, incremented for every frame
+    [EVT]  trigger reason, only present with DS_FLAG_EVENT
+    NCH    number of channels
+    FIELDS varint coded fields, see below
+    CRC    CRC-16/CCITT-FALSE over LEN..last payload byte
+
+Fields are sent in the order
+    [timestamp]                                 only with DS_FLAG_TIMESTAMP
+    NCH x {signal, reference, delta, threshold, comp cap, state, key threshold}
+    module error code
+Every field is a 16-bit value. Each one is sent as the zigzag coded 16-bit
+difference to the same field of the previous frame, in LEB128 varint form
+(1 to 3 bytes). A frame with DS_FLAG_KEYFRAME is coded against zero, so it
+can be decoded without any history.
+============================================================================*/
+
+#ifndef DATASTREAMER_FRAME_H
+#define DATASTREAMER_FRAME_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+#define DS_FRAME_SOF 0xA5u
+#define DS_FRAME_VERSION 1u
+
+/* VER byte flags */
+#define DS_FLAG_KEYFRAME 0x01u
+#define DS_FLAG_TIMESTAMP 0x02u
+#define DS_FLAG_EVENT 0x04u
+#define DS_FLAG_MASK 0x0Fu
+
+/* Field layout */
+#define DS_FIELDS_PER_CHANNEL 7u
+#define DS_FIELDS_GLOBAL 1u
+
+#define DS_FIELD_SIGNAL 0u
+#define DS_FIELD_REFERENCE 1u
+#define DS_FIELD_DELTA 2u
+#define DS_FIELD_THRESHOLD 3u
+#define DS_FIELD_COMP_CAP 4u
+#define DS_FIELD_STATE 5u
+#define DS_FIELD_KEY_THRESHOLD 6u
+
+/* Size of SOF, LEN and CRC around the LEN counted bytes */
+#define DS_FRAME_OVERHEAD 4u
+
+/* Largest value LEN can take */
+#define DS_FRAME_MAX_LEN 255u
+
+/* Worst case LEN for a frame with num_fields fields */
+#define DS_FRAME_LEN_MAX(num_fields) (4u + 3u * (num_fields))
+
+/* Number of fields of a frame */
+#define DS_FRAME_NUM_FIELDS(num_channels, timestamp)                                                                   \
+	((timestamp) + (num_channels)*DS_FIELDS_PER_CHANNEL + DS_FIELDS_GLOBAL)
+
+#define DS_CRC16_INIT 0xFFFFu
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+/* Encoder state. prev must hold num_fields entries. */
+typedef struct {
+	uint16_t *prev;
+	uint8_t   num_fields;
+	uint8_t   seq;
+	uint8_t   keyframe_interval;
+	uint8_t   keyframe_count;
+} ds_encoder_t;
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *----------------------------------------------------------------------------*/
+void     ds_encoder_init(ds_encoder_t *enc, uint16_t *prev, uint8_t num_fields, uint8_t keyframe_interval);
+uint8_t  ds_frame_encode(ds_encoder_t *enc, uint8_t *out, const uint16_t *fields, uint8_t num_channels, uint8_t flags,
+                         uint8_t event);
+uint16_t ds_crc16_update(uint16_t crc, uint8_t data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DATASTREAMER_FRAME_H */
@@ -32,8 +32,16 @@ Copyright (c) 2017 Microchip. All rights reserved.
 
 #include "port.h"
 #include <atmel_start.h>
+#include <atomic.h>
 
 #include "datastreamer.h"
+#include "touch_detect.h"
+#include "perf_counter.h"
+#include "gpio.h"
+
+#if (DEF_TOUCH_KEY_MODULE == 0u) && (DEF_NUM_CHANNELS != 1)
+#error "touch_detect_baseline() tracks a single node"
+#endif
 
 /*----------------------------------------------------------------------------
  *   prototypes
@@ -85,45 +93,66 @@ uint8_t module_error_code = 0;
 /* Acquisition module internal data - Size to largest acquisition set */
 uint16_t touch_acq_signals_raw[DEF_NUM_CHANNELS];
 
+/* Timer ticks since reset, used as datastreamer sample timestamp */
+static volatile uint16_t touch_timer_ticks;
+
+/* Acquisition snapshots: the front one is published, the EOC interrupt
+ * captures into the other one */
+static touch_snapshot_t touch_snapshots[2];
+static volatile uint8_t touch_snapshot_front;
+/* captures since reset, wraps; tells the publisher a capture came in */
+static volatile uint8_t touch_capture_seq;
+
+/* Read only tables are const: the ATtiny814 maps the flash into the data
+ * space, the library reads them through its data pointers without a copy in
+ * SRAM. Tables the library or the application write stay in RAM. */
+
 /* Acquisition set 1 - General settings */
-qtm_acq_node_group_config_t ptc_qtlib_acq_gen1
+const qtm_acq_node_group_config_t ptc_qtlib_acq_gen1
     = {DEF_NUM_CHANNELS, DEF_SENSOR_TYPE, DEF_PTC_CAL_AUTO_TUNE, DEF_SEL_FREQ_INIT};
 
 /* Node status, signal, calibration values */
 qtm_acq_node_data_t ptc_qtlib_node_stat1[DEF_NUM_CHANNELS];
 
-/* Node configurations */
+/* Node configurations, in RAM: the CSD auto tuning writes node_csd */
 qtm_acq_t81x_node_config_t ptc_seq_node_cfg1[DEF_NUM_CHANNELS] = {NODE_0_PARAMS};
 
 /* Container */
-qtm_acquisition_control_t qtlib_acq_set1 = {&ptc_qtlib_acq_gen1, &ptc_seq_node_cfg1[0], &ptc_qtlib_node_stat1[0]};
+qtm_acquisition_control_t qtlib_acq_set1
+    = {(qtm_acq_node_group_config_t *)&ptc_qtlib_acq_gen1, &ptc_seq_node_cfg1[0], &ptc_qtlib_node_stat1[0]};
 
 /**********************************************************/
 /*********************** Keys Module **********************/
 /**********************************************************/
+#if DEF_TOUCH_KEY_MODULE == 1u
 
 /* Keys set 1 - General settings */
-qtm_touch_key_group_config_t qtlib_key_grp_config_set1 = {DEF_NUM_SENSORS,
-                                                          DEF_TOUCH_DET_INT,
-                                                          DEF_MAX_ON_DURATION,
-                                                          DEF_ANTI_TCH_DET_INT,
-                                                          DEF_ANTI_TCH_RECAL_THRSHLD,
-                                                          DEF_TCH_DRIFT_RATE,
-                                                          DEF_ANTI_TCH_DRIFT_RATE,
-                                                          DEF_DRIFT_HOLD_TIME,
-                                                          DEF_REBURST_MODE};
+const qtm_touch_key_group_config_t qtlib_key_grp_config_set1 = {DEF_NUM_SENSORS,
+                                                                DEF_TOUCH_DET_INT,
+                                                                DEF_MAX_ON_DURATION,
+                                                                DEF_ANTI_TCH_DET_INT,
+                                                                DEF_ANTI_TCH_RECAL_THRSHLD,
+                                                                DEF_TCH_DRIFT_RATE,
+                                                                DEF_ANTI_TCH_DRIFT_RATE,
+                                                                DEF_DRIFT_HOLD_TIME,
+                                                                DEF_REBURST_MODE};
 
 qtm_touch_key_group_data_t qtlib_key_grp_data_set1;
 
 /* Key data */
 qtm_touch_key_data_t qtlib_key_data_set1[DEF_NUM_SENSORS];
 
-/* Key Configurations */
+/* Key Configurations, in RAM: channel_threshold is tuned at run time through
+ * PARAM_KEY_THRESHOLD, see cmd_param_table */
 qtm_touch_key_config_t qtlib_key_configs_set1[DEF_NUM_SENSORS] = {KEY_0_PARAMS};
 
 /* Container */
 qtm_touch_key_control_t qtlib_key_set1
-    = {&qtlib_key_grp_data_set1, &qtlib_key_grp_config_set1, &qtlib_key_data_set1[0], &qtlib_key_configs_set1[0]};
+    = {&qtlib_key_grp_data_set1,
+       (qtm_touch_key_group_config_t *)&qtlib_key_grp_config_set1,
+       &qtlib_key_data_set1[0],
+       &qtlib_key_configs_set1[0]};
+#endif
 
 /**********************************************************/
 /****************  Binding Layer Module  ******************/
@@ -133,20 +162,35 @@ qtm_touch_key_control_t qtlib_key_set1
 		(module_init_t) & qtm_ptc_init_acquisition_module, null                                                        \
 	}
 
+#if DEF_TOUCH_KEY_MODULE == 1u
 #define LIB_MODULES_PROC_LIST                                                                                          \
 	{                                                                                                                  \
 		(module_proc_t) & qtm_key_sensors_process, null                                                                \
 	}
+#else
+/* no post processing module, see qtm_post_process_complete() */
+#define LIB_MODULES_PROC_LIST                                                                                          \
+	{                                                                                                                  \
+		null                                                                                                           \
+	}
+#endif
 
 #define LIB_INIT_DATA_MODELS_LIST                                                                                      \
 	{                                                                                                                  \
 		(void *)&qtlib_acq_set1, null                                                                                  \
 	}
 
+#if DEF_TOUCH_KEY_MODULE == 1u
 #define LIB_DATA_MODELS_PROC_LIST                                                                                      \
 	{                                                                                                                  \
 		(void *)&qtlib_key_set1, null                                                                                  \
 	}
+#else
+#define LIB_DATA_MODELS_PROC_LIST                                                                                      \
+	{                                                                                                                  \
+		null                                                                                                           \
+	}
+#endif
 
 #define LIB_MODULES_ACQ_ENGINES_LIST                                                                                   \
 	{                                                                                                                  \
@@ -158,14 +202,14 @@ qtm_touch_key_control_t qtlib_key_set1
 		(void *)&qtlib_acq_set1, null                                                                                  \
 	}
 
-/* QTM run time options */
-module_init_t library_modules_init[]            = LIB_MODULES_INIT_LIST;
-module_proc_t library_modules_proc[]            = LIB_MODULES_PROC_LIST;
-module_arg_t  library_module_init_data_models[] = LIB_INIT_DATA_MODELS_LIST;
-module_acq_t  library_modules_acq_engines[]     = LIB_MODULES_ACQ_ENGINES_LIST;
+/* QTM run time options, read only */
+const module_init_t library_modules_init[]            = LIB_MODULES_INIT_LIST;
+const module_proc_t library_modules_proc[]            = LIB_MODULES_PROC_LIST;
+const module_arg_t  library_module_init_data_models[] = LIB_INIT_DATA_MODELS_LIST;
+const module_acq_t  library_modules_acq_engines[]     = LIB_MODULES_ACQ_ENGINES_LIST;
 
-module_arg_t library_module_acq_engine_data_model[] = LIB_MODULES_ACQ_ENGINES_LIST_DM;
-module_arg_t library_module_proc_data_model[]       = LIB_DATA_MODELS_PROC_LIST;
+const module_arg_t library_module_acq_engine_data_model[] = LIB_MODULES_ACQ_ENGINES_LIST_DM;
+const module_arg_t library_module_proc_data_model[]       = LIB_DATA_MODELS_PROC_LIST;
 
 /*----------------------------------------------------------------------------
  *   function definitions
@@ -185,22 +229,22 @@ static void build_qtm_config(qtm_control_t *qtm)
 	qtm->binding_layer_flags = 0x00u;
 
 	/*!< List of function pointers to acquisition sets */
-	qtm->library_modules_init = library_modules_init;
+	qtm->library_modules_init = (module_init_t *)library_modules_init;
 
 	/*!< List of function pointers to post processing modules  */
-	qtm->library_modules_proc = library_modules_proc;
+	qtm->library_modules_proc = (module_proc_t *)library_modules_proc;
 
 	/*!< List of Acquisition Engines (Acq Modules one per AcqSet */
-	qtm->library_modules_acq = library_modules_acq_engines;
+	qtm->library_modules_acq = (module_acq_t *)library_modules_acq_engines;
 
 	/*!< Data Model for Acquisition modules  */
-	qtm->library_module_init_data_model = library_module_init_data_models;
+	qtm->library_module_init_data_model = (module_arg_t *)library_module_init_data_models;
 
 	/*!< Data Model for post processing modules  */
-	qtm->library_module_proc_data_model = library_module_proc_data_model;
+	qtm->library_module_proc_data_model = (module_arg_t *)library_module_proc_data_model;
 
 	/*!< Data model for inline module processes  */
-	qtm->library_modules_acq_dm = library_module_acq_engine_data_model;
+	qtm->library_modules_acq_dm = (module_arg_t *)library_module_acq_engine_data_model;
 
 	/*!< Post porcessing pointer */
 	qtm->qtm_acq_pp = qtm_acquisition_process;
@@ -243,10 +287,12 @@ static touch_ret_t touch_sensors_config(void)
 		qtm_calibrate_sensor_node(&qtlib_acq_set1, sensor_nodes);
 	}
 
+#if DEF_TOUCH_KEY_MODULE == 1u
 	/* Enable sensor keys and assign nodes */
 	for (sensor_nodes = 0u; sensor_nodes < DEF_NUM_CHANNELS; sensor_nodes++) {
 		qtm_init_sensor_key(&qtlib_key_set1, sensor_nodes, &ptc_qtlib_node_stat1[sensor_nodes]);
 	}
+#endif
 
 	return (touch_ret);
 }
@@ -274,13 +320,62 @@ Purpose: Callback function from binding layer called after the completion of
          flag to trigger the post processing.
 Input  : none
 Output : none
-Notes  :
+Notes  : Called from the EOC interrupt once all nodes are measured, the
+         signals of the acquisition go to the back snapshot here.
 ============================================================================*/
 static void qtm_measure_complete_callback(void)
 {
+	touch_snapshot_t *back = &touch_snapshots[touch_snapshot_front ^ 1u];
+	uint8_t           node;
+
+	for (node = 0u; node < DEF_NUM_CHANNELS; node++) {
+		back->node[node].signal    = ptc_qtlib_node_stat1[node].node_acq_signals;
+		back->node[node].comp_caps = ptc_qtlib_node_stat1[node].node_comp_caps;
+	}
+	back->timestamp = touch_timer_ticks;
+	touch_capture_seq++;
+
 	qtm_control.binding_layer_flags |= (1 << node_pp_request);
 }
 
+/*============================================================================
+static uint8_t touch_publish_snapshot(void)
+------------------------------------------------------------------------------
+Purpose: Completes the back snapshot with the post processed reference and
+         state and makes it the front one.
+Input  : none
+Output : 1 when published
+Notes  : Runs in the main loop, as the readers of touch_get_snapshot(), so
+         the swap can not happen during a read. When the EOC interrupt
+         captured a newer acquisition meanwhile, the back snapshot mixes
+         two acquisitions and is left for the post processing of the
+         newer one: nothing is published. The check and the swap run with
+         the interrupts off, a capture between them would land in the
+         snapshot being published.
+============================================================================*/
+static uint8_t touch_publish_snapshot(void)
+{
+	uint8_t           front = touch_snapshot_front;
+	touch_snapshot_t *back  = &touch_snapshots[front ^ 1u];
+	uint8_t           seq   = touch_capture_seq;
+	uint8_t           published = 0u;
+	uint8_t           node;
+
+	for (node = 0u; node < DEF_NUM_CHANNELS; node++) {
+		back->node[node].reference = get_sensor_node_reference(node);
+		back->node[node].state     = get_sensor_state(node);
+	}
+
+	ENTER_CRITICAL(P);
+	if (seq == touch_capture_seq) {
+		touch_snapshot_front = front ^ 1u;
+		published            = 1u;
+	}
+	EXIT_CRITICAL(P);
+
+	return published;
+}
+
 /*============================================================================
 static void qtm_post_process_complete(void)
 ------------------------------------------------------------------------------
@@ -294,11 +389,25 @@ Notes  :
 ============================================================================*/
 static void qtm_post_process_complete(void)
 {
+	perf_count(PERF_ACQUISITIONS);
+
+#if DEF_TOUCH_KEY_MODULE == 1u
 	if ((0u != (qtlib_key_set1.qtm_touch_key_group_data->qtm_keys_status & 0x80u))) {
 		p_qtm_control->binding_layer_flags |= (1u << reburst_request);
+		perf_count(PERF_REBURSTS);
 	} else {
 		measurement_done_touch = 1;
 	}
+#else
+	/* reference tracking in place of the key module, never a reburst */
+	touch_detect_baseline(touch_snapshots[touch_snapshot_front ^ 1u].node[0].signal);
+	measurement_done_touch = 1;
+#endif
+	/* the detection and the datastreamer see every acquisition once */
+	if (!touch_publish_snapshot()) {
+		measurement_done_touch = 0;
+		return;
+	}
 	
 #if DEF_TOUCH_DATA_STREAMER_ENABLE == 1
 	datastreamer_output();
@@ -338,6 +447,8 @@ Derived Module_error_codes:
 ============================================================================*/
 static void qtm_error_callback(uint8_t error)
 {
+	perf_count(PERF_QTM_ERRORS);
+
 	module_error_code = 0;
 	if (error & 0x80) {
 		module_error_code = 1;
@@ -347,6 +458,7 @@ static void qtm_error_callback(uint8_t error)
 
 #if DEF_TOUCH_DATA_STREAMER_ENABLE == 1
 	datastreamer_output();
+	datastreamer_capture_trigger(CAPTURE_TRIGGER_ERROR);
 #endif
 }
 
@@ -412,14 +524,18 @@ void touch_process(void)
 
 	/* check the time_to_measure_touch flag for Touch Acquisition */
 	if (p_qtm_control->binding_layer_flags & (1u << time_to_measure_touch)) {
-		/* Do the acquisition */
-		touch_ret = qtm_lib_start_acquisition(0);
-
-		/* if the Acquistion request was successful then clear the request flag */
-		if (TOUCH_SUCCESS == touch_ret) {
-			/* Clear the Measure request flag */
-			p_qtm_control->binding_layer_flags &= (uint8_t) ~(1u << time_to_measure_touch);
-				
+		/* the PTC timing follows the CPU clock, the request stays pending
+		 * until the clock is up */
+		if (clock_lock(CLOCK_LOCK_PTC)) {
+			/* Do the acquisition */
+			touch_ret = qtm_lib_start_acquisition(0);
+
+			/* if the Acquistion request was successful then clear the request flag */
+			if (TOUCH_SUCCESS == touch_ret) {
+				/* Clear the Measure request flag */
+				p_qtm_control->binding_layer_flags &= (uint8_t) ~(1u << time_to_measure_touch);
+					
+			}
 		}
 	}
 
@@ -456,12 +572,15 @@ Purpose: This function updates the time elapsed to the touch key module to
          synchronize the internal time counts used by the module.
 Input  : none
 Output : none
-Notes  :
+Notes  : Runs in the RTC interrupt, which the EOC interrupt preempts at
+         level 1: the tick count and the flags are shared with it.
 ============================================================================*/
 extern volatile uint8_t measeurePeriod;
 
 void touch_timer_handler(void)
 {
+	ENTER_CRITICAL(R);
+	touch_timer_ticks++;
 
 	//interrupt_cnt++;
 //
@@ -472,11 +591,42 @@ void touch_timer_handler(void)
 		
 		/* Count complete - Measure touch sensors */
 		qtm_control.binding_layer_flags |= (1u << time_to_measure_touch);
+	EXIT_CRITICAL(R);
 
+#if DEF_TOUCH_KEY_MODULE == 1u
 		qtm_update_qtlib_timer(measeurePeriod);
+#endif
 	//}
 }
 
+/*============================================================================
+const touch_snapshot_t *touch_get_snapshot(void)
+------------------------------------------------------------------------------
+Purpose: Sensor data of the last post processed acquisition.
+Input  : none
+Output : published snapshot, all fields of the same acquisition
+Notes  : Main loop only, the snapshot stays valid until the next
+         touch_process(). No interrupt is disabled.
+============================================================================*/
+const touch_snapshot_t *touch_get_snapshot(void)
+{
+	return &touch_snapshots[touch_snapshot_front];
+}
+
+/*============================================================================
+uint8_t touch_work_pending(void)
+------------------------------------------------------------------------------
+Purpose: Tells whether touch_process() has work right away.
+Input  : none
+Output : nonzero while a measurement (also a reburst) or the post
+         processing of one is requested
+Notes  : For the sleep governor, called with interrupts disabled.
+============================================================================*/
+uint8_t touch_work_pending(void)
+{
+	return qtm_control.binding_layer_flags & ((1u << time_to_measure_touch) | (1u << node_pp_request));
+}
+
 uint16_t get_sensor_node_signal(uint16_t sensor_node)
 {
 	return (ptc_qtlib_node_stat1[sensor_node].node_acq_signals);
@@ -487,6 +637,7 @@ void update_sensor_node_signal(uint16_t sensor_node, uint16_t new_signal)
 	ptc_qtlib_node_stat1[sensor_node].node_acq_signals = new_signal;
 }
 
+#if DEF_TOUCH_KEY_MODULE == 1u
 uint16_t get_sensor_node_reference(uint16_t sensor_node)
 {
 	return (qtlib_key_data_set1[sensor_node].channel_reference);
@@ -496,6 +647,17 @@ void update_sensor_node_reference(uint16_t sensor_node, uint16_t new_reference)
 {
 	qtlib_key_data_set1[sensor_node].channel_reference = new_reference;
 }
+#else
+uint16_t get_sensor_node_reference(uint16_t sensor_node)
+{
+	return baselineValue;
+}
+
+void update_sensor_node_reference(uint16_t sensor_node, uint16_t new_reference)
+{
+	baselineValue = new_reference;
+}
+#endif
 
 uint16_t get_sensor_cc_val(uint16_t sensor_node)
 {
@@ -507,6 +669,7 @@ void update_sensor_cc_val(uint16_t sensor_node, uint16_t new_cc_value)
 	ptc_qtlib_node_stat1[sensor_node].node_comp_caps = new_cc_value;
 }
 
+#if DEF_TOUCH_KEY_MODULE == 1u
 uint8_t get_sensor_state(uint16_t sensor_node)
 {
 	return (qtlib_key_set1.qtm_touch_key_data[sensor_node].sensor_state);
@@ -516,13 +679,39 @@ void update_sensor_state(uint16_t sensor_node, uint8_t new_state)
 {
 	qtlib_key_set1.qtm_touch_key_data[sensor_node].sensor_state = new_state;
 }
+#else
+/* the key state of the application touch detection */
+uint8_t get_sensor_state(uint16_t sensor_node)
+{
+	return SensorState == FINGER_OFF_DETECT ? QTM_KEY_STATE_DETECT : QTM_KEY_STATE_NO_DET;
+}
+
+void update_sensor_state(uint16_t sensor_node, uint8_t new_state)
+{
+}
+#endif
+
+uint16_t get_touch_timer_ticks(void)
+{
+	uint16_t ticks;
+
+	ENTER_CRITICAL(T);
+	ticks = touch_timer_ticks;
+	EXIT_CRITICAL(T);
+
+	return ticks;
+}
 
 void calibrate_node(uint16_t sensor_node)
 {
 	/* Calibrate Node */
 	qtm_calibrate_sensor_node(&qtlib_acq_set1, sensor_node);
+#if DEF_TOUCH_KEY_MODULE == 1u
 	/* Initialize key */
 	qtm_init_sensor_key(&qtlib_key_set1, sensor_node, &ptc_qtlib_node_stat1[sensor_node]);
+#else
+	/* the reference follows with touch_detect_reset() */
+#endif
 }
 
 /*============================================================================
@@ -531,11 +720,13 @@ ISR(ADC0_RESRDY_vect)
 Purpose:  Interrupt handler for ADC / PTC EOC Interrupt
 Input    :  none
 Output  :  none
-Notes    :  none
+Notes    :  The debug marker is high while it runs.
 ============================================================================*/
 ISR(ADC0_RESRDY_vect)
 {
+	gpio_marker_high();
 	qtm_t81x_ptc_handler_eoc();
+	gpio_marker_low();
 }
 
 #endif /* TOUCH_C */
@@ -57,6 +57,7 @@ extern "C" {
 
 /* Defines the interrupt priority for the PTC. Set low priority to PTC interrupt for applications having interrupt time
  * constraints. Range: 0 to 2 Default: 2 (Lowest Priority)
+ * Not used by the t81x acquisition library, CPUINT_LVL1_VECTOR in cpuint.h sets the level of the EOC interrupt.
  */
 #define DEF_PTC_INTERRUPT_PRIORITY 2
 
@@ -97,6 +98,15 @@ extern "C" {
 /**********************************************************/
 /***************** Key Params   ******************/
 /**********************************************************/
+/* Enable / Disable the qtlib key module. The application detects touches
+ * itself and only needs the reference; without the module it is tracked by
+ * touch_detect_baseline() and the key module is not linked. The key
+ * parameters below are unused then.
+ * Range: 0 / 1
+ * Default value: 1
+ */
+#define DEF_TOUCH_KEY_MODULE 1u
+
 /* Defines the number of key sensors
  * Range: 1 to 65535.
  * Default value: 1
@@ -208,6 +218,76 @@ extern "C" {
 
 #define DATA_STREAMER_BOARD_TYPE USER_BOARD
 
+/* Datastreamer frame format.
+ * DATASTREAMER_FORMAT_LEGACY: Data Visualizer frames, raw 16-bit fields.
+ * DATASTREAMER_FORMAT_COMPACT: delta coded frames with CRC, see
+ * datastreamer_frame.h. Decode with tools/dsdecode.
+ * Default value: DATASTREAMER_FORMAT_COMPACT
+ */
+#define DATASTREAMER_FORMAT_LEGACY 0u
+#define DATASTREAMER_FORMAT_COMPACT 1u
+#define DEF_TOUCH_DATA_STREAMER_FORMAT DATASTREAMER_FORMAT_COMPACT
+
+/* Number of compact frames between two keyframes. A decoder that lost a frame
+ * resynchronizes on the next keyframe.
+ * Range: 1 to 255.
+ * Default value: 16
+ */
+#define DEF_TOUCH_DATA_STREAMER_KEYFRAME_INTERVAL 16u
+
+/* Add the timer tick count of the acquisition to every compact frame.
+ * Costs 2 bytes of SRAM per capture buffer frame.
+ * Range: 0 / 1
+ * Default value: 1
+ */
+#define DEF_TOUCH_DATA_STREAMER_TIMESTAMP 1u
+
+/* Enable / Disable the pre-trigger capture buffer. When enabled the
+ * datastreamer records every frame into a RAM ring buffer and only transmits
+ * a burst of frames around an edge, touch or false-trigger event.
+ * Range: 0 / 1
+ * Default value: 1
+ */
+#define DEF_TOUCH_DATA_STREAMER_CAPTURE 1u
+
+/* Number of frames held in the capture ring buffer. Must be a power of two.
+ * Each frame costs 9 bytes of SRAM per channel, 2 more with the timestamp.
+ * Range: 2 to 32.
+ * Default value: 8
+ */
+#define DEF_CAPTURE_DEPTH 8u
+
+/* Number of frames recorded after the trigger before the burst is sent.
+ * The remaining (DEF_CAPTURE_DEPTH - DEF_CAPTURE_POST_FRAMES) frames are the
+ * pre-trigger history.
+ * Range: 0 to DEF_CAPTURE_DEPTH - 1.
+ * Default value: 2
+ */
+#define DEF_CAPTURE_POST_FRAMES 2u
+
+/**********************************************************/
+/***************** Acquisition snapshot *******************/
+/**********************************************************/
+/* Sensor data of one node in a snapshot */
+typedef struct {
+	uint16_t signal;
+	uint16_t reference;
+	uint16_t comp_caps;
+	uint8_t  state;
+} touch_node_snapshot_t;
+
+/* Sensor data of one acquisition. The EOC interrupt captures the signals
+ * into the back buffer, the end of the post processing adds reference and
+ * state and publishes it; touch_get_snapshot() returns the front buffer.
+ * measurement_done_touch is only set for a published snapshot.
+ * Costs 2 * (2 + 7 * DEF_NUM_CHANNELS) bytes of SRAM. */
+typedef struct {
+	uint16_t              timestamp; /* timer ticks of the acquisition */
+	touch_node_snapshot_t node[DEF_NUM_CHANNELS];
+} touch_snapshot_t;
+
+const touch_snapshot_t *touch_get_snapshot(void);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -0,0 +1,183 @@
+/*============================================================================
+Filename : clock_governor.c
+Project : Attiny814Code
+Purpose : CPU clock selection by pending work, see clock_governor.h.
+
+          work in flight                  clock
+          PTC acquisition, detection      F_CPU (the PTC charge timing
+                                          follows CLK_PER)
+          USART TX draining               unchanged (a switch in the
+          command being received          middle of a byte breaks it)
+          nothing                         F_CPU >> CLOCK_LOW_SHIFT
+
+          The clock only switches with the USART idle. It drops in the main
+          loop, ahead of the sleep, so the RTC interrupt runs the battery
+          check and the valve pulse of the auto close slow. It rises when a
+          lock is taken, or, when the USART was busy then, in the first
+          clock_governor_update() after the transfer. The PTC acquisition
+          waits for it.
+============================================================================*/
+
+/*----------------------------------------------------------------------------
+  include files
+----------------------------------------------------------------------------*/
+#include <util/delay_basic.h>
+
+#include <driver_init.h>
+#include <atomic.h>
+#include "clock_governor.h"
+
+/*----------------------------------------------------------------------------
+  defines
+----------------------------------------------------------------------------*/
+/* baud register at F_CPU, USART0_BAUD_RATE(115200) of USART_init() in
+ * integers for the preprocessor */
+#define CLOCK_BAUD_FULL ((F_CPU * 4UL + 57600UL) / 115200UL)
+
+/* iterations of _delay_loop_2(), 4 cycles each, per ms at F_CPU */
+#define CLOCK_DELAY_LOOPS_MS ((uint16_t)(F_CPU / 4000UL))
+
+#if DEF_CLOCK_GOVERNOR_ENABLE == 1u && (CLOCK_BAUD_FULL >> CLOCK_LOW_SHIFT) < 64u
+#error "CLOCK_LOW_SHIFT too large for the USART baud rate"
+#endif
+
+/*----------------------------------------------------------------------------
+  global variables
+----------------------------------------------------------------------------*/
+static volatile uint8_t clock_locks;
+static volatile uint8_t clock_shift;
+
+/*============================================================================
+static uint8_t clock_uart_idle(void)
+------------------------------------------------------------------------------
+Purpose: Tells whether the baud rate may change.
+Input  : none
+Output : 1 when no byte is sent and no request is being received
+Notes  :
+============================================================================*/
+static uint8_t clock_uart_idle(void)
+{
+	return !USART_is_tx_busy()
+#if DEF_UART_COMMAND_ENABLE == 1u
+	       && !cmd_rx_busy()
+#endif
+	    ;
+}
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *--------------------------------------------------------------------------*/
+
+/*============================================================================
+static void clock_set(uint8_t shift)
+------------------------------------------------------------------------------
+Purpose: Switches the CPU to F_CPU >> shift.
+Input  : 0 or CLOCK_LOW_SHIFT
+Output : none
+Notes  : Called with interrupts disabled. The prescaler of the 20 MHz
+         oscillator is 2 << shift, PDIV 2X to 64X are the codes 0 to 5.
+============================================================================*/
+static void clock_set(uint8_t shift)
+{
+	if (shift == clock_shift) {
+		return;
+	}
+
+	ccp_write_io((void *)&(CLKCTRL.MCLKCTRLB), (shift << CLKCTRL_PDIV_gp) | CLKCTRL_PEN_bm);
+	USART0.BAUD = (uint16_t)((CLOCK_BAUD_FULL + ((1u << shift) >> 1u)) >> shift);
+	clock_shift = shift;
+}
+
+/*============================================================================
+uint8_t clock_lock(uint8_t lock)
+------------------------------------------------------------------------------
+Purpose: Runs the CPU at F_CPU until the lock is released.
+Input  : CLOCK_LOCK_xxx
+Output : 1 when the CPU runs at F_CPU, 0 while the raise waits for the
+         USART
+Notes  : May be called from interrupts. The lock holds in both cases,
+         clock_governor_update() raises the clock once the USART is idle.
+============================================================================*/
+uint8_t clock_lock(uint8_t lock)
+{
+	uint8_t full;
+
+	ENTER_CRITICAL(L);
+	clock_locks |= lock;
+	if (clock_uart_idle()) {
+		clock_set(0u);
+	}
+	full = (clock_shift == 0u);
+	EXIT_CRITICAL(L);
+
+	return full;
+}
+
+/*============================================================================
+void clock_unlock(uint8_t lock)
+------------------------------------------------------------------------------
+Purpose: Releases a lock taken by clock_lock().
+Input  : CLOCK_LOCK_xxx
+Output : none
+Notes  : May be called from interrupts. The clock stays up until
+         clock_governor_update().
+============================================================================*/
+void clock_unlock(uint8_t lock)
+{
+	ENTER_CRITICAL(U);
+	clock_locks &= (uint8_t)~lock;
+	EXIT_CRITICAL(U);
+}
+
+/*============================================================================
+void clock_governor_update(void)
+------------------------------------------------------------------------------
+Purpose: Drops to the low clock when no work needs F_CPU, raises it for a
+         lock taken while the USART was busy.
+Input  : none
+Output : none
+Notes  : Called from the main loop ahead of the sleep. Nothing changes
+         while the USART is busy.
+============================================================================*/
+void clock_governor_update(void)
+{
+#if DEF_CLOCK_GOVERNOR_ENABLE == 1u
+	ENTER_CRITICAL(G);
+	if (clock_uart_idle()) {
+		clock_set(clock_locks ? 0u : CLOCK_LOW_SHIFT);
+	}
+	EXIT_CRITICAL(G);
+#endif
+}
+
+/*============================================================================
+uint8_t clock_governor_level(void)
+------------------------------------------------------------------------------
+Purpose: Returns the current clock.
+Input  : none
+Output : CLOCK_FULL or CLOCK_LOW
+Notes  :
+============================================================================*/
+uint8_t clock_governor_level(void)
+{
+	return clock_shift ? CLOCK_LOW : CLOCK_FULL;
+}
+
+/*============================================================================
+void clock_delay_ms(uint16_t ms)
+------------------------------------------------------------------------------
+Purpose: Busy-waits ms milliseconds at the current clock.
+Input  : time in ms
+Output : none
+Notes  : Within a few cycles per ms of _delay_ms() at F_CPU. Takes the
+         clock of the start, a lock taken by an interrupt meanwhile
+         shortens the wait.
+============================================================================*/
+void clock_delay_ms(uint16_t ms)
+{
+	uint16_t loops = CLOCK_DELAY_LOOPS_MS >> clock_shift;
+
+	while (ms--) {
+		_delay_loop_2(loops);
+	}
+}
@@ -48,13 +48,15 @@ int8_t CPUINT_init()
 
 	/* IVSEL and CVT are Configuration Change Protected */
 
-	// ccp_write_io((void*)&(CPUINT.CTRLA),0 << CPUINT_CVT_bp /* Compact Vector Table: disabled */
-	//		 | 0 << CPUINT_IVSEL_bp /* Interrupt Vector Select: disabled */
-	//		 | 0 << CPUINT_LVL0RR_bp /* Round-robin Scheduling Enable: disabled */);
+#if CPUINT_LVL0_ROUND_ROBIN == 1
+	ccp_write_io((void*)&(CPUINT.CTRLA),0 << CPUINT_CVT_bp /* Compact Vector Table: disabled */
+			 | 0 << CPUINT_IVSEL_bp /* Interrupt Vector Select: disabled */
+			 | 1 << CPUINT_LVL0RR_bp /* Round-robin Scheduling Enable: enabled */);
+#endif
 
 	// CPUINT.LVL0PRI = 0x0 << CPUINT_LVL0PRI_gp; /* Interrupt Level Priority: 0x0 */
 
-	// CPUINT.LVL1VEC = 0x0 << CPUINT_LVL1VEC_gp; /* Interrupt Vector with High Priority: 0x0 */
+	CPUINT.LVL1VEC = CPUINT_LVL1_VECTOR; /* Interrupt Vector with High Priority */
 
 	ENABLE_INTERRUPTS();
 
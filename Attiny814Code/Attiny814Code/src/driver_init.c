@@ -198,7 +198,7 @@ void system_init()
 	
 	VREF_0_init();
 	
-#ifdef _DEBUG
+#if defined(_DEBUG) || DEF_UART_COMMAND_ENABLE == 1u
 	USART_initialization();
 #endif
 	
@@ -0,0 +1,156 @@
+/*============================================================================
+Filename : gesture.c
+Project : Attiny814Code
+Purpose : Tap, double-tap and long-press recognition, see gesture.h.
+============================================================================*/
+
+/*----------------------------------------------------------------------------
+  include files
+----------------------------------------------------------------------------*/
+#include "gesture.h"
+#include "touch_detect.h"
+
+/*----------------------------------------------------------------------------
+  defines
+----------------------------------------------------------------------------*/
+/* states of the recognizer */
+#define GESTURE_IDLE 0u  /* finger off */
+#define GESTURE_PRESS 1u /* finger on, the first or the second press */
+#define GESTURE_GAP 2u   /* first tap released, waiting for a second press */
+#define GESTURE_HOLD 3u  /* long-press reported, waiting for the release */
+
+/*----------------------------------------------------------------------------
+  global variables
+----------------------------------------------------------------------------*/
+uint16_t doubleTapWindow = 250;
+uint16_t longPressTime   = 1500;
+
+/* RTC periods since the last press or release, saturating */
+static volatile uint8_t gestureTicks = 0;
+static uint8_t          gestureState = GESTURE_IDLE;
+static uint8_t          secondPress  = 0;
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *--------------------------------------------------------------------------*/
+
+/* RTC periods of a timing in ms, clamped to what gestureTicks can count */
+static uint8_t gesture_ticks(uint16_t time)
+{
+	uint16_t ticks = time / RTC_WAKE_UP_TIME;
+
+	return ticks > GESTURE_TICKS_MAX ? GESTURE_TICKS_MAX : (uint8_t)ticks;
+}
+
+/* Enters a state and restarts its timing */
+static void gesture_enter(uint8_t state)
+{
+	gestureState = state;
+	gestureTicks = 0;
+}
+
+/*============================================================================
+uint8_t gesture_sample(uint8_t edge, uint8_t result, uint8_t held)
+------------------------------------------------------------------------------
+Purpose: Runs the gesture recognizer on the edge of a new measurement.
+Input  : edge and result of touch_detect_sample(), touch_detect_held()
+Output : GESTURE_NONE, GESTURE_TAP, GESTURE_DOUBLE_TAP or GESTURE_LONG_PRESS
+Notes  : The timeouts are checked here, a single tap comes with the first
+         measurement after doubleTapWindow. A release the touch state
+         machine takes for a false touch is no tap. A press without a
+         finger held behind it ends at fingerOnMaxTime, as in the touch
+         state machine, and never becomes a long-press.
+============================================================================*/
+uint8_t gesture_sample(uint8_t edge, uint8_t result, uint8_t held)
+{
+	uint8_t ticks   = gestureTicks;
+	uint8_t gesture = GESTURE_NONE;
+
+	switch (gestureState) {
+	case GESTURE_IDLE:
+		if (edge == EDGE_RISING) {
+			secondPress = 0;
+			gesture_enter(GESTURE_PRESS);
+		}
+		break;
+
+	case GESTURE_PRESS:
+		if (edge == EDGE_RISING) {
+			/* the press restarts, as in the touch state machine */
+			gestureTicks = 0;
+		} else if (edge == EDGE_FALLING) {
+			if (result == TOUCH_FALSE || ticks < gesture_ticks(fingerOnMinTime)
+			    || ticks >= gesture_ticks(fingerOnMaxTime)) {
+				/* no tap, a first tap still stands */
+				gesture = secondPress ? GESTURE_TAP : GESTURE_NONE;
+				gesture_enter(GESTURE_IDLE);
+			} else if (secondPress) {
+				gesture = GESTURE_DOUBLE_TAP;
+				gesture_enter(GESTURE_IDLE);
+			} else if (gesture_ticks(doubleTapWindow) == 0) {
+				gesture = GESTURE_TAP;
+				gesture_enter(GESTURE_IDLE);
+			} else {
+				gesture_enter(GESTURE_GAP);
+			}
+		} else if (held && !secondPress && gesture_ticks(longPressTime) != 0
+		           && ticks >= gesture_ticks(longPressTime)) {
+			gesture = GESTURE_LONG_PRESS;
+			gestureState = GESTURE_HOLD;
+		} else if (ticks >= gesture_ticks(fingerOnMaxTime)
+		           && (!held || secondPress || gesture_ticks(longPressTime) == 0)) {
+			/* held too long for a tap, or no finger behind the edge: no
+			 * need to wait for the release */
+			gesture = secondPress ? GESTURE_TAP : GESTURE_NONE;
+			gesture_enter(GESTURE_IDLE);
+		}
+		break;
+
+	case GESTURE_GAP:
+		if (edge == EDGE_RISING) {
+			secondPress = 1;
+			gesture_enter(GESTURE_PRESS);
+		} else if (ticks >= gesture_ticks(doubleTapWindow)) {
+			gesture = GESTURE_TAP;
+			gesture_enter(GESTURE_IDLE);
+		}
+		break;
+
+	default:
+		/* a release lost in the edge freeze ends the hold at the latest
+		 * GESTURE_TICKS_MAX periods after the press */
+		if (edge == EDGE_FALLING || ticks == GESTURE_TICKS_MAX)
+			gesture_enter(GESTURE_IDLE);
+		break;
+	}
+
+	return gesture;
+}
+
+/*============================================================================
+void gesture_tick(void)
+------------------------------------------------------------------------------
+Purpose: Advances the timing of the press or the gap.
+Input  : none
+Output : none
+Notes  : Called from the RTC interrupt every RTC_WAKE_UP_TIME ms.
+============================================================================*/
+void gesture_tick(void)
+{
+	if (gestureTicks < GESTURE_TICKS_MAX)
+		gestureTicks++;
+}
+
+/*============================================================================
+void gesture_reset(void)
+------------------------------------------------------------------------------
+Purpose: Drops a gesture in progress, with touch_detect_reset().
+Input  : none
+Output : none
+Notes  :
+============================================================================*/
+void gesture_reset(void)
+{
+	secondPress = 0;
+	gesture_enter(GESTURE_IDLE);
+}
@@ -0,0 +1,97 @@
+/*============================================================================
+Filename : perf_counter.c
+Project : Attiny814Code
+Purpose : Saturating event counters, see perf_counter.h.
+============================================================================*/
+
+/*----------------------------------------------------------------------------
+  include files
+----------------------------------------------------------------------------*/
+#include <string.h>
+
+#include "perf_counter.h"
+
+#ifdef __AVR__
+#include <atomic.h>
+#define PERF_ENTER_CRITICAL() ENTER_CRITICAL(P)
+#define PERF_EXIT_CRITICAL() EXIT_CRITICAL(P)
+/* kept over a reset that is no power cycle */
+#define PERF_NOINIT __attribute__((section(".noinit")))
+#else
+#define PERF_ENTER_CRITICAL()
+#define PERF_EXIT_CRITICAL()
+#define PERF_NOINIT
+#endif
+
+/*----------------------------------------------------------------------------
+  defines
+----------------------------------------------------------------------------*/
+/* marks a table that has been cleared since the last power cycle */
+#define PERF_MAGIC 0x5EC7u
+
+/*----------------------------------------------------------------------------
+  global variables
+----------------------------------------------------------------------------*/
+#if DEF_PERF_COUNTER_ENABLE == 1u
+static uint16_t perf_counters[PERF_COUNT] PERF_NOINIT;
+static uint16_t perf_magic PERF_NOINIT;
+#endif
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *--------------------------------------------------------------------------*/
+
+#if DEF_PERF_COUNTER_ENABLE == 1u
+/*============================================================================
+void perf_init(uint8_t cold)
+------------------------------------------------------------------------------
+Purpose: Clears the counters after a power cycle.
+Input  : 1 after a power-on or brown-out reset
+Output : none
+Notes  : Called once at start-up, before anything counts. A table that was
+         never cleared holds random RAM contents and is cleared as well.
+============================================================================*/
+void perf_init(uint8_t cold)
+{
+	if (cold || perf_magic != PERF_MAGIC) {
+		memset(perf_counters, 0, sizeof(perf_counters));
+		perf_magic = PERF_MAGIC;
+	}
+}
+
+/*============================================================================
+void perf_count(uint8_t id)
+------------------------------------------------------------------------------
+Purpose: Counts one event.
+Input  : PERF_xxx counter
+Output : none
+Notes  : May be called from interrupts. Stops at PERF_COUNTER_MAX.
+============================================================================*/
+void perf_count(uint8_t id)
+{
+	PERF_ENTER_CRITICAL();
+	if (perf_counters[id] != PERF_COUNTER_MAX) {
+		perf_counters[id]++;
+	}
+	PERF_EXIT_CRITICAL();
+}
+#endif
+
+/*============================================================================
+void perf_snapshot(uint16_t *counters)
+------------------------------------------------------------------------------
+Purpose: Consistent copy of all counters.
+Input  : destination, PERF_COUNT entries
+Output : none
+Notes  : All zero with DEF_PERF_COUNTER_ENABLE 0.
+============================================================================*/
+void perf_snapshot(uint16_t *counters)
+{
+#if DEF_PERF_COUNTER_ENABLE == 1u
+	PERF_ENTER_CRITICAL();
+	memcpy(counters, perf_counters, sizeof(perf_counters));
+	PERF_EXIT_CRITICAL();
+#else
+	memset(counters, 0, PERF_COUNT * sizeof(*counters));
+#endif
+}
@@ -0,0 +1,174 @@
+/*============================================================================
+Filename : sleep_governor.c
+Project : Attiny814Code
+Purpose : Sleep mode selection by pending work, see sleep_governor.h.
+
+          work in flight                  deepest mode
+          measurement or reburst          none, touch_process() starts
+          requested, post processing      it on the next pass
+          pending
+          PTC acquisition                 idle (PTC and ADC clock)
+          USART TX draining               idle (transmitter clock)
+          command being received          idle (SFD only wakes on the
+                                          first byte of a request)
+          command channel waiting         standby (SFD wake)
+          nothing                         power-down
+
+          The valve pulse and the battery check busy-wait with clock_delay_ms()
+          and never reach the governor while in flight. Debug builds stay
+          in idle so the datastreamer and the debugger keep working.
+============================================================================*/
+
+/*----------------------------------------------------------------------------
+  include files
+----------------------------------------------------------------------------*/
+#include <avr/sleep.h>
+#include <string.h>
+
+#include <driver_init.h>
+#include <atomic.h>
+#include "sleep_governor.h"
+#include "perf_counter.h"
+
+/*----------------------------------------------------------------------------
+  global variables
+----------------------------------------------------------------------------*/
+static volatile uint8_t sleep_locks;
+static volatile uint8_t sleep_state;
+static sleep_stats_t    sleep_stats;
+
+static const uint8_t sleep_modes[SLEEP_STATE_COUNT]
+    = {SLEEP_MODE_IDLE, SLEEP_MODE_IDLE, SLEEP_MODE_STANDBY, SLEEP_MODE_PWR_DOWN};
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *--------------------------------------------------------------------------*/
+
+/*============================================================================
+void sleep_lock(uint8_t lock)
+------------------------------------------------------------------------------
+Purpose: Keeps the device out of standby and power-down.
+Input  : SLEEP_LOCK_xxx
+Output : none
+Notes  : May be called from interrupts.
+============================================================================*/
+void sleep_lock(uint8_t lock)
+{
+	ENTER_CRITICAL(L);
+	sleep_locks |= lock;
+	EXIT_CRITICAL(L);
+}
+
+/*============================================================================
+void sleep_unlock(uint8_t lock)
+------------------------------------------------------------------------------
+Purpose: Releases a lock taken by sleep_lock().
+Input  : SLEEP_LOCK_xxx
+Output : none
+Notes  : May be called from interrupts.
+============================================================================*/
+void sleep_unlock(uint8_t lock)
+{
+	ENTER_CRITICAL(U);
+	sleep_locks &= (uint8_t)~lock;
+	EXIT_CRITICAL(U);
+}
+
+/*============================================================================
+uint8_t sleep_governor_select(void)
+------------------------------------------------------------------------------
+Purpose: Returns the deepest safe power state for the work in flight.
+Input  : none
+Output : SLEEP_STATE_ACTIVE (do not sleep), SLEEP_STATE_IDLE,
+         SLEEP_STATE_STANDBY or SLEEP_STATE_PWR_DOWN
+Notes  : Releases SLEEP_LOCK_UART_TX once the last byte has left.
+============================================================================*/
+uint8_t sleep_governor_select(void)
+{
+	/* nothing would wake the CPU for it before the next RTC tick */
+	if (touch_work_pending()) {
+		return SLEEP_STATE_ACTIVE;
+	}
+
+	if ((sleep_locks & SLEEP_LOCK_UART_TX) && !USART_is_tx_busy()) {
+		sleep_unlock(SLEEP_LOCK_UART_TX);
+	}
+
+#ifdef _DEBUG
+	return SLEEP_STATE_IDLE;
+#else
+	if (sleep_locks) {
+		return SLEEP_STATE_IDLE;
+	}
+#if DEF_UART_COMMAND_ENABLE == 1u
+	if (cmd_rx_busy()) {
+		return SLEEP_STATE_IDLE;
+	}
+#if DEF_UART_COMMAND_SFD_WAKE == 1u
+	return SLEEP_STATE_STANDBY;
+#endif
+#endif
+	return SLEEP_STATE_PWR_DOWN;
+#endif
+}
+
+/*============================================================================
+void sleep_governor_sleep(void)
+------------------------------------------------------------------------------
+Purpose: Sleeps in the mode of sleep_governor_select() until an interrupt,
+         returns at once while touch work is pending.
+Input  : none
+Output : none
+Notes  : The mode is selected with interrupts disabled and the sleep
+         instruction directly follows ENABLE_INTERRUPTS(), so a lock taken
+         by an interrupt in between can not be slept through.
+============================================================================*/
+void sleep_governor_sleep(void)
+{
+	uint8_t state;
+
+	DISABLE_INTERRUPTS();
+	state = sleep_governor_select();
+	if (state == SLEEP_STATE_ACTIVE) {
+		ENABLE_INTERRUPTS();
+		return;
+	}
+	sleep_stats.entries[state]++;
+	sleep_state = state;
+	set_sleep_mode(sleep_modes[state]);
+	sleep_enable();
+	ENABLE_INTERRUPTS();
+	sleep_cpu();
+	sleep_disable();
+	sleep_state = SLEEP_STATE_ACTIVE;
+	perf_count(PERF_WAKES);
+}
+
+/*============================================================================
+void sleep_governor_tick(void)
+------------------------------------------------------------------------------
+Purpose: Samples the power state for the residency counters.
+Input  : none
+Output : none
+Notes  : Called from the RTC interrupt, which wakes the device from any
+         mode, so the sample is the state just before the tick.
+============================================================================*/
+void sleep_governor_tick(void)
+{
+	sleep_stats.ticks[sleep_state]++;
+}
+
+/*============================================================================
+void sleep_governor_read_stats(sleep_stats_t *stats)
+------------------------------------------------------------------------------
+Purpose: Consistent copy of the residency counters.
+Input  : destination
+Output : none
+Notes  :
+============================================================================*/
+void sleep_governor_read_stats(sleep_stats_t *stats)
+{
+	ENTER_CRITICAL(R);
+	memcpy(stats, &sleep_stats, sizeof(*stats));
+	EXIT_CRITICAL(R);
+}
@@ -0,0 +1,91 @@
+/*============================================================================
+Filename : stack_monitor.c
+Project : Attiny814Code
+Purpose : Stack painting and high-water mark, see stack_monitor.h.
+============================================================================*/
+
+/*----------------------------------------------------------------------------
+  include files
+----------------------------------------------------------------------------*/
+#include <avr/io.h>
+
+#include "stack_monitor.h"
+
+/*----------------------------------------------------------------------------
+  global variables
+----------------------------------------------------------------------------*/
+/* provided by the linker: end of .bss/.noinit and initial stack pointer */
+extern uint8_t _end;
+extern uint8_t __stack;
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *--------------------------------------------------------------------------*/
+
+#if DEF_STACK_MONITOR_ENABLE == 1u
+void stack_monitor_paint(void) __attribute__((naked, used, section(".init3")));
+
+/*============================================================================
+void stack_monitor_paint(void)
+------------------------------------------------------------------------------
+Purpose: Fills the RAM above .bss with STACK_PAINT_PATTERN.
+Input  : none
+Output : none
+Notes  : Placed in .init3, the user init section of avr-libc: after the
+         stack pointer and __zero_reg__ are set up, before main() pushes
+         anything. Naked and never called, the code falls through into
+         .init4. Written in assembly, so it needs neither r1 nor a stack
+         frame at any optimisation level.
+============================================================================*/
+void stack_monitor_paint(void)
+{
+	__asm__ __volatile__("ldi r30, lo8(_end)\n\t"
+	                     "ldi r31, hi8(_end)\n\t"
+	                     "ldi r24, %0\n\t"
+	                     "ldi r25, hi8(__stack + 1)\n\t"
+	                     "rjmp 2f\n"
+	                     "1:\tst Z+, r24\n"
+	                     "2:\tcpi r30, lo8(__stack + 1)\n\t"
+	                     "cpc r31, r25\n\t"
+	                     "brlo 1b\n\t" ::"M"(STACK_PAINT_PATTERN)
+	                     : "r24", "r25", "r30", "r31", "memory");
+}
+#endif
+
+/*============================================================================
+uint16_t stack_monitor_size(void)
+------------------------------------------------------------------------------
+Purpose: RAM available to the stack.
+Input  : none
+Output : bytes between the end of .bss and the top of RAM
+Notes  :
+============================================================================*/
+uint16_t stack_monitor_size(void)
+{
+	return (uint16_t)(&__stack - &_end + 1);
+}
+
+/*============================================================================
+uint16_t stack_monitor_peak(void)
+------------------------------------------------------------------------------
+Purpose: Deepest stack used since reset.
+Input  : none
+Output : bytes, 0 if DEF_STACK_MONITOR_ENABLE is 0
+Notes  : Scans from the end of .bss up to the first overwritten byte, a few
+         microseconds per hundred free bytes. A pushed byte that happens to
+         equal the pattern is seen as unused, so the result may be low by a
+         byte or two.
+============================================================================*/
+uint16_t stack_monitor_peak(void)
+{
+#if DEF_STACK_MONITOR_ENABLE == 1u
+	const volatile uint8_t *p = &_end;
+
+	while (p <= &__stack && *p == STACK_PAINT_PATTERN) {
+		p++;
+	}
+	return (uint16_t)(&__stack - p + 1);
+#else
+	return 0u;
+#endif
+}
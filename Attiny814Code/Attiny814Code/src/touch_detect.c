@@ -0,0 +1,541 @@
+/*============================================================================
+Filename : touch_detect.c
+Project : Attiny814Code
+Purpose : Edge detection and touch state machine, see touch_detect.h.
+============================================================================*/
+
+/*----------------------------------------------------------------------------
+  include files
+----------------------------------------------------------------------------*/
+#include <stdlib.h>
+
+#include "touch_detect.h"
+#include "perf_counter.h"
+#include "atomic_access.h"
+
+/*----------------------------------------------------------------------------
+  defines
+----------------------------------------------------------------------------*/
+#define BASELINE_TIME_MS(TIME) (uint8_t)((TIME) / RTC_WAKE_UP_TIME)
+
+/*----------------------------------------------------------------------------
+  global variables
+----------------------------------------------------------------------------*/
+uint16_t STRONG_EDGE_THRESHOLD = 50;
+uint16_t noiseLevel            = (50u << NOISE_LEVEL_FRAC) / 6u;
+int16_t  filteredDeltaValue    = 0;
+uint16_t baselineValue         = 0;
+
+uint8_t  noiseFactor         = 6;
+uint8_t  noiseAttackShift    = 2;
+uint8_t  noiseReleaseShift   = 4;
+uint16_t edgeThresholdMin    = 35;
+uint16_t edgeThresholdMax    = 80;
+uint16_t fingerOnMinTime     = 70;
+uint16_t fingerOnMaxTime     = 500;
+uint16_t freezeTime          = 300;
+
+volatile SensorStateDef SensorState = FINGER_ON_DETECT;
+volatile uint16_t       fingerOnCnt = 0;
+volatile uint8_t        edgeDetectFreeze = 0;
+volatile uint16_t       edgeFreezeCnt    = 0;
+uint16_t                touchCnt         = 0;
+uint16_t                falseTouchCnt    = 0;
+
+#if TOUCH_FILTER_SETTLE > 0
+static uint8_t settleCnt = 0;
+#endif
+
+/* modeled valve disturbance in the delta, samples of its onset left; main
+ * loop only, a pulse from the interrupt restarts them with blankRestart */
+static int16_t          blankOffset   = 0;
+static uint8_t          blankOnsetCnt = 0;
+static volatile uint8_t blankRestart  = 0;
+
+#if TOUCH_FILTER == TOUCH_FILTER_FIR
+/* x[n-2], x[n-3] */
+static int16_t olderDelta[2];
+#endif
+
+/* reference tracking: samples since the last drift step, of the drift hold
+ * and below the reference; the next signal is the reference while set */
+static uint8_t baselineDriftCnt = 0;
+static uint8_t baselineHoldCnt  = 0;
+static uint8_t baselineRecalCnt = 0;
+static uint8_t baselineInit     = 1;
+
+/* delta of the last sample, for touch_detect_held() */
+static int16_t sampleDelta = 0;
+
+/* key state of touch_detect_key(), key detect seen during the touch */
+static uint8_t keyState = KEY_QUIET;
+#if TOUCH_FUSION == TOUCH_FUSION_CONFIRM
+static uint8_t keyConfirmed = 0;
+#endif
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *--------------------------------------------------------------------------*/
+
+/*============================================================================
+int16_t touch_detect_delta(uint16_t signal, uint16_t reference)
+------------------------------------------------------------------------------
+Purpose: Delta of a sensor node.
+Input  : signal and reference of the node
+Output : signal - reference, saturated to +-TOUCH_DELTA_LIMIT
+Notes  :
+============================================================================*/
+int16_t touch_detect_delta(uint16_t signal, uint16_t reference)
+{
+	if (signal >= reference) {
+		return signal - reference > TOUCH_DELTA_LIMIT ? TOUCH_DELTA_LIMIT : (int16_t)(signal - reference);
+	}
+	return reference - signal > TOUCH_DELTA_LIMIT ? -TOUCH_DELTA_LIMIT : -(int16_t)(reference - signal);
+}
+
+/*============================================================================
+int16_t touch_detect_derivative(int16_t delta)
+------------------------------------------------------------------------------
+Purpose: Step of the filtered delta a new sample would make.
+Input  : delta of touch_detect_delta()
+Output : step, within +-2 * TOUCH_DELTA_LIMIT
+Notes  : Does not change the filter state, the datastreamer shows the
+         step of the pending measurement with it.
+============================================================================*/
+int16_t touch_detect_derivative(int16_t delta)
+{
+#if TOUCH_FILTER == TOUCH_FILTER_FIR
+	/* halves first, the sum of four deltas would not fit */
+	return ((delta + filteredDeltaValue) >> 1) - ((olderDelta[0] + olderDelta[1]) >> 1);
+#else
+	return delta - filteredDeltaValue;
+#endif
+}
+
+/* Moves the filter state to the new sample */
+static void touch_detect_filter(int16_t delta)
+{
+#if TOUCH_FILTER == TOUCH_FILTER_EMA
+	filteredDeltaValue += (delta - filteredDeltaValue) >> TOUCH_FILTER_EMA_SHIFT;
+#elif TOUCH_FILTER == TOUCH_FILTER_FIR
+	olderDelta[1]      = olderDelta[0];
+	olderDelta[0]      = filteredDeltaValue;
+	filteredDeltaValue = delta;
+#else
+	filteredDeltaValue = delta;
+#endif
+}
+
+/* Moves the noise estimate towards a step, rounding away from the
+ * estimate so it always converges */
+static void touch_detect_noise(uint16_t step)
+{
+	uint16_t limit = 2u * noiseLevel + (1u << NOISE_LEVEL_FRAC);
+	uint16_t in    = step > (NOISE_LEVEL_MAX >> NOISE_LEVEL_FRAC) ? NOISE_LEVEL_MAX : (uint16_t)(step << NOISE_LEVEL_FRAC);
+
+	if (in > limit)
+		in = limit;
+
+	if (in > noiseLevel)
+		noiseLevel += (in - noiseLevel + (1u << noiseAttackShift) - 1u) >> noiseAttackShift;
+	else
+		noiseLevel -= (noiseLevel - in + (1u << noiseReleaseShift) - 1u) >> noiseReleaseShift;
+
+	if (noiseLevel > NOISE_LEVEL_MAX)
+		noiseLevel = NOISE_LEVEL_MAX;
+}
+
+/* Classifies the step of the filter stage and moves the filter to the new
+ * delta, the absolute step goes to *step */
+static uint8_t touch_detect_classify(int16_t delta, int16_t *step)
+{
+	int16_t deltaDerivative = touch_detect_derivative(delta);
+	uint8_t edgeStatus      = EDGE_NONE;
+
+	touch_detect_filter(delta);
+	*step = abs(deltaDerivative);
+
+	if (*step >= STRONG_EDGE_THRESHOLD) {
+		/* this is an strong edge */
+		if (deltaDerivative > 0)
+			edgeStatus = EDGE_RISING;
+		else if (deltaDerivative < 0)
+			edgeStatus = EDGE_FALLING;
+	}
+
+#if TOUCH_FILTER_SETTLE > 0
+	if (edgeStatus != EDGE_NONE)
+		settleCnt = TOUCH_FILTER_SETTLE;
+#endif
+	return edgeStatus;
+}
+
+/*============================================================================
+uint8_t touch_detect_edge(int16_t delta)
+------------------------------------------------------------------------------
+Purpose: Classifies the step from the previous delta and adapts the noise
+         estimate and the edge threshold.
+Input  : delta of touch_detect_delta()
+Output : EDGE_NONE, EDGE_RISING or EDGE_FALLING
+Notes  :
+============================================================================*/
+uint8_t touch_detect_edge(int16_t delta)
+{
+	int16_t  deltaDerivativeAbs;
+	uint8_t  edgeStatus = touch_detect_classify(delta, &deltaDerivativeAbs);
+	uint16_t threshold  = STRONG_EDGE_THRESHOLD;
+
+#if TOUCH_FILTER_SETTLE > 0
+	if (settleCnt)
+		/* the tail of the edge is no noise */
+		settleCnt--;
+	else
+#endif
+	touch_detect_noise(deltaDerivativeAbs);
+
+	STRONG_EDGE_THRESHOLD = (noiseLevel * noiseFactor) >> NOISE_LEVEL_FRAC;
+
+	/* the maximum wins when the limits cross */
+	if (STRONG_EDGE_THRESHOLD < edgeThresholdMin)
+		STRONG_EDGE_THRESHOLD = edgeThresholdMin;
+	if (STRONG_EDGE_THRESHOLD > edgeThresholdMax)
+		STRONG_EDGE_THRESHOLD = edgeThresholdMax;
+
+	if (STRONG_EDGE_THRESHOLD > threshold)
+		perf_count(PERF_THRESHOLD_UP);
+	else if (STRONG_EDGE_THRESHOLD < threshold)
+		perf_count(PERF_THRESHOLD_DOWN);
+
+	return edgeStatus;
+}
+
+static int16_t touch_detect_clamp(int16_t delta)
+{
+	if (delta > TOUCH_DELTA_LIMIT)
+		return TOUCH_DELTA_LIMIT;
+	return delta < -TOUCH_DELTA_LIMIT ? -TOUCH_DELTA_LIMIT : delta;
+}
+
+/* Moves the filter state with a change of the delta that is no edge */
+static void touch_detect_shift(int16_t offset)
+{
+	filteredDeltaValue = touch_detect_clamp(filteredDeltaValue + offset);
+#if TOUCH_FILTER == TOUCH_FILTER_FIR
+	olderDelta[0] = touch_detect_clamp(olderDelta[0] + offset);
+	olderDelta[1] = touch_detect_clamp(olderDelta[1] + offset);
+#endif
+}
+
+/*============================================================================
+static uint8_t touch_detect_blank(int16_t delta)
+------------------------------------------------------------------------------
+Purpose: Takes the modeled valve disturbance out of a delta while the edge
+         detection is blanked, and ends the blanking once it has decayed.
+Input  : delta of touch_detect_delta()
+Output : EDGE_NONE, EDGE_RISING or EDGE_FALLING
+Notes  : The first TOUCH_BLANK_ONSET_SAMPLES samples after the pulse are
+         all disturbance. After that the disturbance decays by
+         2^-TOUCH_BLANK_DECAY_SHIFT per sample and the edges come from the
+         delta without it, a finger shows up as usual. The blanking ends
+         when the disturbance is below the edge threshold, or after
+         freezeTime; the filter moves to the plain delta on the way, so the
+         end is no edge. The noise estimate skips the blanking.
+         touch_detect_freeze() may run in the RTC interrupt at any point in
+         here: it only requests the restart of the model, and the blanking
+         only ends when no restart is pending.
+============================================================================*/
+static uint8_t touch_detect_blank(int16_t delta)
+{
+	int16_t step;
+
+	/* a new pulse: a request taken just after the test is handled the same */
+	if (blankRestart) {
+		blankRestart  = 0;
+		blankOffset   = 0;
+		blankOnsetCnt = TOUCH_BLANK_ONSET_SAMPLES;
+	}
+
+	if (blankOnsetCnt) {
+		blankOnsetCnt--;
+		blankOffset = touch_detect_clamp(delta - filteredDeltaValue);
+		return EDGE_NONE;
+	}
+
+	blankOffset -= blankOffset >> TOUCH_BLANK_DECAY_SHIFT;
+	if ((uint16_t)abs(blankOffset) >= STRONG_EDGE_THRESHOLD
+	    && atomic_read16(&edgeFreezeCnt) <= RADIOTUBE_FREEZE_TIME_MS(freezeTime))
+		return touch_detect_classify(touch_detect_clamp(delta - blankOffset), &step);
+
+	/* back to the plain delta */
+	touch_detect_shift(blankOffset);
+	/* unless a pulse came meanwhile, the next sample restarts then; the
+	 * interrupt stops counting first */
+	ATOMIC_ACCESS_ENTER();
+	if (!blankRestart) {
+		edgeDetectFreeze = 0;
+		edgeFreezeCnt    = 0;
+	}
+	ATOMIC_ACCESS_EXIT();
+	return touch_detect_edge(delta);
+}
+
+/*============================================================================
+uint8_t touch_detect_sample(uint16_t signal, uint16_t reference, uint8_t *edge)
+------------------------------------------------------------------------------
+Purpose: Runs the touch state machine on a new measurement.
+Input  : signal and reference of the node; destination of the edge
+Output : TOUCH_NONE, TOUCH_VALID or TOUCH_FALSE
+Notes  : While edgeDetectFreeze is set the sample goes to the blanking.
+         The key state of touch_detect_key() gates or confirms the edges,
+         see TOUCH_FUSION. fingerOnCnt is counted by the interrupt, it is
+         read once and reset with the atomic helpers.
+============================================================================*/
+uint8_t touch_detect_sample(uint16_t signal, uint16_t reference, uint8_t *edge)
+{
+	uint8_t  result = TOUCH_NONE;
+	int16_t  delta  = touch_detect_delta(signal, reference);
+	uint8_t  edgeStatus;
+	uint16_t onCnt;
+
+	sampleDelta = delta;
+
+#if TOUCH_FUSION == TOUCH_FUSION_GATE
+	if (keyState == KEY_QUIET && SensorState == FINGER_ON_DETECT && !edgeDetectFreeze) {
+		/* no edge to find, the filter follows the delta */
+		touch_detect_filter(delta);
+		edgeStatus = EDGE_NONE;
+	} else
+#endif
+	edgeStatus = edgeDetectFreeze ? touch_detect_blank(delta) : touch_detect_edge(delta);
+
+#if TOUCH_FUSION == TOUCH_FUSION_GATE
+	/* a finger also takes the key over its threshold */
+	if (edgeStatus == EDGE_RISING && keyState == KEY_QUIET)
+		edgeStatus = EDGE_NONE;
+#endif
+
+	if (edgeStatus == EDGE_RISING)
+		perf_count(PERF_EDGES_RISING);
+	else if (edgeStatus == EDGE_FALLING)
+		perf_count(PERF_EDGES_FALLING);
+
+	switch (SensorState) {
+	case FINGER_ON_DETECT:
+		if (edgeStatus == EDGE_RISING) {
+			SensorState = FINGER_OFF_DETECT;
+#if TOUCH_FUSION == TOUCH_FUSION_CONFIRM
+			keyConfirmed = (keyState == KEY_DETECT);
+#endif
+		}
+		break;
+
+	case FINGER_OFF_DETECT:
+#if TOUCH_FUSION == TOUCH_FUSION_CONFIRM
+		if (keyState == KEY_DETECT)
+			keyConfirmed = 1;
+#endif
+		onCnt = atomic_read16(&fingerOnCnt);
+		/* state will roll back if rising edge appears. */
+		if (edgeStatus == EDGE_RISING)
+			atomic_write16(&fingerOnCnt, 0);
+		/* the time duration of effective touch should between 70ms to 500ms */
+		else if (onCnt >= FINGER_ON_MAXIMUM_TIME_MS(fingerOnMaxTime)) {
+			perf_count(PERF_TOUCH_TOO_LONG);
+			result = TOUCH_FALSE;
+			atomic_write16(&fingerOnCnt, 0);
+			SensorState = FINGER_ON_DETECT;
+		} else if (edgeStatus == EDGE_FALLING) {
+#if TOUCH_FUSION == TOUCH_FUSION_CONFIRM
+			/* the key has to have seen the finger as well */
+			if (onCnt >= FINGER_ON_MINIMUM_TIME_MS(fingerOnMinTime) && keyConfirmed)
+#else
+			if (onCnt >= FINGER_ON_MINIMUM_TIME_MS(fingerOnMinTime))
+#endif
+				result = TOUCH_VALID;
+			else
+				result = TOUCH_FALSE;
+
+			if (onCnt < FINGER_ON_MINIMUM_TIME_MS(fingerOnMinTime))
+				perf_count(PERF_TOUCH_TOO_SHORT);
+
+			atomic_write16(&fingerOnCnt, 0);
+			SensorState = FINGER_ON_DETECT;
+		}
+		break;
+	}
+
+	if (result == TOUCH_VALID)
+		touchCnt++;
+	else if (result == TOUCH_FALSE)
+		falseTouchCnt++;
+
+	*edge = edgeStatus;
+	return result;
+}
+
+/*============================================================================
+uint8_t touch_detect_held(void)
+------------------------------------------------------------------------------
+Purpose: Tells whether the finger is still on, for holds longer than the
+         touch state machine follows.
+Input  : none
+Output : 1 while the delta of the last sample is at or above the edge
+         threshold, with a fusion stage while the key is in detect
+Notes  : Also past fingerOnMaxTime, unlike SensorState. A rising edge
+         without a finger behind it, a water drop or the ringing after a
+         valve pulse, leaves the delta close to 0.
+============================================================================*/
+uint8_t touch_detect_held(void)
+{
+#if TOUCH_FUSION != TOUCH_FUSION_NONE
+	return keyState == KEY_DETECT;
+#else
+	return sampleDelta >= (int16_t)STRONG_EDGE_THRESHOLD;
+#endif
+}
+
+/*============================================================================
+void touch_detect_key(uint8_t state)
+------------------------------------------------------------------------------
+Purpose: Passes the debounced key state of the measurement to the fusion
+         stage.
+Input  : KEY_QUIET, KEY_FILTER_IN or KEY_DETECT
+Output : none
+Notes  : Called ahead of touch_detect_sample(), unused with
+         TOUCH_FUSION_NONE.
+============================================================================*/
+void touch_detect_key(uint8_t state)
+{
+	keyState = state;
+}
+
+/*============================================================================
+void touch_detect_tick(void)
+------------------------------------------------------------------------------
+Purpose: Advances the finger on time and the blanking time.
+Input  : none
+Output : none
+Notes  : Called from the RTC interrupt every RTC_WAKE_UP_TIME ms.
+============================================================================*/
+void touch_detect_tick(void)
+{
+	/* count the time when the  finger on */
+	if (SensorState == FINGER_OFF_DETECT)
+		fingerOnCnt++;
+
+	/* the samples end the blanking, at the latest after freezeTime */
+	if (edgeDetectFreeze == 1)
+		edgeFreezeCnt++;
+}
+
+/*============================================================================
+void touch_detect_freeze(void)
+------------------------------------------------------------------------------
+Purpose: Blanks the edge detection while the valve pulse disturbs the
+         sensor, until the disturbance has decayed.
+Input  : none
+Output : none
+Notes  : See touch_detect_blank(). Also called from the RTC interrupt, by
+         the auto-close of the valve: the model state of the main loop is
+         left alone, the next sample restarts it. A pulse from the main
+         loop during the blanking: the interrupt stops counting first and
+         starts again last, no cli needed.
+============================================================================*/
+void touch_detect_freeze(void)
+{
+	blankRestart     = 1;
+	edgeDetectFreeze = 0;
+	edgeFreezeCnt    = 0;
+	edgeDetectFreeze = 1;
+}
+
+/*============================================================================
+void touch_detect_reset(void)
+------------------------------------------------------------------------------
+Purpose: Drops a touch in progress and the previous delta, after the
+         reference has been recalibrated.
+Input  : none
+Output : none
+Notes  :
+============================================================================*/
+void touch_detect_reset(void)
+{
+	filteredDeltaValue = 0;
+#if TOUCH_FILTER_SETTLE > 0
+	settleCnt = 0;
+#endif
+#if TOUCH_FILTER == TOUCH_FILTER_FIR
+	olderDelta[0] = 0;
+	olderDelta[1] = 0;
+#endif
+	atomic_write16(&fingerOnCnt, 0);
+	SensorState        = FINGER_ON_DETECT;
+	sampleDelta        = 0;
+	baselineInit       = 1;
+}
+
+/*============================================================================
+void touch_detect_baseline(uint16_t signal)
+------------------------------------------------------------------------------
+Purpose: Tracks the reference of the node in place of the qtlib key module,
+         the reference is baselineValue.
+Input  : signal of the node, ahead of touch_detect_sample()
+Output : none
+Notes  : The first signal after touch_detect_reset() is the reference.
+         The filter state moves with the reference, so its steps are no
+         edges.
+============================================================================*/
+void touch_detect_baseline(uint16_t signal)
+{
+	uint16_t below;
+
+	if (baselineInit) {
+		baselineInit     = 0;
+		baselineValue    = signal;
+		baselineDriftCnt = 0;
+		baselineHoldCnt  = 0;
+		baselineRecalCnt = 0;
+		return;
+	}
+
+	/* a finger or a valve pulse holds the reference */
+	if (SensorState == FINGER_OFF_DETECT || edgeDetectFreeze) {
+		baselineHoldCnt  = BASELINE_TIME_MS(TOUCH_BASELINE_HOLD_MS);
+		baselineDriftCnt = 0;
+		baselineRecalCnt = 0;
+		return;
+	}
+
+	/* far below the reference for a while: calibrated with a finger on */
+	below = signal < baselineValue ? (uint16_t)(baselineValue - signal) : 0u;
+	if (below >= TOUCH_BASELINE_RECAL_THRESHOLD) {
+		if (++baselineRecalCnt >= TOUCH_BASELINE_RECAL_SAMPLES) {
+			touch_detect_shift(below > TOUCH_DELTA_LIMIT ? TOUCH_DELTA_LIMIT : (int16_t)below);
+			baselineValue    = signal;
+			baselineDriftCnt = 0;
+			baselineRecalCnt = 0;
+		}
+		return;
+	}
+	baselineRecalCnt = 0;
+
+	if (baselineHoldCnt) {
+		baselineHoldCnt--;
+		return;
+	}
+
+	/* one count per drift time, a signal at the reference restarts it */
+	if (signal == baselineValue) {
+		baselineDriftCnt = 0;
+	} else if (++baselineDriftCnt >= (signal > baselineValue ? BASELINE_TIME_MS(TOUCH_BASELINE_DRIFT_UP_MS)
+	                                                           : BASELINE_TIME_MS(TOUCH_BASELINE_DRIFT_DOWN_MS))) {
+		baselineDriftCnt = 0;
+		if (signal > baselineValue) {
+			baselineValue++;
+			touch_detect_shift(-1);
+		} else {
+			baselineValue--;
+			touch_detect_shift(1);
+		}
+	}
+}
@@ -0,0 +1,377 @@
+/*============================================================================
+Filename : uart_command.c
+Project : Attiny814Code
+Purpose : Receiver and dispatcher of the binary UART command channel, see
+          uart_command.h. Bytes are framed in the receive interrupt, the
+          command itself is executed from the main loop by cmd_process().
+          Hardware independent apart from the critical section, also built
+          on the host for the command simulator.
+============================================================================*/
+
+/*----------------------------------------------------------------------------
+  include files
+----------------------------------------------------------------------------*/
+#include <string.h>
+
+#include "uart_command.h"
+#include "datastreamer_frame.h"
+#include "perf_counter.h"
+
+#ifdef __AVR__
+#include <atomic.h>
+#define CMD_ENTER_CRITICAL() ENTER_CRITICAL(C)
+#define CMD_EXIT_CRITICAL() EXIT_CRITICAL(C)
+#else
+#define CMD_ENTER_CRITICAL()
+#define CMD_EXIT_CRITICAL()
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *--------------------------------------------------------------------------*/
+/* receiver states */
+#define RX_SOF 0u
+#define RX_LEN 1u
+#define RX_BODY 2u
+#define RX_CRC_LOW 3u
+#define RX_CRC_HIGH 4u
+
+/* counters returned by CMD_COUNTERS, the command channel adds three */
+#define CMD_MAX_COUNTERS ((CMD_MAX_LEN - 2u) / 2u)
+
+#if PERF_COUNT > CMD_MAX_COUNTERS
+#error "CMD_PERF response does not fit CMD_MAX_LEN"
+#endif
+
+/*----------------------------------------------------------------------------
+  global variables
+----------------------------------------------------------------------------*/
+cmd_stats_t cmd_stats;
+
+static uint8_t          rx_buf[CMD_MAX_LEN];
+static uint8_t          rx_state;
+static uint8_t          rx_len;
+static uint8_t          rx_count;
+static uint16_t         rx_crc;
+static volatile uint8_t rx_ready;
+static volatile uint8_t rx_idle_ticks;
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *--------------------------------------------------------------------------*/
+static void    cmd_send_response(uint8_t cmd, uint8_t status, const uint8_t *payload, uint8_t len);
+static uint8_t cmd_param_read(uint8_t id, uint16_t *value);
+static uint8_t cmd_param_write(uint8_t id, uint16_t value);
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *--------------------------------------------------------------------------*/
+
+/*============================================================================
+void cmd_init(void)
+------------------------------------------------------------------------------
+Purpose: Resets the receiver and the statistics.
+Input  : none
+Output : none
+Notes  :
+============================================================================*/
+void cmd_init(void)
+{
+	rx_state      = RX_SOF;
+	rx_ready      = 0u;
+	rx_idle_ticks = CMD_RX_TIMEOUT_TICKS;
+	memset(&cmd_stats, 0, sizeof(cmd_stats));
+}
+
+/*============================================================================
+void cmd_rx_byte(uint8_t data)
+------------------------------------------------------------------------------
+Purpose: Feeds one received byte into the request framer.
+Input  : received byte
+Output : none
+Notes  : Called from the USART receive complete interrupt. Bytes arriving
+         while a complete request waits for cmd_process() are dropped.
+============================================================================*/
+void cmd_rx_byte(uint8_t data)
+{
+	rx_idle_ticks = 0u;
+
+	if (rx_ready) {
+		cmd_stats.overruns++;
+		return;
+	}
+
+	switch (rx_state) {
+	case RX_SOF:
+		if (data == CMD_REQUEST_SOF) {
+			rx_state = RX_LEN;
+		}
+		break;
+
+	case RX_LEN:
+		if (data == 0u || data > CMD_MAX_LEN) {
+			rx_state = RX_SOF;
+			break;
+		}
+		rx_len   = data;
+		rx_count = 0u;
+		rx_crc   = ds_crc16_update(DS_CRC16_INIT, data);
+		rx_state = RX_BODY;
+		break;
+
+	case RX_BODY:
+		rx_buf[rx_count++] = data;
+		rx_crc             = ds_crc16_update(rx_crc, data);
+		if (rx_count == rx_len) {
+			rx_state = RX_CRC_LOW;
+		}
+		break;
+
+	case RX_CRC_LOW:
+		if (data != (uint8_t)rx_crc) {
+			cmd_stats.crc_errors++;
+			rx_state = RX_SOF;
+			break;
+		}
+		rx_state = RX_CRC_HIGH;
+		break;
+
+	default:
+		if (data != (uint8_t)(rx_crc >> 8u)) {
+			cmd_stats.crc_errors++;
+		} else {
+			cmd_stats.frames++;
+			rx_ready = 1u;
+		}
+		rx_state = RX_SOF;
+		break;
+	}
+}
+
+/*============================================================================
+void cmd_tick(void)
+------------------------------------------------------------------------------
+Purpose: Receive timeout, drops a partial request once the line has been
+         quiet for CMD_RX_TIMEOUT_TICKS calls.
+Input  : none
+Output : none
+Notes  : Called every measurement period from the RTC interrupt.
+============================================================================*/
+void cmd_tick(void)
+{
+	if (rx_idle_ticks < CMD_RX_TIMEOUT_TICKS) {
+		rx_idle_ticks++;
+		if (rx_idle_ticks == CMD_RX_TIMEOUT_TICKS) {
+			rx_state = RX_SOF;
+		}
+	}
+}
+
+/*============================================================================
+uint8_t cmd_rx_busy(void)
+------------------------------------------------------------------------------
+Purpose: Tells whether the receiver needs the main clock.
+Input  : none
+Output : 1 while a request is being received or waits for cmd_process(),
+         or the line was active within the receive timeout
+Notes  : The device must not enter standby while this returns 1.
+============================================================================*/
+uint8_t cmd_rx_busy(void)
+{
+	return rx_ready || rx_idle_ticks < CMD_RX_TIMEOUT_TICKS;
+}
+
+/*============================================================================
+uint8_t cmd_process(void)
+------------------------------------------------------------------------------
+Purpose: Executes a received request and transmits the response.
+Input  : none
+Output : 1 if a request was executed, 0 otherwise
+Notes  : Called from the main loop.
+============================================================================*/
+uint8_t cmd_process(void)
+{
+	uint8_t  payload[CMD_MAX_LEN - 2u];
+	uint16_t counters[CMD_MAX_COUNTERS];
+	uint16_t value;
+	uint8_t  status = CMD_STATUS_OK;
+	uint8_t  len    = 0u;
+	uint8_t  i, num;
+
+	if (!rx_ready) {
+		return 0u;
+	}
+
+	switch (rx_buf[0]) {
+	case CMD_PING:
+		payload[len++] = CMD_PROTOCOL_VERSION;
+		payload[len++] = PARAM_COUNT;
+		break;
+
+	case CMD_PARAM_READ:
+		if (rx_len != 2u) {
+			status = CMD_STATUS_BAD_LENGTH;
+			break;
+		}
+		status         = cmd_param_read(rx_buf[1], &value);
+		payload[len++] = (uint8_t)value;
+		payload[len++] = (uint8_t)(value >> 8u);
+		break;
+
+	case CMD_PARAM_WRITE:
+		if (rx_len != 4u) {
+			status = CMD_STATUS_BAD_LENGTH;
+			break;
+		}
+		status = cmd_param_write(rx_buf[1], rx_buf[2] | ((uint16_t)rx_buf[3] << 8u));
+		if (status == CMD_STATUS_OK) {
+			cmd_param_read(rx_buf[1], &value);
+			payload[len++] = (uint8_t)value;
+			payload[len++] = (uint8_t)(value >> 8u);
+		}
+		break;
+
+	case CMD_RECALIBRATE:
+		cmd_recalibrate();
+		break;
+
+	case CMD_COUNTERS:
+		CMD_ENTER_CRITICAL();
+		counters[0] = cmd_stats.frames;
+		counters[1] = cmd_stats.crc_errors;
+		counters[2] = cmd_stats.overruns;
+		CMD_EXIT_CRITICAL();
+		num = 3u + cmd_read_counters(&counters[3], CMD_MAX_COUNTERS - 3u);
+		for (i = 0u; i < num; i++) {
+			payload[len++] = (uint8_t)counters[i];
+			payload[len++] = (uint8_t)(counters[i] >> 8u);
+		}
+		break;
+
+	case CMD_PERF:
+		perf_snapshot(counters);
+		for (i = 0u; i < PERF_COUNT; i++) {
+			payload[len++] = (uint8_t)counters[i];
+			payload[len++] = (uint8_t)(counters[i] >> 8u);
+		}
+		break;
+
+	default:
+		status = CMD_STATUS_UNKNOWN_CMD;
+		break;
+	}
+
+	cmd_send_response(rx_buf[0], status, payload, len);
+
+	/* the receiver may use rx_buf again */
+	rx_ready = 0u;
+
+	return 1u;
+}
+
+/*============================================================================
+static void cmd_send_response(uint8_t cmd, uint8_t status,
+                              const uint8_t *payload, uint8_t len)
+------------------------------------------------------------------------------
+Purpose: Frames and transmits a response.
+Input  : request command; CMD_STATUS_xxx; response payload and its length
+Output : none
+Notes  :
+============================================================================*/
+static void cmd_send_response(uint8_t cmd, uint8_t status, const uint8_t *payload, uint8_t len)
+{
+	uint16_t crc;
+	uint8_t  i;
+
+	cmd |= CMD_RESPONSE_FLAG;
+	len += 2u;
+
+	cmd_tx_byte(CMD_RESPONSE_SOF);
+	cmd_tx_byte(len);
+	cmd_tx_byte(cmd);
+	cmd_tx_byte(status);
+
+	crc = ds_crc16_update(DS_CRC16_INIT, len);
+	crc = ds_crc16_update(crc, cmd);
+	crc = ds_crc16_update(crc, status);
+
+	for (i = 0u; i < len - 2u; i++) {
+		cmd_tx_byte(payload[i]);
+		crc = ds_crc16_update(crc, payload[i]);
+	}
+
+	cmd_tx_byte((uint8_t)crc);
+	cmd_tx_byte((uint8_t)(crc >> 8u));
+}
+
+/*============================================================================
+static uint8_t cmd_param_read(uint8_t id, uint16_t *value)
+------------------------------------------------------------------------------
+Purpose: Reads a parameter of the application parameter table.
+Input  : parameter id; destination
+Output : CMD_STATUS_xxx
+Notes  : The read is atomic, parameters may be used by interrupts. An
+         entry without a variable is not in this build.
+============================================================================*/
+static uint8_t cmd_param_read(uint8_t id, uint16_t *value)
+{
+	const cmd_param_t *param;
+
+	*value = 0u;
+	if (id >= PARAM_COUNT) {
+		return CMD_STATUS_BAD_PARAM;
+	}
+
+	param = &cmd_param_table[id];
+	if (param->value == NULL) {
+		return CMD_STATUS_BAD_PARAM;
+	}
+	CMD_ENTER_CRITICAL();
+	if (param->size == 1u) {
+		*value = *(uint8_t *)param->value;
+	} else {
+		*value = *(uint16_t *)param->value;
+	}
+	CMD_EXIT_CRITICAL();
+
+	return CMD_STATUS_OK;
+}
+
+/*============================================================================
+static uint8_t cmd_param_write(uint8_t id, uint16_t value)
+------------------------------------------------------------------------------
+Purpose: Writes a parameter of the application parameter table.
+Input  : parameter id; new value
+Output : CMD_STATUS_xxx
+Notes  : Values outside of the min/max of the table entry are rejected.
+         The write is atomic, parameters may be used by interrupts.
+============================================================================*/
+static uint8_t cmd_param_write(uint8_t id, uint16_t value)
+{
+	const cmd_param_t *param;
+
+	if (id >= PARAM_COUNT) {
+		return CMD_STATUS_BAD_PARAM;
+	}
+
+	param = &cmd_param_table[id];
+	if (param->value == NULL) {
+		return CMD_STATUS_BAD_PARAM;
+	}
+	if (param->read_only) {
+		return CMD_STATUS_READ_ONLY;
+	}
+	if (value < param->min || value > param->max) {
+		return CMD_STATUS_OUT_OF_RANGE;
+	}
+
+	CMD_ENTER_CRITICAL();
+	if (param->size == 1u) {
+		*(uint8_t *)param->value = (uint8_t)value;
+	} else {
+		*(uint16_t *)param->value = value;
+	}
+	CMD_EXIT_CRITICAL();
+
+	return CMD_STATUS_OK;
+}
@@ -38,6 +38,7 @@
 #include <clock_config.h>
 #include <usart_basic.h>
 #include <atomic.h>
+#include <uart_command.h>
 
 /**
  * \brief Initialize USART interface
@@ -53,19 +54,19 @@ int8_t USART_init()
 
 	USART0.BAUD = (uint16_t)USART0_BAUD_RATE(115200); /* set baud rate register */
 
-	// USART0.CTRLA = 0 << USART_ABEIE_bp /* Auto-baud Error Interrupt Enable: disabled */
-	//		 | 0 << USART_DREIE_bp /* Data Register Empty Interrupt Enable: disabled */
-	//		 | 0 << USART_LBME_bp /* Loop-back Mode Enable: disabled */
-	//		 | USART_RS485_OFF_gc /* RS485 Mode disabled */
-	//		 | 0 << USART_RXCIE_bp /* Receive Complete Interrupt Enable: disabled */
-	//		 | 0 << USART_RXSIE_bp /* Receiver Start Frame Interrupt Enable: disabled */
-	//		 | 0 << USART_TXCIE_bp; /* Transmit Complete Interrupt Enable: disabled */
+	USART0.CTRLA = 0 << USART_ABEIE_bp /* Auto-baud Error Interrupt Enable: disabled */
+	               | 0 << USART_DREIE_bp /* Data Register Empty Interrupt Enable: disabled */
+	               | 0 << USART_LBME_bp /* Loop-back Mode Enable: disabled */
+	               | USART_RS485_OFF_gc /* RS485 Mode disabled */
+	               | DEF_UART_COMMAND_ENABLE << USART_RXCIE_bp /* Receive Complete Interrupt Enable: command channel */
+	               | 0 << USART_RXSIE_bp /* Receiver Start Frame Interrupt Enable: disabled */
+	               | 0 << USART_TXCIE_bp; /* Transmit Complete Interrupt Enable: disabled */
 
 	USART0.CTRLB = 0 << USART_MPCM_bp       /* Multi-processor Communication Mode: disabled */
 	               | 0 << USART_ODME_bp     /* Open Drain Mode Enable: disabled */
-	               | 0 << USART_RXEN_bp     /* Reciever enable: enabled */
+	               | DEF_UART_COMMAND_ENABLE << USART_RXEN_bp /* Reciever enable: command channel */
 	               | USART_RXMODE_NORMAL_gc /* Normal mode */
-	               | 0 << USART_SFDEN_bp    /* Start Frame Detection Enable: disabled */
+	               | (DEF_UART_COMMAND_ENABLE & DEF_UART_COMMAND_SFD_WAKE) << USART_SFDEN_bp /* Start Frame Detection Enable: wake from standby */
 	               | 1 << USART_TXEN_bp;    /* Transmitter Enable: enabled */
 
 	// USART0.CTRLC = USART_CMODE_ASYNCHRONOUS_gc /* Asynchronous Mode */
@@ -0,0 +1,42 @@
+# Toolchain file for the ATtiny814 firmware
+#
+#   cmake -S . -B build-avr -DCMAKE_TOOLCHAIN_FILE=cmake/avr-gcc.cmake
+#
+# AVR_TOOLCHAIN_DIR  directory holding avr-gcc if it is not on the PATH
+# AVR_DFP_DIR        Microchip ATtiny device pack, only needed when the
+#                    avr-libc in use does not know the attiny814
+
+set(CMAKE_SYSTEM_NAME Generic)
+set(CMAKE_SYSTEM_PROCESSOR avr)
+
+set(AVR_TOOLCHAIN_DIR "" CACHE PATH "Directory of avr-gcc, empty to search the PATH")
+set(AVR_DFP_DIR "" CACHE PATH "ATtiny device family pack, empty to use avr-libc")
+set(AVR_MCU attiny814 CACHE STRING "Target device")
+
+if(AVR_TOOLCHAIN_DIR)
+	set(_avr_hints HINTS ${AVR_TOOLCHAIN_DIR} NO_DEFAULT_PATH)
+endif()
+
+find_program(AVR_GCC avr-gcc ${_avr_hints})
+find_program(AVR_OBJCOPY avr-objcopy ${_avr_hints})
+find_program(AVR_OBJDUMP avr-objdump ${_avr_hints})
+find_program(AVR_SIZE avr-size ${_avr_hints})
+find_program(AVR_AR avr-gcc-ar ${_avr_hints})
+
+if(NOT AVR_GCC)
+	message(FATAL_ERROR "avr-gcc not found, set AVR_TOOLCHAIN_DIR")
+endif()
+
+set(CMAKE_C_COMPILER ${AVR_GCC})
+set(CMAKE_ASM_COMPILER ${AVR_GCC})
+if(AVR_AR)
+	# LTO objects need the plugin aware archiver
+	set(CMAKE_AR ${AVR_AR} CACHE FILEPATH "" FORCE)
+endif()
+
+set(CMAKE_EXECUTABLE_SUFFIX .elf)
+set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY)
+
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
@@ -0,0 +1,83 @@
+/*============================================================================
+Filename : bench_datastreamer.c
+Project : Attiny814Code host tests
+Purpose : Host throughput of the datastreamer frame encoder, the CRC and
+          the stream decoder. Host numbers only rank code changes against
+          each other, they say nothing about cycles on the ATtiny814.
+
+Usage   : bench_datastreamer [frames]
+============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "datastreamer_frame.h"
+#include "dsdecode.h"
+
+#define NUM_CHANNELS 1u
+#define NUM_FIELDS DS_FRAME_NUM_FIELDS(NUM_CHANNELS, 1u)
+#define FRAME_SIZE (DS_FRAME_LEN_MAX(NUM_FIELDS) + DS_FRAME_OVERHEAD)
+
+static double now_s(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static void count_frame(const ds_frame_t *frame, void *ctx)
+{
+	(void)frame;
+	(*(unsigned long *)ctx)++;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000ul;
+	unsigned long i, decoded = 0ul;
+	uint8_t *     stream = malloc(frames * FRAME_SIZE);
+	uint16_t      fields[NUM_FIELDS] = {0u, 500u, 480u, 20u, 50u, 0x1234u, 0u, 100u, 0u};
+	uint16_t      prev[NUM_FIELDS];
+	uint16_t      crc = DS_CRC16_INIT;
+	ds_encoder_t  enc;
+	ds_decoder_t  dec;
+	size_t        len = 0u;
+	double        t0, t_enc, t_crc, t_dec;
+
+	if (!stream) {
+		perror("bench_datastreamer");
+		return 1;
+	}
+
+	srand(1);
+	ds_encoder_init(&enc, prev, NUM_FIELDS, 16u);
+	t0 = now_s();
+	for (i = 0ul; i < frames; i++) {
+		fields[0] = (uint16_t)i;
+		fields[1] = (uint16_t)(fields[1] + rand() % 21 - 10);
+		fields[3] = (uint16_t)(rand() % 200 - 100);
+		len += ds_frame_encode(&enc, &stream[len], fields, NUM_CHANNELS, DS_FLAG_TIMESTAMP, 0u);
+	}
+	t_enc = now_s() - t0;
+
+	t0 = now_s();
+	for (i = 0ul; i < len; i++) {
+		crc = ds_crc16_update(crc, stream[i]);
+	}
+	t_crc = now_s() - t0;
+
+	ds_decoder_init(&dec);
+	t0 = now_s();
+	ds_decoder_feed(&dec, stream, len, count_frame, &decoded);
+	t_dec = now_s() - t0;
+
+	printf("frames %lu, %.2f bytes/frame (crc %04x)\n", frames, (double)len / (double)frames, crc);
+	printf("encode   %8.2f Mframes/s\n", (double)frames / t_enc * 1e-6);
+	printf("crc16    %8.2f MB/s\n", (double)len / t_crc * 1e-6);
+	printf("decode   %8.2f Mframes/s, %.2f MB/s\n", (double)decoded / t_dec * 1e-6, (double)len / t_dec * 1e-6);
+
+	free(stream);
+	return decoded != frames;
+}
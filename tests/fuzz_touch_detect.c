@@ -0,0 +1,503 @@
+/*============================================================================
+Filename : fuzz_touch_detect.c
+Project : Attiny814Code host tests
+Purpose : Fuzz harness of the touch detection core (src/touch_detect.c).
+          Replays arbitrary signal/reference sequences, RTC tick
+          interleavings, parameter writes and recalibrations the way main.c
+          drives the core, and aborts when an invariant breaks:
+
+          - the noise estimate matches its model, recomputed in 32 bits,
+            and the edge threshold is noiseFactor times the estimate
+            within edgeThresholdMin..Max
+          - edges match the step of the filter stage, recomputed in 32 bits,
+            so an overflow of the 16 bit arithmetic shows up
+          - a valid touch needs a rising edge, then a falling edge after
+            FINGER_ON_MINIMUM..MAXIMUM ticks, and is counted once
+          - the blanking after a valve pulse matches its model: edges of
+            the delta without the decaying disturbance, the end no later
+            than freezeTime and without an edge of its own
+
+          Built with -DFUZZ_LIBFUZZER for libFuzzer (clang -fsanitize=fuzzer),
+          otherwise with a standalone driver that runs the given files (AFL:
+          fuzz_touch_detect @@) or, without files, generated inputs.
+
+Input   : a sequence of records, a truncated record ends the input
+          0x00..0xDF  sample: (op & 0x0F) RTC ticks, then signal, reference
+                      (u16 little endian)
+          0xE0..0xEF  parameter write: value (u16), parameter op & 0x0F
+          0xF0..0xFF  recalibration
+
+Usage   : fuzz_touch_detect [-n samples] [-s seed] [file...]
+============================================================================*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "touch_detect.h"
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+#define OP_PARAM 0xE0u
+#define OP_RESET 0xF0u
+
+#define INPUT_SIZE 4096u
+
+#define FAIL(...)                                                                                                      \
+	do {                                                                                                               \
+		fprintf(stderr, "fuzz_touch_detect: sample %lu: ", samples);                                                   \
+		fprintf(stderr, __VA_ARGS__);                                                                                  \
+		fputc('\n', stderr);                                                                                           \
+		abort();                                                                                                       \
+	} while (0)
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+/* Writable parameters, ranges of cmd_param_table in main.c */
+typedef struct {
+	void *   value;
+	uint8_t  size;
+	uint16_t min;
+	uint16_t max;
+} param_t;
+
+/*----------------------------------------------------------------------------
+ *     global variables
+ *----------------------------------------------------------------------------*/
+static const param_t params[] = {
+    {&noiseFactor, 1, 1, 16},
+    {&fingerOnMinTime, 2, 0, 10000},
+    {&fingerOnMaxTime, 2, 0, 10000},
+    {&freezeTime, 2, 0, 10000},
+    {&edgeThresholdMin, 2, 0, 1023},
+    {&edgeThresholdMax, 2, 0, 1023},
+    {&noiseAttackShift, 1, 0, 7},
+    {&noiseReleaseShift, 1, 0, 10},
+};
+
+static unsigned long samples;
+
+/* 32 bit model of the filter stage: previous delta or average, x[n-2],
+ * x[n-3] */
+static int32_t model[3];
+
+/* 32 bit model of the noise estimate and the samples it still skips */
+static int32_t  model_noise;
+static unsigned model_settle;
+
+/* blanking model: disturbance, onset samples left */
+static int32_t  model_offset;
+static unsigned model_onset;
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *----------------------------------------------------------------------------*/
+
+static void write_param(uint8_t id, uint16_t value)
+{
+	const param_t *p;
+
+	if (id >= sizeof(params) / sizeof(params[0])) {
+		return;
+	}
+	p = &params[id];
+	if (value < p->min || value > p->max) {
+		return;
+	}
+	if (p->size == 1u) {
+		*(uint8_t *)p->value = (uint8_t)value;
+	} else {
+		*(uint16_t *)p->value = value;
+	}
+}
+
+static int32_t clamp_delta(int32_t delta)
+{
+	if (delta > TOUCH_DELTA_LIMIT) {
+		return TOUCH_DELTA_LIMIT;
+	}
+	return delta < -TOUCH_DELTA_LIMIT ? -TOUCH_DELTA_LIMIT : delta;
+}
+
+static int32_t model_step(int32_t delta);
+
+/* Edge of a step */
+static uint8_t model_edge(int32_t step, uint16_t threshold)
+{
+	return step >= (int32_t)threshold && step > 0 ? EDGE_RISING : -step >= (int32_t)threshold && step < 0 ? EDGE_FALLING : EDGE_NONE;
+}
+
+/* Blanked sample, see touch_detect_blank(); count is edgeFreezeCnt before
+ * the sample. Returns the expected edge, sets *ends when the blanking
+ * ends and *step to the step of the plain delta then. */
+static uint8_t model_blank_step(int32_t delta, uint16_t threshold, uint16_t count, int *ends, int32_t *step)
+{
+	int32_t edge;
+
+	delta = clamp_delta(delta);
+	*ends = 0;
+	if (model_onset) {
+		model_onset--;
+		model_offset = clamp_delta(delta - model[0]);
+		return EDGE_NONE;
+	}
+	/* arithmetic shift, as the firmware */
+	model_offset -= model_offset >> TOUCH_BLANK_DECAY_SHIFT;
+	if (labs(model_offset) >= (long)threshold && count <= RADIOTUBE_FREEZE_TIME_MS(freezeTime)) {
+		edge = model_edge(model_step(clamp_delta(delta - model_offset)), threshold);
+		if (edge != EDGE_NONE) {
+			model_settle = TOUCH_FILTER_SETTLE;
+		}
+		return (uint8_t)edge;
+	}
+	model[0] = clamp_delta(model[0] + model_offset);
+	model[1] = clamp_delta(model[1] + model_offset);
+	model[2] = clamp_delta(model[2] + model_offset);
+	*ends = 1;
+	*step = model_step(delta);
+	return model_edge(*step, threshold);
+}
+
+/* Valve pulse after a valid touch */
+static void model_freeze(void)
+{
+	touch_detect_freeze();
+	model_offset = 0;
+	model_onset  = TOUCH_BLANK_ONSET_SAMPLES;
+}
+
+/* Step of the filter stage for a delta, see touch_detect_derivative() */
+static int32_t model_step(int32_t delta)
+{
+	int32_t step;
+
+	delta = clamp_delta(delta);
+#if TOUCH_FILTER == TOUCH_FILTER_FIR
+	step     = ((delta + model[0]) >> 1) - ((model[1] + model[2]) >> 1);
+	model[2] = model[1];
+	model[1] = model[0];
+	model[0] = delta;
+#elif TOUCH_FILTER == TOUCH_FILTER_EMA
+	step = delta - model[0];
+	model[0] += step >> TOUCH_FILTER_EMA_SHIFT;
+#else
+	step     = delta - model[0];
+	model[0] = delta;
+#endif
+	return step;
+}
+
+/* Noise estimate after a step, see touch_detect_noise(); edge is the
+ * classification of the step */
+static void model_noise_step(int32_t step, uint8_t edge)
+{
+	int32_t in = labs(step) << NOISE_LEVEL_FRAC;
+
+	if (edge != EDGE_NONE) {
+		model_settle = TOUCH_FILTER_SETTLE;
+	}
+	if (model_settle) {
+		model_settle--;
+		return;
+	}
+	if (in > (int32_t)NOISE_LEVEL_MAX) {
+		in = (int32_t)NOISE_LEVEL_MAX;
+	}
+	if (in > 2 * model_noise + (1 << NOISE_LEVEL_FRAC)) {
+		in = 2 * model_noise + (1 << NOISE_LEVEL_FRAC);
+	}
+	if (in > model_noise) {
+		model_noise += (in - model_noise + (1 << noiseAttackShift) - 1) >> noiseAttackShift;
+	} else {
+		model_noise -= (model_noise - in + (1 << noiseReleaseShift) - 1) >> noiseReleaseShift;
+	}
+	if (model_noise > (int32_t)NOISE_LEVEL_MAX) {
+		model_noise = (int32_t)NOISE_LEVEL_MAX;
+	}
+}
+
+/* Edge threshold for a noise estimate, the maximum wins when the limits
+ * cross */
+static uint32_t threshold_of(int32_t level)
+{
+	uint32_t threshold = ((uint32_t)level * noiseFactor) >> NOISE_LEVEL_FRAC;
+
+	if (threshold < edgeThresholdMin) {
+		threshold = edgeThresholdMin;
+	}
+	if (threshold > edgeThresholdMax) {
+		threshold = edgeThresholdMax;
+	}
+	return threshold;
+}
+
+/* Defaults of touch_detect.c */
+static void restart(void)
+{
+	STRONG_EDGE_THRESHOLD = 50u;
+	noiseLevel            = (50u << NOISE_LEVEL_FRAC) / 6u;
+	noiseFactor           = 6u;
+	noiseAttackShift      = 2u;
+	noiseReleaseShift     = 4u;
+	edgeThresholdMin      = 35u;
+	edgeThresholdMax      = 80u;
+	fingerOnMinTime       = 70u;
+	fingerOnMaxTime       = 500u;
+	freezeTime            = 300u;
+	edgeDetectFreeze      = 0u;
+	edgeFreezeCnt         = 0u;
+	model_offset          = 0;
+	model_onset           = 0u;
+	touchCnt              = 0u;
+	falseTouchCnt         = 0u;
+	touch_detect_reset();
+}
+
+/*============================================================================
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+------------------------------------------------------------------------------
+Purpose: Runs one input from the default state of the core.
+Input  : input records
+Output : 0
+Notes  : Aborts on a broken invariant.
+============================================================================*/
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	size_t   pos = 0u;
+	int      armed      = 0;   /* rising edge seen, touch in progress */
+	unsigned on_ticks   = 0u;  /* ticks since the rising edge */
+	uint16_t touches    = 0u;
+	uint8_t  edge, result, op;
+
+	restart();
+	memset(model, 0, sizeof(model));
+	model_noise  = noiseLevel;
+	model_settle = 0u;
+	while (pos < size) {
+		op = data[pos++];
+		if (op >= OP_RESET) {
+			touch_detect_reset();
+			memset(model, 0, sizeof(model));
+			model_settle = 0u;
+			armed = 0;
+			continue;
+		}
+		if (op >= OP_PARAM) {
+			if (size - pos < 2u) {
+				break;
+			}
+			write_param(op & 0x0Fu, (uint16_t)(data[pos] | data[pos + 1u] << 8u));
+			pos += 2u;
+			continue;
+		}
+		if (size - pos < 4u) {
+			break;
+		}
+
+		/* RTC interrupts between two measurements */
+		for (op &= 0x0Fu; op; op--) {
+			touch_detect_tick();
+			on_ticks += armed;
+		}
+
+		{
+			uint16_t signal    = (uint16_t)(data[pos] | data[pos + 1u] << 8u);
+			uint16_t reference = (uint16_t)(data[pos + 2u] | data[pos + 3u] << 8u);
+			uint16_t threshold = STRONG_EDGE_THRESHOLD;
+			uint16_t count     = edgeFreezeCnt;
+			int      blanked   = edgeDetectFreeze;
+			int      ends;
+			int32_t  step;
+
+			pos += 4u;
+			samples++;
+			result = touch_detect_sample(signal, reference, &edge);
+
+			if (blanked) {
+				uint8_t expected = model_blank_step((int32_t)signal - reference, threshold, count, &ends, &step);
+
+				if (edge != expected || ends == edgeDetectFreeze) {
+					FAIL("blanking edge %u, expected %u, ends %d after %u ticks", edge, expected, ends, count);
+				}
+				/* the end runs the plain edge stage */
+				blanked = !ends;
+				if (ends) {
+					model_noise_step(step, edge);
+				}
+			} else {
+				step = model_step((int32_t)signal - reference);
+				if (edge != model_edge(step, threshold)) {
+					FAIL("edge %u on step %ld, threshold %u", edge, (long)step, threshold);
+				}
+				model_noise_step(step, edge);
+			}
+
+			if (result != TOUCH_NONE && !armed) {
+				FAIL("touch result %u without a rising edge", result);
+			}
+			if (result == TOUCH_VALID) {
+				if (edge != EDGE_FALLING) {
+					FAIL("valid touch without a falling edge");
+				}
+				if (on_ticks < FINGER_ON_MINIMUM_TIME_MS(fingerOnMinTime)
+				    || on_ticks >= FINGER_ON_MAXIMUM_TIME_MS(fingerOnMaxTime)) {
+					FAIL("valid touch after %u ticks", on_ticks);
+				}
+				touches++;
+				model_freeze();
+			}
+			if (result != TOUCH_NONE) {
+				armed = 0;
+			} else if (edge == EDGE_RISING) {
+				armed    = 1;
+				on_ticks = 0u;
+			}
+			if (armed != (SensorState == FINGER_OFF_DETECT) || (armed && on_ticks != fingerOnCnt)) {
+				FAIL("state %u after %u ticks, expected %u after %u", SensorState, fingerOnCnt, armed, on_ticks);
+			}
+			if (touches != touchCnt) {
+				FAIL("%u touches counted, %u valid", touchCnt, touches);
+			}
+
+			/* the blanking leaves the threshold alone */
+			if (blanked) {
+				continue;
+			}
+		}
+
+		if (STRONG_EDGE_THRESHOLD > edgeThresholdMax
+		    || (edgeThresholdMin <= edgeThresholdMax && STRONG_EDGE_THRESHOLD < edgeThresholdMin)) {
+			FAIL("threshold %u outside %u..%u", STRONG_EDGE_THRESHOLD, edgeThresholdMin, edgeThresholdMax);
+		}
+		if (noiseLevel != model_noise) {
+			FAIL("noise level %u, expected %ld", noiseLevel, (long)model_noise);
+		}
+		if (STRONG_EDGE_THRESHOLD != threshold_of(noiseLevel)) {
+			FAIL("threshold %u for noise level %u", STRONG_EDGE_THRESHOLD, noiseLevel);
+		}
+	}
+	return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+static uint64_t random_state = 1u;
+
+static unsigned long next_random(void)
+{
+	random_state = random_state * 6364136223846793005ull + 1442695040888963407ull;
+	return (unsigned long)(random_state >> 33u);
+}
+
+static size_t put_u16(uint8_t *buf, size_t pos, uint16_t value)
+{
+	buf[pos]      = (uint8_t)value;
+	buf[pos + 1u] = (uint8_t)(value >> 8u);
+	return pos + 2u;
+}
+
+/* Noisy sensor with touches of random length and amplitude, the odd
+ * extreme value, parameter write and recalibration */
+static size_t generate(uint8_t *buf, size_t size)
+{
+	size_t   pos       = 0u;
+	uint16_t reference = (uint16_t)(next_random() % 4096u);
+	uint16_t signal    = reference;
+	unsigned noise     = (unsigned)(next_random() % 64u) + 1u;
+
+	while (pos + 5u <= size) {
+		unsigned long r = next_random();
+
+		switch (r % 64u) {
+		case 0:
+			buf[pos++] = (uint8_t)(OP_PARAM | (next_random() & 0x0Fu));
+			/* small values for the factor and the shifts */
+			pos = put_u16(buf, pos, (uint16_t)(next_random() % (r & 64u ? 1100u : 17u)));
+			continue;
+		case 1:
+			buf[pos++] = OP_RESET;
+			continue;
+		case 2:
+		case 3:
+			/* finger on or off */
+			signal = signal == reference ? (uint16_t)(reference + next_random() % 300u) : reference;
+			break;
+		case 4:
+			signal = (uint16_t)next_random();
+			break;
+		case 5:
+			reference = (uint16_t)(reference + next_random() % 5u - 2u);
+			break;
+		default:
+			break;
+		}
+		buf[pos++] = (uint8_t)(next_random() % 3u);
+		pos        = put_u16(buf, pos, (uint16_t)(signal + next_random() % (2u * noise + 1u) - noise));
+		pos        = put_u16(buf, pos, reference);
+	}
+	return pos;
+}
+
+static int run_file(const char *path)
+{
+	static uint8_t buf[1u << 20u];
+	size_t         size;
+	FILE *         f = fopen(path, "rb");
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	size = fread(buf, 1u, sizeof(buf), f);
+	fclose(f);
+	LLVMFuzzerTestOneInput(buf, size);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t buf[INPUT_SIZE];
+	unsigned long  target = 1000000ul;
+	clock_t        t0;
+	double         seconds;
+	int            opt;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n':
+			target = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			random_state = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: fuzz_touch_detect [-n samples] [-s seed] [file...]\n");
+			return 2;
+		}
+	}
+	if (optind < argc) {
+		for (; optind < argc; optind++) {
+			if (run_file(argv[optind]) != 0) {
+				return 2;
+			}
+		}
+		return 0;
+	}
+
+	t0 = clock();
+	while (samples < target) {
+		LLVMFuzzerTestOneInput(buf, generate(buf, sizeof(buf)));
+	}
+	seconds = (double)(clock() - t0) / CLOCKS_PER_SEC;
+	printf("fuzz_touch_detect: %lu samples, %.1f ns/sample\n", samples, seconds * 1e9 / (double)samples);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,450 @@
+/*============================================================================
+Filename : simavr_harness.c
+Project : Attiny814Code host tests
+Purpose : Runs the firmware ELF in simavr against a scripted sensor trace
+          and checks the valve pulses on IO1 (open) and IO2 (close).
+
+          Peripheral models, on top of the simavr core:
+          ADC0/PTC  a conversion started through ADC0.COMMAND ends after
+                    the conversion time with the trace value in ADC0.RES
+                    and the RESRDY interrupt
+          RTC PIT   periodic interrupt with the period and clock set by
+                    the firmware
+          AC0       AC0.STATUS.STATE follows the battery of the trace
+          IO1/IO2   PB0/PB1 levels, sampled after every instruction
+          TCA0 is not used by the firmware and not modelled.
+
+          Needs a simavr build with an ATtiny814 (avrxmega3) core: the
+          tinyAVR 1-series data space, with register bit addresses beyond
+          0x1FF. Stock simavr has none, the harness then exits with 77 and
+          ctest reports the test as skipped.
+
+Usage   : simavr_harness [-m mcu] [-c conversion_us] [-v] elf trace
+
+Trace   : one directive per line, '#' starts a comment, times in ms
+
+          signal <t> <value>       ADC0.RES from t on
+          noise <amplitude>        uniform noise on every result
+          battery <t> ok|low       AC0 state from t on (default ok)
+          expect IO1|IO2 <t0> <t1> one pulse starting between t0 and t1
+          width <min> <max>        accepted pulse width (default 25 35)
+          end <t>                  simulated time
+
+          Every pulse must match an expect line and every expect line
+          one pulse. Prints each pulse with its width and the latency
+          from the last signal change, and the number of wake-ups.
+============================================================================*/
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_interrupts.h>
+#include <sim_cycle_timers.h>
+#include <sim_time.h>
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+#define EXIT_SKIP 77
+
+/* CPU clock of Config/clock_config.h, unless the ELF carries one */
+#define DEFAULT_FREQUENCY 10000000u
+#define DEFAULT_CONVERSION_US 200u
+
+/* ATtiny814 data space */
+#define VPORTB_OUT 0x0005u
+#define RTC_CLKSEL 0x0147u
+#define RTC_PITCTRLA 0x0150u
+#define RTC_PITINTCTRL 0x0152u
+#define RTC_PITINTFLAGS 0x0153u
+#define PORTB_OUT 0x0424u
+#define ADC0_CTRLA 0x0600u
+#define ADC0_COMMAND 0x0608u
+#define ADC0_INTCTRL 0x060Au
+#define ADC0_INTFLAGS 0x060Bu
+#define ADC0_RES 0x0610u
+#define AC0_STATUS 0x0677u
+#define AC_STATE_bm 0x10u
+
+#define RTC_PIT_VECTOR 7u
+#define ADC0_RESRDY_VECTOR 17u
+
+#define NUM_PINS 2u
+#define MAX_EVENTS 256u
+#define MAX_PULSES 64u
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+typedef struct {
+	double   t;
+	uint16_t value;
+} event_t;
+
+typedef struct {
+	uint8_t pin;
+	double  t0, t1;
+	int     matched;
+} expect_t;
+
+typedef struct {
+	uint8_t pin;
+	double  start, width;
+	int     matched;
+} pulse_t;
+
+/*----------------------------------------------------------------------------
+ *     global variables
+ *----------------------------------------------------------------------------*/
+static const char *pin_names[NUM_PINS] = {"IO1", "IO2"};
+
+static event_t  signals[MAX_EVENTS];
+static unsigned num_signals;
+static event_t  batteries[MAX_EVENTS];
+static unsigned num_batteries;
+static expect_t expects[MAX_EVENTS];
+static unsigned num_expects;
+static pulse_t  pulses[MAX_PULSES];
+static unsigned num_pulses;
+static unsigned noise;
+static double   width_min = 25.0, width_max = 35.0;
+static double   end_ms    = 10000.0;
+
+static avr_t *          avr;
+static avr_int_vector_t rtc_pit_vector = {
+    .vector = RTC_PIT_VECTOR,
+    .enable = AVR_IO_REGBIT(RTC_PITINTCTRL, 0),
+    .raised = AVR_IO_REGBIT(RTC_PITINTFLAGS, 0),
+};
+static avr_int_vector_t adc_resrdy_vector = {
+    .vector = ADC0_RESRDY_VECTOR,
+    .enable = AVR_IO_REGBIT(ADC0_INTCTRL, 0),
+    .raised = AVR_IO_REGBIT(ADC0_INTFLAGS, 0),
+};
+static unsigned conversion_us = DEFAULT_CONVERSION_US;
+static int      adc_busy;
+static int      verbose;
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *----------------------------------------------------------------------------*/
+
+static double now_ms(void)
+{
+	return (double)avr->cycle * 1000.0 / (double)avr->frequency;
+}
+
+/* Value of the last event at or before t, def before the first one */
+static uint16_t value_at(const event_t *events, unsigned count, double t, uint16_t def)
+{
+	unsigned i;
+
+	for (i = 0u; i < count && events[i].t <= t; i++) {
+		def = events[i].value;
+	}
+	return def;
+}
+
+static int pin_number(const char *name)
+{
+	unsigned i;
+
+	for (i = 0u; i < NUM_PINS; i++) {
+		if (strcmp(name, pin_names[i]) == 0) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+static int add_event(event_t *events, unsigned *count, double t, unsigned value)
+{
+	if (*count == MAX_EVENTS || (*count && t < events[*count - 1u].t)) {
+		return -1;
+	}
+	events[*count].t     = t;
+	events[*count].value = (uint16_t)value;
+	(*count)++;
+	return 0;
+}
+
+/*============================================================================
+static int read_trace(const char *path)
+------------------------------------------------------------------------------
+Purpose: Reads the directives of a trace file.
+Input  : trace file
+Output : 0, -1 on errors (reported)
+Notes  : signal and battery times must not decrease.
+============================================================================*/
+static int read_trace(const char *path)
+{
+	char     line[256], word[16], arg[16];
+	double   t0, t1;
+	unsigned value, lineno = 0u;
+	int      pin, ok;
+	FILE *   f = fopen(path, "r");
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		char *comment = strchr(line, '#');
+
+		lineno++;
+		if (comment) {
+			*comment = '\0';
+		}
+		if (sscanf(line, "%15s", word) != 1) {
+			continue;
+		}
+		if (strcmp(word, "signal") == 0) {
+			ok = sscanf(line, "%*s %lf %u", &t0, &value) == 2 && value <= 0xFFFFu
+			     && add_event(signals, &num_signals, t0, value) == 0;
+		} else if (strcmp(word, "noise") == 0) {
+			ok = sscanf(line, "%*s %u", &noise) == 1;
+		} else if (strcmp(word, "battery") == 0) {
+			ok = sscanf(line, "%*s %lf %15s", &t0, arg) == 2 && (strcmp(arg, "ok") == 0 || strcmp(arg, "low") == 0)
+			     && add_event(batteries, &num_batteries, t0, strcmp(arg, "ok") == 0) == 0;
+		} else if (strcmp(word, "expect") == 0) {
+			ok = sscanf(line, "%*s %15s %lf %lf", arg, &t0, &t1) == 3 && (pin = pin_number(arg)) >= 0
+			     && num_expects < MAX_EVENTS;
+			if (ok) {
+				expects[num_expects].pin = (uint8_t)pin;
+				expects[num_expects].t0  = t0;
+				expects[num_expects].t1  = t1;
+				num_expects++;
+			}
+		} else if (strcmp(word, "width") == 0) {
+			ok = sscanf(line, "%*s %lf %lf", &width_min, &width_max) == 2;
+		} else if (strcmp(word, "end") == 0) {
+			ok = sscanf(line, "%*s %lf", &end_ms) == 1;
+		} else {
+			ok = 0;
+		}
+		if (!ok) {
+			fprintf(stderr, "%s:%u: invalid directive\n", path, lineno);
+			fclose(f);
+			return -1;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+/* RTC PIT: 2^(PERIOD+1) cycles of the RTC clock */
+static avr_cycle_count_t rtc_pit_timer(avr_t *a, avr_cycle_count_t when, void *param)
+{
+	uint8_t  period = (a->data[RTC_PITCTRLA] >> 3) & 0x0Fu;
+	unsigned hz     = (a->data[RTC_CLKSEL] & 0x03u) == 0x01u ? 1024u : 32768u;
+	uint64_t us;
+
+	(void)param;
+	if ((a->data[RTC_PITCTRLA] & 0x01u) && period) {
+		avr_raise_interrupt(a, &rtc_pit_vector);
+	}
+	us = ((uint64_t)2u << (period ? period : 9u)) * 1000000u / hz;
+	return when + avr_usec_to_cycles(a, (uint32_t)us);
+}
+
+/* ADC0/PTC end of conversion */
+static avr_cycle_count_t adc_done_timer(avr_t *a, avr_cycle_count_t when, void *param)
+{
+	uint16_t value = value_at(signals, num_signals, now_ms(), 0u);
+
+	(void)when;
+	(void)param;
+	if (noise) {
+		value = (uint16_t)(value + (unsigned)rand() % (2u * noise + 1u) - noise);
+	}
+	a->data[ADC0_RES]      = (uint8_t)value;
+	a->data[ADC0_RES + 1u] = (uint8_t)(value >> 8u);
+	a->data[ADC0_COMMAND] &= (uint8_t)~0x01u;
+	adc_busy = 0;
+	avr_raise_interrupt(a, &adc_resrdy_vector);
+	return 0;
+}
+
+static void poll_adc(void)
+{
+	if (!adc_busy && (avr->data[ADC0_CTRLA] & 0x01u) && (avr->data[ADC0_COMMAND] & 0x01u)) {
+		adc_busy = 1;
+		avr_cycle_timer_register_usec(avr, conversion_us, adc_done_timer, NULL);
+	}
+}
+
+static void poll_pins(void)
+{
+	static double rise[NUM_PINS];
+	static int    level[NUM_PINS];
+	uint8_t       out = avr->data[VPORTB_OUT] | avr->data[PORTB_OUT];
+	unsigned      pin;
+
+	for (pin = 0u; pin < NUM_PINS; pin++) {
+		int now = (out >> pin) & 1;
+
+		if (now == level[pin]) {
+			continue;
+		}
+		level[pin] = now;
+		if (now) {
+			rise[pin] = now_ms();
+		} else if (num_pulses < MAX_PULSES) {
+			pulses[num_pulses].pin   = (uint8_t)pin;
+			pulses[num_pulses].start = rise[pin];
+			pulses[num_pulses].width = now_ms() - rise[pin];
+			num_pulses++;
+		}
+	}
+}
+
+/* The simulation runs as fast as possible instead of in real time */
+static void no_sleep(avr_t *a, avr_cycle_count_t how_long)
+{
+	(void)a;
+	(void)how_long;
+}
+
+/* Time of the last signal change at or before t */
+static double last_change(double t)
+{
+	double   last = 0.0;
+	unsigned i;
+
+	for (i = 1u; i < num_signals && signals[i].t <= t; i++) {
+		if (signals[i].value != signals[i - 1u].value) {
+			last = signals[i].t;
+		}
+	}
+	return last;
+}
+
+/* Checks the pulses against the expectations, returns the failures */
+static int check_pulses(void)
+{
+	unsigned i, j;
+	int      failures = 0;
+
+	for (i = 0u; i < num_pulses; i++) {
+		pulse_t *p = &pulses[i];
+
+		for (j = 0u; j < num_expects; j++) {
+			if (!expects[j].matched && expects[j].pin == p->pin && p->start >= expects[j].t0
+			    && p->start <= expects[j].t1) {
+				expects[j].matched = 1;
+				p->matched         = 1;
+				break;
+			}
+		}
+		printf("%s pulse at %.1f ms, width %.2f ms, latency %.1f ms%s\n",
+		       pin_names[p->pin],
+		       p->start,
+		       p->width,
+		       p->start - last_change(p->start),
+		       p->matched ? "" : "  UNEXPECTED");
+		failures += !p->matched;
+		if (p->width < width_min || p->width > width_max) {
+			printf("  width outside %.1f..%.1f ms\n", width_min, width_max);
+			failures++;
+		}
+	}
+	for (j = 0u; j < num_expects; j++) {
+		if (!expects[j].matched) {
+			printf("missing %s pulse between %.1f and %.1f ms\n",
+			       pin_names[expects[j].pin],
+			       expects[j].t0,
+			       expects[j].t1);
+			failures++;
+		}
+	}
+	return failures;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: simavr_harness [-m mcu] [-c conversion_us] [-v] elf trace\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	elf_firmware_t fw;
+	const char *   mcu   = "attiny814";
+	unsigned       wakes = 0u;
+	int            state, prev = cpu_Running, opt, failures;
+
+	while ((opt = getopt(argc, argv, "m:c:v")) != -1) {
+		switch (opt) {
+		case 'm':
+			mcu = optarg;
+			break;
+		case 'c':
+			conversion_us = (unsigned)atoi(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 2) {
+		usage();
+	}
+	if (read_trace(argv[optind + 1]) != 0) {
+		return 2;
+	}
+
+	memset(&fw, 0, sizeof(fw));
+	if (elf_read_firmware(argv[optind], &fw) != 0) {
+		fprintf(stderr, "simavr_harness: %s: can not read firmware\n", argv[optind]);
+		return 2;
+	}
+	avr = avr_make_mcu_by_name(mcu);
+	if (!avr) {
+		printf("simavr has no %s core, skipped\n", mcu);
+		return EXIT_SKIP;
+	}
+	avr_init(avr);
+	avr->frequency = fw.frequency ? fw.frequency : DEFAULT_FREQUENCY;
+	avr_load_firmware(avr, &fw);
+	avr->sleep = no_sleep;
+	avr_register_vector(avr, &rtc_pit_vector);
+	avr_register_vector(avr, &adc_resrdy_vector);
+	avr_cycle_timer_register_usec(avr, 1000u, rtc_pit_timer, NULL);
+	srand(1u);
+
+	while (now_ms() < end_ms) {
+		state = avr_run(avr);
+		if (state == cpu_Done || state == cpu_Crashed) {
+			printf("firmware stopped at %.1f ms (%s)\n", now_ms(), state == cpu_Crashed ? "crashed" : "done");
+			return 1;
+		}
+		if (prev == cpu_Sleeping && state != cpu_Sleeping) {
+			wakes++;
+		}
+		prev = state;
+
+		if (value_at(batteries, num_batteries, now_ms(), 1u)) {
+			avr->data[AC0_STATUS] |= AC_STATE_bm;
+		} else {
+			avr->data[AC0_STATUS] &= (uint8_t)~AC_STATE_bm;
+		}
+		poll_adc();
+		poll_pins();
+	}
+
+	failures = check_pulses();
+	printf("%.0f ms simulated, %u wake-ups (%.1f/s)\n", end_ms, wakes, wakes * 1000.0 / end_ms);
+	if (verbose) {
+		printf("%u pulses, %u expected, %d failures\n", num_pulses, num_expects, failures);
+	}
+	return failures ? 1 : 0;
+}
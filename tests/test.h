@@ -0,0 +1,42 @@
+/*============================================================================
+Filename : test.h
+Project : Attiny814Code host tests
+Purpose : Minimal check macros for the native unit tests. A test program
+          runs its checks and returns test_result() from main.
+============================================================================*/
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define CHECK(cond)                                                                                                    \
+	do {                                                                                                               \
+		if (!(cond)) {                                                                                                 \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                                   \
+			test_failures++;                                                                                           \
+		}                                                                                                              \
+	} while (0)
+
+#define CHECK_EQ(a, b)                                                                                                 \
+	do {                                                                                                               \
+		long long a_ = (long long)(a), b_ = (long long)(b);                                                            \
+		if (a_ != b_) {                                                                                                \
+			fprintf(stderr, "%s:%d: %s == %s failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, a_, b_);             \
+			test_failures++;                                                                                           \
+		}                                                                                                              \
+	} while (0)
+
+static inline int test_result(const char *name)
+{
+	if (test_failures) {
+		fprintf(stderr, "%s: %d check(s) failed\n", name, test_failures);
+		return 1;
+	}
+	printf("%s: ok\n", name);
+	return 0;
+}
+
+#endif /* TEST_H */
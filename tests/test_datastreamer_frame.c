@@ -0,0 +1,174 @@
+/*============================================================================
+Filename : test_datastreamer_frame.c
+Project : Attiny814Code host tests
+Purpose : Round trip of the compact datastreamer frame format: firmware
+          encoder (datastreamer_frame.c) against the host decoder
+          (tools/dsdecode), including keyframes, split feeds and corrupted
+          frames.
+============================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "datastreamer_frame.h"
+#include "dsdecode.h"
+#include "test.h"
+
+#define NUM_CHANNELS 1u
+#define NUM_FIELDS DS_FRAME_NUM_FIELDS(NUM_CHANNELS, 1u)
+#define NUM_FRAMES 2000u
+#define KEYFRAME_INTERVAL 16u
+
+typedef struct {
+	uint16_t fields[NUM_FRAMES][NUM_FIELDS];
+	unsigned received;
+	unsigned mismatches;
+	unsigned events;
+} expect_t;
+
+static expect_t expect;
+
+static void expect_reset(void)
+{
+	expect.received   = 0u;
+	expect.mismatches = 0u;
+	expect.events     = 0u;
+}
+
+/* the timestamp field carries the frame index */
+static void on_frame(const ds_frame_t *f, void *ctx)
+{
+	const uint16_t *e = expect.fields[f->timestamp];
+
+	(void)ctx;
+	expect.received++;
+	if (f->num_channels != NUM_CHANNELS || f->channel[0].signal != e[1 + DS_FIELD_SIGNAL]
+	    || f->channel[0].reference != e[1 + DS_FIELD_REFERENCE]
+	    || (uint16_t)f->channel[0].delta != e[1 + DS_FIELD_DELTA]
+	    || f->channel[0].threshold != e[1 + DS_FIELD_THRESHOLD]
+	    || f->channel[0].comp_cap != e[1 + DS_FIELD_COMP_CAP] || f->channel[0].state != e[1 + DS_FIELD_STATE]
+	    || f->channel[0].key_threshold != e[1 + DS_FIELD_KEY_THRESHOLD] || f->error_code != e[NUM_FIELDS - 1u]) {
+		expect.mismatches++;
+	}
+	if (f->flags & DS_FLAG_EVENT) {
+		expect.events++;
+	}
+}
+
+/* Encodes NUM_FRAMES frames of a drifting signal, returns the stream size */
+static size_t encode_stream(uint8_t *out)
+{
+	ds_encoder_t enc;
+	uint16_t     prev[NUM_FIELDS];
+	uint16_t     signal = 500u;
+	size_t       len    = 0u;
+	unsigned     i;
+
+	ds_encoder_init(&enc, prev, NUM_FIELDS, KEYFRAME_INTERVAL);
+	for (i = 0u; i < NUM_FRAMES; i++) {
+		uint16_t *f = expect.fields[i];
+
+		signal = (uint16_t)(signal + rand() % 21 - 10);
+		f[0]   = (uint16_t)i;
+		f[1 + DS_FIELD_SIGNAL]        = signal;
+		f[1 + DS_FIELD_REFERENCE]     = 480u;
+		f[1 + DS_FIELD_DELTA]         = (uint16_t)(int16_t)(rand() % 200 - 100);
+		f[1 + DS_FIELD_THRESHOLD]     = 50u;
+		f[1 + DS_FIELD_COMP_CAP]      = 0x1234u;
+		f[1 + DS_FIELD_STATE]         = (rand() & 1) ? 0x80u : 0u;
+		f[1 + DS_FIELD_KEY_THRESHOLD] = 100u;
+		f[NUM_FIELDS - 1u]            = 0u;
+		len += ds_frame_encode(&enc, &out[len], f, NUM_CHANNELS, DS_FLAG_TIMESTAMP | (i % 100u ? 0u : DS_FLAG_EVENT),
+		                       3u);
+	}
+	return len;
+}
+
+static void test_round_trip(const uint8_t *stream, size_t len)
+{
+	ds_decoder_t dec;
+
+	expect_reset();
+	ds_decoder_init(&dec);
+	ds_decoder_feed(&dec, stream, len, on_frame, NULL);
+
+	CHECK_EQ(expect.received, NUM_FRAMES);
+	CHECK_EQ(expect.mismatches, 0);
+	CHECK_EQ(expect.events, NUM_FRAMES / 100u);
+	CHECK_EQ(dec.stats.keyframes, NUM_FRAMES / KEYFRAME_INTERVAL);
+	CHECK_EQ(dec.stats.crc_errors, 0);
+	CHECK_EQ(dec.stats.skipped_bytes, 0);
+}
+
+static void test_split_feed(const uint8_t *stream, size_t len)
+{
+	ds_decoder_t dec;
+	size_t       pos, n;
+
+	expect_reset();
+	ds_decoder_init(&dec);
+	for (pos = 0u; pos < len; pos += n) {
+		n = 1u + (size_t)rand() % 37u;
+		if (pos + n > len) {
+			n = len - pos;
+		}
+		ds_decoder_feed(&dec, &stream[pos], n, on_frame, NULL);
+	}
+
+	CHECK_EQ(expect.received, NUM_FRAMES);
+	CHECK_EQ(expect.mismatches, 0);
+	CHECK_EQ(dec.stats.bytes, len);
+}
+
+static void test_corruption(uint8_t *stream, size_t len)
+{
+	ds_decoder_t dec;
+	size_t       pos;
+	unsigned     flipped = 0u;
+
+	/* one flipped bit every 997 bytes */
+	for (pos = 500u; pos < len; pos += 997u) {
+		stream[pos] ^= (uint8_t)(1u << (rand() % 8));
+		flipped++;
+	}
+
+	expect_reset();
+	ds_decoder_init(&dec);
+	ds_decoder_feed(&dec, stream, len, on_frame, NULL);
+
+	/* a corrupted frame costs at most the frames up to the next keyframe */
+	CHECK_EQ(expect.mismatches, 0);
+	CHECK(expect.received < NUM_FRAMES);
+	CHECK(expect.received + flipped * KEYFRAME_INTERVAL >= NUM_FRAMES);
+	/* a flipped SOF byte only shows as skipped bytes */
+	CHECK(dec.stats.crc_errors > 0u);
+	CHECK(dec.stats.skipped_bytes > 0u);
+}
+
+static void test_crc(void)
+{
+	/* CRC-16/CCITT-FALSE check value */
+	static const char check[] = "123456789";
+	uint16_t          crc     = DS_CRC16_INIT;
+	unsigned          i;
+
+	for (i = 0u; i < sizeof(check) - 1u; i++) {
+		crc = ds_crc16_update(crc, (uint8_t)check[i]);
+	}
+	CHECK_EQ(crc, 0x29B1);
+}
+
+int main(void)
+{
+	static uint8_t stream[NUM_FRAMES * (DS_FRAME_LEN_MAX(NUM_FIELDS) + DS_FRAME_OVERHEAD)];
+	size_t         len;
+
+	srand(1);
+	test_crc();
+	len = encode_stream(stream);
+	test_round_trip(stream, len);
+	test_split_feed(stream, len);
+	test_corruption(stream, len);
+
+	return test_result("test_datastreamer_frame");
+}
@@ -0,0 +1,130 @@
+/*============================================================================
+Filename : test_fusion.c
+Project : Attiny814Code host tests
+Purpose : Fusion of the edges with the key state (TOUCH_FUSION in
+          touch_detect.h), built once per fusion mode.
+============================================================================*/
+
+#include "test.h"
+#include "gesture.h"
+#include "touch_detect.h"
+
+#define REFERENCE 400u
+#define TOUCH 650u
+#define TICKS(MS) ((MS) / RTC_WAKE_UP_TIME)
+
+/*----------------------------------------------------------------------------
+ *     helpers
+ *----------------------------------------------------------------------------*/
+/* gesture of the last sample */
+static uint8_t gesture;
+
+/* Measurement with the given key state after one RTC tick, as main.c runs
+ * it, returns the result; the edge goes to *edge */
+static uint8_t sample(uint16_t signal, uint8_t key, uint8_t *edge)
+{
+	uint8_t result;
+
+	touch_detect_tick();
+	gesture_tick();
+	touch_detect_key(key);
+	result  = touch_detect_sample(signal, REFERENCE, edge);
+	gesture = gesture_sample(*edge, result, touch_detect_held());
+	return result;
+}
+
+/* Touch of the given number of ticks, the key in the given state while the
+ * finger is on; returns the result of the release */
+static uint8_t touch(uint8_t key, unsigned ticks)
+{
+	uint8_t edge;
+
+	CHECK_EQ(sample(TOUCH, key, &edge), TOUCH_NONE);
+	while (--ticks) {
+		CHECK_EQ(sample(TOUCH, key, &edge), TOUCH_NONE);
+	}
+	return sample(REFERENCE, KEY_QUIET, &edge);
+}
+
+/*----------------------------------------------------------------------------
+ *     tests
+ *----------------------------------------------------------------------------*/
+static void test_key_detect(void)
+{
+	/* a touch the key sees as well counts in every mode */
+	touch_detect_reset();
+	CHECK_EQ(touch(KEY_DETECT, TICKS(200u)), TOUCH_VALID);
+	CHECK_EQ(SensorState, FINGER_ON_DETECT);
+}
+
+#if TOUCH_FUSION == TOUCH_FUSION_GATE
+static void test_gate(void)
+{
+	uint8_t  edge;
+	uint16_t threshold;
+
+	/* no rising edge without the key */
+	touch_detect_reset();
+	CHECK_EQ(sample(TOUCH, KEY_QUIET, &edge), TOUCH_NONE);
+	CHECK_EQ(edge, EDGE_NONE);
+	CHECK_EQ(SensorState, FINGER_ON_DETECT);
+
+	/* the filter followed the delta: no falling edge either */
+	CHECK_EQ(sample(REFERENCE, KEY_QUIET, &edge), TOUCH_NONE);
+	CHECK_EQ(edge, EDGE_NONE);
+
+	/* the noise estimate holds while the key is quiet */
+	threshold = STRONG_EDGE_THRESHOLD;
+	CHECK_EQ(sample(REFERENCE + 30u, KEY_QUIET, &edge), TOUCH_NONE);
+	CHECK_EQ(sample(REFERENCE, KEY_QUIET, &edge), TOUCH_NONE);
+	CHECK_EQ(STRONG_EDGE_THRESHOLD, threshold);
+
+	/* filter-in is enough for the edge */
+	CHECK_EQ(touch(KEY_FILTER_IN, TICKS(200u)), TOUCH_VALID);
+}
+#endif
+
+#if TOUCH_FUSION == TOUCH_FUSION_CONFIRM
+static void test_confirm(void)
+{
+	/* the edges alone are a false touch */
+	touch_detect_reset();
+	CHECK_EQ(touch(KEY_QUIET, TICKS(200u)), TOUCH_FALSE);
+	CHECK_EQ(touch(KEY_FILTER_IN, TICKS(200u)), TOUCH_FALSE);
+
+	/* detect while the finger is on confirms it, once */
+	CHECK_EQ(touch(KEY_DETECT, TICKS(200u)), TOUCH_VALID);
+	CHECK_EQ(touch(KEY_QUIET, TICKS(200u)), TOUCH_FALSE);
+
+	/* still a false touch when too short */
+	CHECK_EQ(touch(KEY_DETECT, TICKS(fingerOnMinTime) - 1u), TOUCH_FALSE);
+}
+
+static void test_confirm_gesture(void)
+{
+	/* taps at the release; only a confirmed touch drives the valve */
+	touch_detect_reset();
+	gesture_reset();
+	doubleTapWindow = 0u;
+	CHECK_EQ(touch(KEY_QUIET, TICKS(200u)), TOUCH_FALSE);
+	CHECK_EQ(gesture, GESTURE_NONE);
+	CHECK_EQ(touch(KEY_FILTER_IN, TICKS(200u)), TOUCH_FALSE);
+	CHECK_EQ(gesture, GESTURE_NONE);
+	CHECK_EQ(touch(KEY_DETECT, TICKS(200u)), TOUCH_VALID);
+	CHECK_EQ(gesture, GESTURE_TAP);
+	doubleTapWindow = 250u;
+}
+#endif
+
+int main(void)
+{
+	test_key_detect();
+#if TOUCH_FUSION == TOUCH_FUSION_GATE
+	test_gate();
+#endif
+#if TOUCH_FUSION == TOUCH_FUSION_CONFIRM
+	test_confirm();
+	test_confirm_gesture();
+#endif
+	return test_result("test_fusion");
+}
@@ -0,0 +1,182 @@
+/*============================================================================
+Filename : test_gesture.c
+Project : Attiny814Code host tests
+Purpose : Tap, double-tap and long-press recognition of the gesture engine
+          (src/gesture.c) and the latency of a single tap.
+============================================================================*/
+
+#include "test.h"
+#include "gesture.h"
+#include "touch_detect.h"
+
+#define TICKS(MS) ((MS) / RTC_WAKE_UP_TIME)
+
+/*----------------------------------------------------------------------------
+ *     helpers
+ *----------------------------------------------------------------------------*/
+/* finger held behind a press, touch_detect_held() */
+static uint8_t held = 1u;
+
+/* Measurement with its edge and result after the given number of RTC
+ * ticks */
+static uint8_t sample_result(uint8_t edge, uint8_t result, unsigned ticks)
+{
+	while (ticks--) {
+		gesture_tick();
+	}
+	return gesture_sample(edge, result, held);
+}
+
+/* Measurement with its edge, a valid touch at a release */
+static uint8_t sample(uint8_t edge, unsigned ticks)
+{
+	return sample_result(edge, edge == EDGE_FALLING ? TOUCH_VALID : TOUCH_NONE, ticks);
+}
+
+/* Press held for the given number of ticks, returns the gesture of the
+ * release */
+static uint8_t press(unsigned ticks)
+{
+	CHECK_EQ(sample(EDGE_RISING, 1u), GESTURE_NONE);
+	return sample(EDGE_FALLING, ticks);
+}
+
+/* Quiet samples until a gesture or the limit, returns the gesture; the
+ * ticks waited go to *waited */
+static uint8_t wait(unsigned limit, unsigned *waited)
+{
+	uint8_t gesture = GESTURE_NONE;
+
+	for (*waited = 0u; *waited < limit && gesture == GESTURE_NONE; (*waited)++) {
+		gesture = sample(EDGE_NONE, 1u);
+	}
+	return gesture;
+}
+
+/*----------------------------------------------------------------------------
+ *     tests
+ *----------------------------------------------------------------------------*/
+static void test_tap(void)
+{
+	unsigned waited;
+
+	/* reported once the window has passed without a second press */
+	gesture_reset();
+	CHECK_EQ(press(TICKS(200u)), GESTURE_NONE);
+	CHECK_EQ(wait(100u, &waited), GESTURE_TAP);
+	CHECK_EQ(waited, TICKS(doubleTapWindow));
+	CHECK_EQ(wait(100u, &waited), GESTURE_NONE);
+
+	/* at the release without double-taps, as the touch state machine */
+	doubleTapWindow = 0u;
+	CHECK_EQ(press(TICKS(200u)), GESTURE_TAP);
+	doubleTapWindow = 250u;
+
+	/* too short, too long */
+	CHECK_EQ(press(TICKS(fingerOnMinTime) - 1u), GESTURE_NONE);
+	CHECK_EQ(press(TICKS(fingerOnMaxTime)), GESTURE_NONE);
+	CHECK_EQ(wait(100u, &waited), GESTURE_NONE);
+
+	/* a false touch of the touch state machine */
+	CHECK_EQ(sample(EDGE_RISING, 1u), GESTURE_NONE);
+	CHECK_EQ(sample_result(EDGE_FALLING, TOUCH_FALSE, TICKS(200u)), GESTURE_NONE);
+	CHECK_EQ(wait(100u, &waited), GESTURE_NONE);
+}
+
+static void test_double_tap(void)
+{
+	unsigned waited;
+
+	gesture_reset();
+	CHECK_EQ(press(TICKS(200u)), GESTURE_NONE);
+	CHECK_EQ(sample(EDGE_NONE, TICKS(doubleTapWindow) - 1u), GESTURE_NONE);
+	CHECK_EQ(press(TICKS(200u)), GESTURE_DOUBLE_TAP);
+	CHECK_EQ(wait(100u, &waited), GESTURE_NONE);
+
+	/* a second press that is no tap leaves the first one */
+	CHECK_EQ(press(TICKS(200u)), GESTURE_NONE);
+	CHECK_EQ(press(TICKS(fingerOnMinTime) - 1u), GESTURE_TAP);
+	CHECK_EQ(press(TICKS(200u)), GESTURE_NONE);
+	CHECK_EQ(sample(EDGE_RISING, 1u), GESTURE_NONE);
+	CHECK_EQ(wait(100u, &waited), GESTURE_TAP);
+	CHECK_EQ(waited, TICKS(fingerOnMaxTime));
+	CHECK_EQ(sample(EDGE_FALLING, 1u), GESTURE_NONE);
+}
+
+static void test_long_press(void)
+{
+	unsigned waited;
+
+	/* reported while the finger is on, the release is no tap */
+	gesture_reset();
+	CHECK_EQ(sample(EDGE_RISING, 1u), GESTURE_NONE);
+	CHECK_EQ(wait(200u, &waited), GESTURE_LONG_PRESS);
+	CHECK_EQ(waited, TICKS(longPressTime));
+	CHECK_EQ(sample(EDGE_FALLING, 10u), GESTURE_NONE);
+	CHECK_EQ(wait(100u, &waited), GESTURE_NONE);
+
+	/* a lost release ends the hold when the tick count saturates */
+	CHECK_EQ(sample(EDGE_RISING, 1u), GESTURE_NONE);
+	CHECK_EQ(wait(200u, &waited), GESTURE_LONG_PRESS);
+	CHECK_EQ(sample(EDGE_NONE, GESTURE_TICKS_MAX), GESTURE_NONE);
+	CHECK_EQ(press(TICKS(200u)), GESTURE_NONE);
+	CHECK_EQ(wait(100u, &waited), GESTURE_TAP);
+
+	/* off */
+	longPressTime = 0u;
+	CHECK_EQ(sample(EDGE_RISING, 1u), GESTURE_NONE);
+	CHECK_EQ(wait(GESTURE_TICKS_MAX, &waited), GESTURE_NONE);
+	longPressTime = 1500u;
+}
+
+static void test_no_hold(void)
+{
+	unsigned waited;
+
+	/* a rising edge without a finger behind it, a water drop: dropped at
+	 * fingerOnMaxTime, no long-press */
+	gesture_reset();
+	held = 0u;
+	CHECK_EQ(sample(EDGE_RISING, 1u), GESTURE_NONE);
+	CHECK_EQ(wait(200u, &waited), GESTURE_NONE);
+	CHECK_EQ(press(TICKS(200u)), GESTURE_NONE);
+	CHECK_EQ(wait(100u, &waited), GESTURE_TAP);
+
+	/* a first tap still stands */
+	CHECK_EQ(press(TICKS(200u)), GESTURE_NONE);
+	CHECK_EQ(sample(EDGE_RISING, 1u), GESTURE_NONE);
+	CHECK_EQ(wait(100u, &waited), GESTURE_TAP);
+	CHECK_EQ(waited, TICKS(fingerOnMaxTime));
+	held = 1u;
+}
+
+static void test_clamp(void)
+{
+	unsigned waited;
+
+	/* longer than the tick counter: the saturated count still ends it */
+	gesture_reset();
+	fingerOnMaxTime = 10000u;
+	CHECK_EQ(press(TICKS(200u)), GESTURE_NONE);
+	CHECK_EQ(sample(EDGE_RISING, 1u), GESTURE_NONE);
+	CHECK_EQ(wait(2u * GESTURE_TICKS_MAX, &waited), GESTURE_TAP);
+	CHECK_EQ(waited, GESTURE_TICKS_MAX);
+	fingerOnMaxTime = 500u;
+
+	longPressTime = 10000u;
+	CHECK_EQ(sample(EDGE_RISING, 1u), GESTURE_NONE);
+	CHECK_EQ(wait(2u * GESTURE_TICKS_MAX, &waited), GESTURE_LONG_PRESS);
+	CHECK_EQ(waited, GESTURE_TICKS_MAX);
+	CHECK_EQ(sample(EDGE_FALLING, 1u), GESTURE_NONE);
+	longPressTime = 1500u;
+}
+
+int main(void)
+{
+	test_tap();
+	test_double_tap();
+	test_long_press();
+	test_no_hold();
+	test_clamp();
+	return test_result("test_gesture");
+}
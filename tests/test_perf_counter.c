@@ -0,0 +1,68 @@
+/*============================================================================
+Filename : test_perf_counter.c
+Project : Attiny814Code host tests
+Purpose : Saturation, snapshot and reset handling of the event counter
+          registry (src/perf_counter.c).
+============================================================================*/
+
+#include "perf_counter.h"
+#include "test.h"
+
+static void test_count(void)
+{
+	uint16_t counters[PERF_COUNT];
+	unsigned i;
+
+	perf_init(1u);
+	perf_snapshot(counters);
+	for (i = 0u; i < PERF_COUNT; i++) {
+		CHECK_EQ(counters[i], 0);
+	}
+
+	perf_count(PERF_WAKES);
+	perf_count(PERF_WAKES);
+	perf_count(PERF_DS_FRAMES);
+	perf_snapshot(counters);
+	CHECK_EQ(counters[PERF_WAKES], 2);
+	CHECK_EQ(counters[PERF_DS_FRAMES], 1);
+	CHECK_EQ(counters[PERF_ACQUISITIONS], 0);
+}
+
+static void test_saturation(void)
+{
+	uint16_t counters[PERF_COUNT];
+	unsigned i;
+
+	perf_init(1u);
+	for (i = 0u; i < PERF_COUNTER_MAX + 10u; i++) {
+		perf_count(PERF_EDGES_RISING);
+	}
+	perf_snapshot(counters);
+	CHECK_EQ(counters[PERF_EDGES_RISING], PERF_COUNTER_MAX);
+	CHECK_EQ(counters[PERF_EDGES_FALLING], 0);
+}
+
+static void test_reset(void)
+{
+	uint16_t counters[PERF_COUNT];
+
+	/* kept over a warm reset, cleared by a power cycle */
+	perf_init(1u);
+	perf_count(PERF_WDT_RESETS);
+	perf_init(0u);
+	perf_count(PERF_WDT_RESETS);
+	perf_snapshot(counters);
+	CHECK_EQ(counters[PERF_WDT_RESETS], 2);
+
+	perf_init(1u);
+	perf_snapshot(counters);
+	CHECK_EQ(counters[PERF_WDT_RESETS], 0);
+}
+
+int main(void)
+{
+	test_count();
+	test_saturation();
+	test_reset();
+	return test_result("test_perf_counter");
+}
@@ -0,0 +1,223 @@
+/*============================================================================
+Filename : test_touch_detect.c
+Project : Attiny814Code host tests
+Purpose : Touch window, delta saturation, threshold limits, noise estimate,
+          valve blanking and reference tracking of the touch detection core
+          (src/touch_detect.c).
+============================================================================*/
+
+#include "test.h"
+#include "touch_detect.h"
+
+#define REFERENCE 400u
+#define TOUCH 650u
+
+/*----------------------------------------------------------------------------
+ *     helpers
+ *----------------------------------------------------------------------------*/
+static uint8_t sample(uint16_t signal, unsigned ticks)
+{
+	uint8_t edge;
+
+	while (ticks--) {
+		touch_detect_tick();
+	}
+	return touch_detect_sample(signal, REFERENCE, &edge);
+}
+
+/* Finger on for the given number of RTC ticks, returns the result of the
+ * release */
+static uint8_t touch(unsigned ticks)
+{
+	CHECK_EQ(sample(TOUCH, 0u), TOUCH_NONE);
+	CHECK_EQ(SensorState, FINGER_OFF_DETECT);
+	return sample(REFERENCE, ticks);
+}
+
+/* Measurement against the tracked reference, returns the edge */
+static uint8_t tracked(uint16_t signal)
+{
+	uint8_t edge;
+
+	touch_detect_baseline(signal);
+	touch_detect_sample(signal, baselineValue, &edge);
+	return edge;
+}
+
+/*----------------------------------------------------------------------------
+ *     tests
+ *----------------------------------------------------------------------------*/
+static void test_touch_window(void)
+{
+	touch_detect_reset();
+	CHECK_EQ(sample(REFERENCE, 0u), TOUCH_NONE);
+
+	CHECK_EQ(touch(FINGER_ON_MINIMUM_TIME_MS(fingerOnMinTime)), TOUCH_VALID);
+	CHECK_EQ(SensorState, FINGER_ON_DETECT);
+	CHECK_EQ(touch(FINGER_ON_MINIMUM_TIME_MS(fingerOnMinTime) - 1u), TOUCH_FALSE);
+
+	/* a finger held too long is dropped at the next sample */
+	CHECK_EQ(sample(TOUCH, 0u), TOUCH_NONE);
+	CHECK_EQ(sample(TOUCH, FINGER_ON_MAXIMUM_TIME_MS(fingerOnMaxTime)), TOUCH_FALSE);
+	CHECK_EQ(sample(REFERENCE, 1u), TOUCH_NONE);
+	CHECK_EQ(SensorState, FINGER_ON_DETECT);
+}
+
+static void test_delta_saturation(void)
+{
+	uint8_t edge;
+
+	CHECK_EQ(touch_detect_delta(0xFFFFu, 0u), TOUCH_DELTA_LIMIT);
+	CHECK_EQ(touch_detect_delta(0u, 0xFFFFu), -TOUCH_DELTA_LIMIT);
+	CHECK_EQ(touch_detect_delta(500u, 400u), 100);
+
+	/* a jump from the top to the bottom is a falling edge, not a wrapped
+	 * rising one */
+	touch_detect_reset();
+	touch_detect_sample(40000u, 0u, &edge);
+	touch_detect_sample(0u, 40000u, &edge);
+	CHECK_EQ(edge, EDGE_FALLING);
+}
+
+static void test_threshold_limits(void)
+{
+	unsigned i;
+
+	touch_detect_reset();
+	edgeThresholdMin = 35u;
+	edgeThresholdMax = 80u;
+	for (i = 0u; i < 1000u; i++) {
+		sample(REFERENCE, 0u);
+	}
+	CHECK_EQ(STRONG_EDGE_THRESHOLD, 35u);
+	CHECK_EQ(noiseLevel, 0u);
+
+	/* crossed limits: the maximum wins */
+	edgeThresholdMin = 60u;
+	edgeThresholdMax = 40u;
+	sample(REFERENCE, 0u);
+	CHECK_EQ(STRONG_EDGE_THRESHOLD, 40u);
+
+	edgeThresholdMin = 35u;
+	edgeThresholdMax = 80u;
+}
+
+static void test_noise_convergence(void)
+{
+	unsigned i;
+
+	/* +-10 counts of noise: the estimate attacks within a few samples,
+	 * ahead of the noise, the threshold ends at the maximum */
+	touch_detect_reset();
+	for (i = 0u; i < 32u; i++) {
+		sample(i & 1u ? REFERENCE + 10u : REFERENCE - 10u, 0u);
+		CHECK_EQ(SensorState, FINGER_ON_DETECT);
+	}
+	CHECK_EQ(STRONG_EDGE_THRESHOLD, 80u);
+	CHECK(noiseLevel >= (18u << NOISE_LEVEL_FRAC));
+
+	/* and releases within a few time constants once it is quiet */
+	for (i = 0u; i < 4u << noiseReleaseShift; i++) {
+		sample(REFERENCE, 0u);
+	}
+	CHECK_EQ(STRONG_EDGE_THRESHOLD, 35u);
+
+	/* a touch edge moves the estimate by less than the threshold */
+	CHECK_EQ(touch(FINGER_ON_MINIMUM_TIME_MS(fingerOnMinTime)), TOUCH_VALID);
+	CHECK((unsigned)(noiseLevel * noiseFactor) >> NOISE_LEVEL_FRAC < 35u);
+}
+
+static void test_valve_blanking(void)
+{
+	int16_t disturbance = 200;
+	unsigned i;
+
+	touch_detect_reset();
+	sample(REFERENCE, 0u);
+	touch_detect_freeze();
+
+	/* the onset is all disturbance */
+	CHECK_EQ(sample(REFERENCE + disturbance, 1u), TOUCH_NONE);
+	CHECK_EQ(SensorState, FINGER_ON_DETECT);
+
+	/* a tap on the decaying disturbance still counts */
+	for (i = 0u; i <= FINGER_ON_MINIMUM_TIME_MS(fingerOnMinTime); i++) {
+		disturbance -= disturbance >> TOUCH_BLANK_DECAY_SHIFT;
+		CHECK_EQ(sample(TOUCH + disturbance, 1u), TOUCH_NONE);
+		CHECK_EQ(SensorState, FINGER_OFF_DETECT);
+	}
+	disturbance -= disturbance >> TOUCH_BLANK_DECAY_SHIFT;
+	CHECK_EQ(sample(REFERENCE + disturbance, 1u), TOUCH_VALID);
+	CHECK_EQ(edgeDetectFreeze, 1u);
+
+	/* the blanking ends once the disturbance is below the threshold,
+	 * ahead of freezeTime and without an edge */
+	while (disturbance >= (int16_t)STRONG_EDGE_THRESHOLD) {
+		CHECK_EQ(edgeDetectFreeze, 1u);
+		disturbance -= disturbance >> TOUCH_BLANK_DECAY_SHIFT;
+		CHECK_EQ(sample(REFERENCE + disturbance, 1u), TOUCH_NONE);
+		CHECK_EQ(SensorState, FINGER_ON_DETECT);
+	}
+	CHECK_EQ(edgeDetectFreeze, 0u);
+	CHECK(edgeFreezeCnt == 0u);
+	CHECK_EQ(sample(REFERENCE, 1u), TOUCH_NONE);
+	CHECK_EQ(SensorState, FINGER_ON_DETECT);
+}
+
+static void test_baseline(void)
+{
+	unsigned i;
+
+	touch_detect_reset();
+	CHECK_EQ(tracked(REFERENCE), EDGE_NONE);
+	CHECK_EQ(baselineValue, REFERENCE);
+
+	/* one count per drift time towards the signal, each way */
+	for (i = 1u; i < TOUCH_BASELINE_DRIFT_UP_MS / RTC_WAKE_UP_TIME; i++) {
+		CHECK_EQ(tracked(REFERENCE + 20u), EDGE_NONE);
+	}
+	CHECK_EQ(baselineValue, REFERENCE);
+	CHECK_EQ(tracked(REFERENCE + 20u), EDGE_NONE);
+	CHECK_EQ(baselineValue, REFERENCE + 1u);
+	for (i = 0u; i < TOUCH_BASELINE_DRIFT_DOWN_MS / RTC_WAKE_UP_TIME; i++) {
+		CHECK_EQ(tracked(REFERENCE), EDGE_NONE);
+	}
+	CHECK_EQ(baselineValue, REFERENCE);
+
+	/* held while the finger is on and for the hold time after */
+	CHECK_EQ(tracked(TOUCH), EDGE_RISING);
+	for (i = 0u; i < 200u; i++) {
+		tracked(TOUCH);
+	}
+	CHECK_EQ(baselineValue, REFERENCE);
+	CHECK_EQ(tracked(REFERENCE + 20u), EDGE_FALLING);
+	for (i = 0u; i < TOUCH_BASELINE_HOLD_MS / RTC_WAKE_UP_TIME; i++) {
+		tracked(REFERENCE + 20u);
+	}
+	CHECK_EQ(baselineValue, REFERENCE);
+
+	/* calibrated with the finger on: the reference drops to the signal,
+	 * without an edge */
+	touch_detect_reset();
+	CHECK_EQ(tracked(TOUCH), EDGE_NONE);
+	CHECK_EQ(tracked(REFERENCE), EDGE_FALLING);
+	for (i = 2u; i < TOUCH_BASELINE_RECAL_SAMPLES; i++) {
+		CHECK_EQ(tracked(REFERENCE), EDGE_NONE);
+	}
+	CHECK_EQ(baselineValue, TOUCH);
+	CHECK_EQ(tracked(REFERENCE), EDGE_NONE);
+	CHECK_EQ(baselineValue, REFERENCE);
+	CHECK_EQ(tracked(REFERENCE), EDGE_NONE);
+	CHECK_EQ(SensorState, FINGER_ON_DETECT);
+}
+
+int main(void)
+{
+	test_touch_window();
+	test_delta_saturation();
+	test_threshold_limits();
+	test_noise_convergence();
+	test_valve_blanking();
+	test_baseline();
+	return test_result("test_touch_detect");
+}
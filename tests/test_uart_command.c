@@ -0,0 +1,279 @@
+/*============================================================================
+Filename : test_uart_command.c
+Project : Attiny814Code host tests
+Purpose : Request framing, parameter access and receive timeout of the UART
+          command channel (src/uart_command.c).
+============================================================================*/
+
+#include <string.h>
+
+#include "datastreamer_frame.h"
+#include "perf_counter.h"
+#include "test.h"
+#include "uart_command.h"
+
+/*----------------------------------------------------------------------------
+ *     application side of the command channel
+ *----------------------------------------------------------------------------*/
+static uint16_t word_param = 50u;
+static uint8_t  byte_param = 3u;
+static unsigned recalibrations;
+
+static uint8_t tx[64];
+static unsigned tx_len;
+
+const cmd_param_t cmd_param_table[PARAM_COUNT] = {
+    [0] = {&word_param, 2, 10, 1000},
+    [1] = {&byte_param, 1, 1, 8},
+    [2] = {&word_param, 2, 0, 0xFFFF, 1},
+    [3] = {&word_param, 2, 0, 0xFFFF},
+    [4] = {&word_param, 2, 0, 0xFFFF},
+    [5] = {&word_param, 2, 0, 0xFFFF},
+    [6] = {&word_param, 2, 0, 0xFFFF},
+    [7] = {&word_param, 2, 0, 0xFFFF},
+    [8] = {&word_param, 2, 0, 0xFFFF},
+    [9] = {&word_param, 2, 0, 0xFFFF},
+    [10] = {&word_param, 2, 0, 0xFFFF},
+    [11] = {&word_param, 2, 0, 0xFFFF},
+    [12] = {&word_param, 2, 0, 0xFFFF},
+    [13] = {NULL, 2, 0, 0xFFFF}, /* not in this build */
+};
+
+void cmd_tx_byte(uint8_t data)
+{
+	if (tx_len < sizeof(tx)) {
+		tx[tx_len] = data;
+	}
+	tx_len++;
+}
+
+void cmd_recalibrate(void)
+{
+	recalibrations++;
+}
+
+uint8_t cmd_read_counters(uint16_t *counters, uint8_t max_counters)
+{
+	CHECK(max_counters >= 2u);
+	counters[0] = 0x1234u;
+	counters[1] = 7u;
+	return 2u;
+}
+
+/*----------------------------------------------------------------------------
+ *     helpers
+ *----------------------------------------------------------------------------*/
+static uint16_t crc16(const uint8_t *data, unsigned len)
+{
+	uint16_t crc = DS_CRC16_INIT;
+
+	while (len--) {
+		crc = ds_crc16_update(crc, *data++);
+	}
+	return crc;
+}
+
+/* Sends a request through the receiver, returns 1 if it was executed */
+static int request(uint8_t cmd, const uint8_t *payload, uint8_t len)
+{
+	uint8_t  frame[CMD_MAX_LEN + 4u];
+	uint16_t crc;
+	unsigned i;
+
+	frame[0] = CMD_REQUEST_SOF;
+	frame[1] = (uint8_t)(len + 1u);
+	frame[2] = cmd;
+	memcpy(&frame[3], payload, len);
+	crc            = crc16(&frame[1], len + 2u);
+	frame[len + 3] = (uint8_t)crc;
+	frame[len + 4] = (uint8_t)(crc >> 8);
+
+	tx_len = 0u;
+	for (i = 0u; i < len + 5u; i++) {
+		cmd_rx_byte(frame[i]);
+	}
+	return cmd_process();
+}
+
+/* Checks the framing of the captured response, returns its status */
+static int response_status(uint8_t cmd)
+{
+	uint16_t crc;
+
+	CHECK(tx_len >= 6u);
+	CHECK_EQ(tx[0], CMD_RESPONSE_SOF);
+	CHECK_EQ(tx[1] + 4u, tx_len);
+	CHECK_EQ(tx[2], cmd | CMD_RESPONSE_FLAG);
+	crc = crc16(&tx[1], tx_len - 3u);
+	CHECK_EQ(tx[tx_len - 2u], (uint8_t)crc);
+	CHECK_EQ(tx[tx_len - 1u], (uint8_t)(crc >> 8));
+	return tx[3];
+}
+
+static unsigned response_u16(unsigned index)
+{
+	return tx[4u + 2u * index] | ((unsigned)tx[5u + 2u * index] << 8);
+}
+
+/*----------------------------------------------------------------------------
+ *     tests
+ *----------------------------------------------------------------------------*/
+static void test_ping(void)
+{
+	CHECK(request(CMD_PING, NULL, 0u));
+	CHECK_EQ(response_status(CMD_PING), CMD_STATUS_OK);
+	CHECK_EQ(tx[4], CMD_PROTOCOL_VERSION);
+	CHECK_EQ(tx[5], PARAM_COUNT);
+}
+
+static void test_params(void)
+{
+	uint8_t req[3];
+
+	req[0] = 0u;
+	CHECK(request(CMD_PARAM_READ, req, 1u));
+	CHECK_EQ(response_status(CMD_PARAM_READ), CMD_STATUS_OK);
+	CHECK_EQ(response_u16(0), 50);
+
+	req[1] = 0x2Cu;
+	req[2] = 0x01u;
+	CHECK(request(CMD_PARAM_WRITE, req, 3u));
+	CHECK_EQ(response_status(CMD_PARAM_WRITE), CMD_STATUS_OK);
+	CHECK_EQ(response_u16(0), 300);
+	CHECK_EQ(word_param, 300);
+
+	/* out of the table bounds */
+	req[1] = 5u;
+	req[2] = 0u;
+	CHECK(request(CMD_PARAM_WRITE, req, 3u));
+	CHECK_EQ(response_status(CMD_PARAM_WRITE), CMD_STATUS_OUT_OF_RANGE);
+	CHECK_EQ(word_param, 300);
+
+	/* byte sized parameter */
+	req[0] = 1u;
+	req[1] = 8u;
+	CHECK(request(CMD_PARAM_WRITE, req, 3u));
+	CHECK_EQ(response_status(CMD_PARAM_WRITE), CMD_STATUS_OK);
+	CHECK_EQ(byte_param, 8);
+
+	/* read-only parameter: readable, writes rejected */
+	req[0] = 2u;
+	CHECK(request(CMD_PARAM_READ, req, 1u));
+	CHECK_EQ(response_status(CMD_PARAM_READ), CMD_STATUS_OK);
+	CHECK_EQ(response_u16(0), 300);
+	req[1] = 0x10u;
+	req[2] = 0x00u;
+	CHECK(request(CMD_PARAM_WRITE, req, 3u));
+	CHECK_EQ(response_status(CMD_PARAM_WRITE), CMD_STATUS_READ_ONLY);
+	CHECK_EQ(word_param, 300);
+
+	req[0] = PARAM_COUNT;
+	CHECK(request(CMD_PARAM_READ, req, 1u));
+	CHECK_EQ(response_status(CMD_PARAM_READ), CMD_STATUS_BAD_PARAM);
+
+	/* an entry without a variable */
+	req[0] = 13u;
+	CHECK(request(CMD_PARAM_READ, req, 1u));
+	CHECK_EQ(response_status(CMD_PARAM_READ), CMD_STATUS_BAD_PARAM);
+	CHECK(request(CMD_PARAM_WRITE, req, 3u));
+	CHECK_EQ(response_status(CMD_PARAM_WRITE), CMD_STATUS_BAD_PARAM);
+	req[0] = PARAM_COUNT;
+
+	CHECK(request(CMD_PARAM_READ, req, 2u));
+	CHECK_EQ(response_status(CMD_PARAM_READ), CMD_STATUS_BAD_LENGTH);
+
+	CHECK(request(0x7Fu, NULL, 0u));
+	CHECK_EQ(response_status(0x7Fu), CMD_STATUS_UNKNOWN_CMD);
+}
+
+static void test_recalibrate_and_counters(void)
+{
+	CHECK(request(CMD_RECALIBRATE, NULL, 0u));
+	CHECK_EQ(response_status(CMD_RECALIBRATE), CMD_STATUS_OK);
+	CHECK_EQ(recalibrations, 1);
+
+	CHECK(request(CMD_COUNTERS, NULL, 0u));
+	CHECK_EQ(response_status(CMD_COUNTERS), CMD_STATUS_OK);
+	CHECK_EQ(tx[1], 2u + 5u * 2u);
+	CHECK_EQ(response_u16(0), cmd_stats.frames);
+	CHECK_EQ(response_u16(1), 0);
+	CHECK_EQ(response_u16(3), 0x1234);
+	CHECK_EQ(response_u16(4), 7);
+
+	perf_init(1u);
+	perf_count(PERF_ACTUATIONS);
+	CHECK(request(CMD_PERF, NULL, 0u));
+	CHECK_EQ(response_status(CMD_PERF), CMD_STATUS_OK);
+	CHECK_EQ(tx[1], 2u + PERF_COUNT * 2u);
+	CHECK_EQ(response_u16(PERF_ACTUATIONS), 1);
+	CHECK_EQ(response_u16(PERF_WAKES), 0);
+}
+
+static void test_framing_errors(void)
+{
+	static const uint8_t bad_crc[] = {CMD_REQUEST_SOF, 1u, CMD_PING, 0x00u, 0x00u};
+	uint16_t             crc_errors = cmd_stats.crc_errors;
+	uint8_t              ping[5]    = {CMD_REQUEST_SOF, 1u, CMD_PING};
+	uint16_t             crc        = crc16(&ping[1], 2u);
+	unsigned             i;
+
+	ping[3] = (uint8_t)crc;
+	ping[4] = (uint8_t)(crc >> 8);
+
+	tx_len = 0u;
+	for (i = 0u; i < sizeof(bad_crc); i++) {
+		cmd_rx_byte(bad_crc[i]);
+	}
+	CHECK(!cmd_process());
+	CHECK_EQ(tx_len, 0);
+	CHECK_EQ(cmd_stats.crc_errors, crc_errors + 1u);
+
+	/* garbage and preamble bytes in front of a request are skipped */
+	cmd_rx_byte(CMD_WAKE_PREAMBLE);
+	cmd_rx_byte(0x00u);
+	CHECK(request(CMD_PING, NULL, 0u));
+
+	/* bytes arriving while a request waits for cmd_process() are dropped */
+	CHECK(request(CMD_PING, NULL, 0u));
+	for (i = 0u; i < 5u; i++) {
+		cmd_rx_byte(ping[i]);
+	}
+	cmd_rx_byte(CMD_REQUEST_SOF);
+	CHECK_EQ(cmd_stats.overruns, 1);
+	CHECK(cmd_process());
+	CHECK(!cmd_process());
+}
+
+static void test_timeout(void)
+{
+	unsigned i;
+
+	cmd_init();
+	CHECK(!cmd_rx_busy());
+
+	/* a partial request keeps the receiver busy until the timeout */
+	cmd_rx_byte(CMD_REQUEST_SOF);
+	cmd_rx_byte(2u);
+	CHECK(cmd_rx_busy());
+	for (i = 0u; i < CMD_RX_TIMEOUT_TICKS; i++) {
+		CHECK(cmd_rx_busy());
+		cmd_tick();
+	}
+	CHECK(!cmd_rx_busy());
+
+	/* the partial request is gone, a new one is accepted */
+	CHECK(request(CMD_PING, NULL, 0u));
+	CHECK_EQ(response_status(CMD_PING), CMD_STATUS_OK);
+}
+
+int main(void)
+{
+	cmd_init();
+	test_ping();
+	test_params();
+	test_recalibrate_and_counters();
+	test_framing_errors();
+	test_timeout();
+
+	return test_result("test_uart_command");
+}
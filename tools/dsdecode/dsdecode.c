@@ -0,0 +1,281 @@
+/*============================================================================
+Filename : dsdecode.c
+Project : Attiny814Code host tools
+Purpose : Stream decoder for the compact datastreamer frame format. Finds
+          frames in an arbitrary byte stream, checks the CRC, undoes the
+          delta coding and hands every frame to a callback.
+============================================================================*/
+
+#include <string.h>
+
+#include "dsdecode.h"
+
+/*----------------------------------------------------------------------------
+ *     global variables
+ *----------------------------------------------------------------------------*/
+static uint16_t crc_table[256];
+static int      crc_table_ready;
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *----------------------------------------------------------------------------*/
+
+static void crc_table_init(void)
+{
+	unsigned i;
+
+	if (crc_table_ready) {
+		return;
+	}
+	/* a table entry is the CRC of the byte shifted through a zero register */
+	for (i = 0u; i < 256u; i++) {
+		crc_table[i] = ds_crc16_update(0u, (uint8_t)i);
+	}
+	crc_table_ready = 1;
+}
+
+static uint16_t crc16(const uint8_t *data, size_t len)
+{
+	uint16_t crc = DS_CRC16_INIT;
+
+	while (len--) {
+		crc = (uint16_t)(crc << 8u) ^ crc_table[(uint8_t)(crc >> 8u) ^ *data++];
+	}
+	return crc;
+}
+
+/*============================================================================
+void ds_decoder_init(ds_decoder_t *dec)
+------------------------------------------------------------------------------
+Purpose: Resets the decoder. The first frame accepted is the next keyframe.
+============================================================================*/
+void ds_decoder_init(ds_decoder_t *dec)
+{
+	crc_table_init();
+	memset(dec, 0, sizeof(*dec));
+}
+
+/*============================================================================
+int ds_frame_check(const uint8_t *frame, size_t len)
+------------------------------------------------------------------------------
+Purpose: Checks SOF, LEN and CRC of a single frame.
+Input  : frame starting at SOF; available bytes
+Output : frame size on success, 0 if more bytes are needed, -1 if the bytes
+         at frame are not a valid frame
+============================================================================*/
+int ds_frame_check(const uint8_t *frame, size_t len)
+{
+	size_t   size;
+	uint16_t crc;
+
+	crc_table_init();
+
+	if (len < 2u) {
+		return 0;
+	}
+	if (frame[0] != DS_FRAME_SOF || frame[1] < 3u) {
+		return -1;
+	}
+	size = (size_t)frame[1] + DS_FRAME_OVERHEAD;
+	if (len < size) {
+		return 0;
+	}
+	crc = crc16(&frame[1], size - 3u);
+	if (frame[size - 2u] != (uint8_t)crc || frame[size - 1u] != (uint8_t)(crc >> 8u)) {
+		return -1;
+	}
+	return (int)size;
+}
+
+static int get_varint(const uint8_t **p, const uint8_t *end, uint16_t *value)
+{
+	uint32_t v     = 0u;
+	unsigned shift = 0u;
+
+	while (*p < end && shift < 21u) {
+		uint8_t b = *(*p)++;
+
+		v |= (uint32_t)(b & 0x7Fu) << shift;
+		if ((b & 0x80u) == 0u) {
+			*value = (uint16_t)v;
+			return v <= 0xFFFFu;
+		}
+		shift += 7u;
+	}
+	return 0;
+}
+
+/* Decodes a CRC checked frame. Returns 0 on a malformed frame. */
+static int decode_frame(ds_decoder_t *dec, const uint8_t *frame, ds_frame_cb_t cb, void *ctx)
+{
+	const uint8_t *p   = &frame[2];
+	const uint8_t *end = &frame[2] + frame[1];
+	uint16_t       fields[DS_MAX_FIELDS];
+	ds_frame_t     out;
+	uint8_t        num_fields, ts, i, ch;
+
+	if ((*p >> 4u) != DS_FRAME_VERSION) {
+		return 0;
+	}
+	out.flags = *p++ & DS_FLAG_MASK;
+	out.seq   = *p++;
+	out.event = 0u;
+	if (out.flags & DS_FLAG_EVENT) {
+		if (p >= end) {
+			return 0;
+		}
+		out.event = *p++;
+	}
+	if (p >= end) {
+		return 0;
+	}
+	out.num_channels = *p++;
+	if (out.num_channels > DS_MAX_CHANNELS) {
+		return 0;
+	}
+
+	ts         = (out.flags & DS_FLAG_TIMESTAMP) ? 1u : 0u;
+	num_fields = (uint8_t)DS_FRAME_NUM_FIELDS(out.num_channels, ts);
+	for (i = 0u; i < num_fields; i++) {
+		uint16_t zz;
+
+		if (!get_varint(&p, end, &zz)) {
+			return 0;
+		}
+		/* undo zigzag, the difference wraps at 16 bits */
+		fields[i] = (uint16_t)((zz >> 1u) ^ (uint16_t)(0u - (zz & 1u)));
+	}
+	if (p != end) {
+		return 0;
+	}
+
+	if (dec->have_seq && out.seq != (uint8_t)(dec->last_seq + 1u)) {
+		dec->stats.seq_gaps++;
+		dec->have_base = 0u;
+	}
+	dec->have_seq = 1u;
+	dec->last_seq = out.seq;
+
+	if (out.flags & DS_FLAG_KEYFRAME) {
+		memset(dec->prev, 0, sizeof(dec->prev));
+		dec->num_fields = num_fields;
+		dec->have_base  = 1u;
+		dec->stats.keyframes++;
+	} else if (!dec->have_base || dec->num_fields != num_fields) {
+		dec->have_base = 0u;
+		dec->stats.no_base++;
+		return 1;
+	}
+
+	for (i = 0u; i < num_fields; i++) {
+		dec->prev[i] = (uint16_t)(dec->prev[i] + fields[i]);
+	}
+
+	i             = 0u;
+	out.timestamp = ts ? dec->prev[i++] : 0u;
+	for (ch = 0u; ch < out.num_channels; ch++) {
+		ds_channel_t *c = &out.channel[ch];
+
+		c->signal        = dec->prev[i + DS_FIELD_SIGNAL];
+		c->reference     = dec->prev[i + DS_FIELD_REFERENCE];
+		c->delta         = (int16_t)dec->prev[i + DS_FIELD_DELTA];
+		c->threshold     = dec->prev[i + DS_FIELD_THRESHOLD];
+		c->comp_cap      = dec->prev[i + DS_FIELD_COMP_CAP];
+		c->state         = (uint8_t)dec->prev[i + DS_FIELD_STATE];
+		c->key_threshold = (uint8_t)dec->prev[i + DS_FIELD_KEY_THRESHOLD];
+		i += DS_FIELDS_PER_CHANNEL;
+	}
+	out.error_code = (uint8_t)dec->prev[i];
+
+	dec->stats.frames++;
+	if (cb) {
+		cb(&out, ctx);
+	}
+	return 1;
+}
+
+/* Consumes a frame candidate at data. Returns the bytes consumed, 0 if the
+ * candidate is incomplete. */
+static size_t try_frame(ds_decoder_t *dec, const uint8_t *data, size_t len, ds_frame_cb_t cb, void *ctx)
+{
+	int size = ds_frame_check(data, len);
+
+	if (size == 0) {
+		return 0u;
+	}
+	if (size < 0) {
+		/* the SOF was noise or the frame is corrupt: resync one byte later */
+		if (len >= 2u && data[0] == DS_FRAME_SOF && data[1] >= 3u) {
+			dec->stats.crc_errors++;
+		}
+		dec->stats.skipped_bytes++;
+		return 1u;
+	}
+	if (!decode_frame(dec, data, cb, ctx)) {
+		dec->stats.format_errors++;
+		dec->have_base = 0u;
+	}
+	return (size_t)size;
+}
+
+/*============================================================================
+void ds_decoder_feed(ds_decoder_t *dec, const uint8_t *data, size_t len,
+                     ds_frame_cb_t cb, void *ctx)
+------------------------------------------------------------------------------
+Purpose: Feeds a chunk of the byte stream into the decoder. cb is called for
+         every frame completed by this chunk.
+Notes  : Frames that lie completely within data are decoded in place, only
+         frames split across chunks are copied.
+============================================================================*/
+void ds_decoder_feed(ds_decoder_t *dec, const uint8_t *data, size_t len, ds_frame_cb_t cb, void *ctx)
+{
+	dec->stats.bytes += len;
+
+	while (len != 0u) {
+		size_t used;
+
+		if (dec->fill != 0u) {
+			size_t  n = sizeof(dec->buf) - dec->fill;
+			uint8_t rest[sizeof(dec->buf)];
+			size_t  rest_len;
+
+			if (n > len) {
+				n = len;
+			}
+			memcpy(&dec->buf[dec->fill], data, n);
+			used = try_frame(dec, dec->buf, dec->fill + n, cb, ctx);
+			if (used == 0u) {
+				dec->fill += n;
+				return;
+			}
+			/* bytes of buf behind the frame go through the decoder again */
+			rest_len  = dec->fill + n - used;
+			memcpy(rest, &dec->buf[used], rest_len);
+			dec->fill = 0u;
+			data += n;
+			len -= n;
+			dec->stats.bytes -= rest_len;
+			ds_decoder_feed(dec, rest, rest_len, cb, ctx);
+			continue;
+		}
+
+		if (*data != DS_FRAME_SOF) {
+			const uint8_t *sof = memchr(data, DS_FRAME_SOF, len);
+
+			used = sof ? (size_t)(sof - data) : len;
+			dec->stats.skipped_bytes += used;
+			data += used;
+			len -= used;
+			continue;
+		}
+
+		used = try_frame(dec, data, len, cb, ctx);
+		if (used == 0u) {
+			memcpy(dec->buf, data, len);
+			dec->fill = len;
+			return;
+		}
+		data += used;
+		len -= used;
+	}
+}
@@ -0,0 +1,88 @@
+/*============================================================================
+Filename : dsdecode.h
+Project : Attiny814Code host tools
+Purpose : Stream decoder for the compact datastreamer frame format defined
+          in qtouch/datastreamer/datastreamer_frame.h.
+============================================================================*/
+
+#ifndef DSDECODE_H
+#define DSDECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "datastreamer_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* Largest channel count a LEN byte can describe */
+#define DS_MAX_CHANNELS 11u
+
+#define DS_MAX_FIELDS DS_FRAME_NUM_FIELDS(DS_MAX_CHANNELS, 1u)
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+typedef struct {
+	uint16_t signal;
+	uint16_t reference;
+	int16_t  delta;
+	uint16_t threshold;
+	uint16_t comp_cap;
+	uint8_t  state;
+	uint8_t  key_threshold;
+} ds_channel_t;
+
+/* One decoded frame */
+typedef struct {
+	uint8_t      flags;
+	uint8_t      seq;
+	uint8_t      event;
+	uint8_t      num_channels;
+	uint16_t     timestamp;
+	uint8_t      error_code;
+	ds_channel_t channel[DS_MAX_CHANNELS];
+} ds_frame_t;
+
+typedef struct {
+	uint64_t bytes;         /* bytes fed into the decoder */
+	uint64_t frames;        /* frames passed to the callback */
+	uint64_t keyframes;     /* keyframes among them */
+	uint64_t crc_errors;    /* frame candidates with a CRC mismatch, includes stray SOF bytes */
+	uint64_t format_errors; /* CRC valid but malformed or unknown version */
+	uint64_t seq_gaps;      /* sequence discontinuities */
+	uint64_t no_base;       /* delta frames dropped while waiting for a keyframe */
+	uint64_t skipped_bytes; /* bytes outside of any valid frame */
+} ds_decoder_stats_t;
+
+typedef void (*ds_frame_cb_t)(const ds_frame_t *frame, void *ctx);
+
+/* Decoder state, treat as opaque */
+typedef struct {
+	uint8_t            buf[DS_FRAME_MAX_LEN + DS_FRAME_OVERHEAD];
+	size_t             fill;
+	uint16_t           prev[DS_MAX_FIELDS];
+	uint8_t            num_fields;
+	uint8_t            have_base;
+	uint8_t            have_seq;
+	uint8_t            last_seq;
+	ds_decoder_stats_t stats;
+} ds_decoder_t;
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *----------------------------------------------------------------------------*/
+void ds_decoder_init(ds_decoder_t *dec);
+void ds_decoder_feed(ds_decoder_t *dec, const uint8_t *data, size_t len, ds_frame_cb_t cb, void *ctx);
+int  ds_frame_check(const uint8_t *frame, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DSDECODE_H */
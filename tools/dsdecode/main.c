@@ -0,0 +1,360 @@
+/*============================================================================
+Filename : main.c
+Project : Attiny814Code host tools
+Purpose : dsdecode command line tool. Turns a compact datastreamer capture
+          (file, stdin or serial device) into CSV or columnar files.
+
+Usage   : dsdecode [-f csv|col] [-o output] [-b baud] [-q] [input]
+
+          input   capture file, serial device or '-' for stdin (default)
+          -f csv  one line per frame (default)
+          -f col  one little-endian int32 file per column in directory
+                  output, plus columns.txt listing the column files
+          -o      output file (csv, default stdout) or directory (col)
+          -b      baud rate when input is a serial device (default 115200)
+          -q      do not print the decoder statistics to stderr
+============================================================================*/
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dsdecode.h"
+
+#define READ_CHUNK 65536u
+#define OUT_CHUNK 65536u
+
+/* Global columns in front of the per channel columns */
+#define NUM_GLOBAL_COLUMNS 5u
+
+static const char *global_columns[NUM_GLOBAL_COLUMNS] = {"seq", "timestamp", "keyframe", "event", "error"};
+
+static const char *channel_columns[DS_FIELDS_PER_CHANNEL]
+    = {"signal", "reference", "delta", "threshold", "comp_cap", "state", "key_threshold"};
+
+typedef enum { FORMAT_CSV, FORMAT_COL } output_format_t;
+
+typedef struct {
+	output_format_t format;
+	const char *    output;
+	FILE *          csv;
+	FILE *          col[NUM_GLOBAL_COLUMNS + DS_MAX_CHANNELS * DS_FIELDS_PER_CHANNEL];
+	unsigned        num_columns;
+	int             num_channels; /* channel count of the first frame, -1 before */
+	uint64_t        channel_mismatch;
+	char            buf[OUT_CHUNK];
+	size_t          fill;
+} output_t;
+
+static void die(const char *what)
+{
+	fprintf(stderr, "dsdecode: %s: %s\n", what, strerror(errno));
+	exit(1);
+}
+
+static void csv_flush(output_t *out)
+{
+	if (out->fill && fwrite(out->buf, 1u, out->fill, out->csv) != out->fill) {
+		die("write");
+	}
+	out->fill = 0u;
+}
+
+static void csv_put_str(output_t *out, const char *s)
+{
+	size_t n = strlen(s);
+
+	if (out->fill + n > sizeof(out->buf)) {
+		csv_flush(out);
+	}
+	memcpy(&out->buf[out->fill], s, n);
+	out->fill += n;
+}
+
+static void csv_put_int(output_t *out, long value, char sep)
+{
+	char  tmp[24];
+	char *p = &tmp[sizeof(tmp)];
+	int   neg = value < 0;
+	unsigned long v = neg ? (unsigned long)-value : (unsigned long)value;
+
+	if (out->fill + sizeof(tmp) > sizeof(out->buf)) {
+		csv_flush(out);
+	}
+	*--p = sep;
+	do {
+		*--p = (char)('0' + v % 10u);
+		v /= 10u;
+	} while (v);
+	if (neg) {
+		*--p = '-';
+	}
+	memcpy(&out->buf[out->fill], p, (size_t)(&tmp[sizeof(tmp)] - p));
+	out->fill += (size_t)(&tmp[sizeof(tmp)] - p);
+}
+
+static void frame_values(const ds_frame_t *f, long *v)
+{
+	unsigned i = 0u;
+	uint8_t  ch;
+
+	v[i++] = f->seq;
+	v[i++] = f->timestamp;
+	v[i++] = (f->flags & DS_FLAG_KEYFRAME) ? 1 : 0;
+	v[i++] = f->event;
+	v[i++] = f->error_code;
+	for (ch = 0u; ch < f->num_channels; ch++) {
+		v[i++] = f->channel[ch].signal;
+		v[i++] = f->channel[ch].reference;
+		v[i++] = f->channel[ch].delta;
+		v[i++] = f->channel[ch].threshold;
+		v[i++] = f->channel[ch].comp_cap;
+		v[i++] = f->channel[ch].state;
+		v[i++] = f->channel[ch].key_threshold;
+	}
+}
+
+static void column_name(unsigned col, char *name, size_t size)
+{
+	if (col < NUM_GLOBAL_COLUMNS) {
+		snprintf(name, size, "%s", global_columns[col]);
+	} else {
+		col -= NUM_GLOBAL_COLUMNS;
+		snprintf(name, size, "ch%u_%s", col / DS_FIELDS_PER_CHANNEL, channel_columns[col % DS_FIELDS_PER_CHANNEL]);
+	}
+}
+
+static void output_open(output_t *out, int num_channels)
+{
+	char     name[64], path[4096];
+	unsigned col;
+	FILE *   list;
+
+	out->num_channels = num_channels;
+	out->num_columns  = NUM_GLOBAL_COLUMNS + (unsigned)num_channels * DS_FIELDS_PER_CHANNEL;
+
+	if (out->format == FORMAT_CSV) {
+		for (col = 0u; col < out->num_columns; col++) {
+			column_name(col, name, sizeof(name));
+			csv_put_str(out, name);
+			csv_put_str(out, col + 1u < out->num_columns ? "," : "\n");
+		}
+		return;
+	}
+
+	if (mkdir(out->output, 0777) != 0 && errno != EEXIST) {
+		die(out->output);
+	}
+	snprintf(path, sizeof(path), "%s/columns.txt", out->output);
+	list = fopen(path, "w");
+	if (!list) {
+		die(path);
+	}
+	for (col = 0u; col < out->num_columns; col++) {
+		column_name(col, name, sizeof(name));
+		fprintf(list, "%s.i32\n", name);
+		snprintf(path, sizeof(path), "%s/%s.i32", out->output, name);
+		out->col[col] = fopen(path, "wb");
+		if (!out->col[col]) {
+			die(path);
+		}
+	}
+	fclose(list);
+}
+
+static void on_frame(const ds_frame_t *frame, void *ctx)
+{
+	output_t *out = ctx;
+	long      v[NUM_GLOBAL_COLUMNS + DS_MAX_CHANNELS * DS_FIELDS_PER_CHANNEL];
+	unsigned  col;
+
+	if (out->num_channels < 0) {
+		output_open(out, frame->num_channels);
+	}
+	if (frame->num_channels != out->num_channels) {
+		out->channel_mismatch++;
+		return;
+	}
+
+	frame_values(frame, v);
+	for (col = 0u; col < out->num_columns; col++) {
+		if (out->format == FORMAT_CSV) {
+			csv_put_int(out, v[col], col + 1u < out->num_columns ? ',' : '\n');
+		} else {
+			int32_t le = (int32_t)v[col];
+			uint8_t b[4] = {(uint8_t)le, (uint8_t)(le >> 8), (uint8_t)(le >> 16), (uint8_t)(le >> 24)};
+
+			if (fwrite(b, 1u, 4u, out->col[col]) != 4u) {
+				die("write");
+			}
+		}
+	}
+}
+
+static speed_t baud_to_speed(long baud)
+{
+	switch (baud) {
+	case 9600:
+		return B9600;
+	case 19200:
+		return B19200;
+	case 38400:
+		return B38400;
+	case 57600:
+		return B57600;
+	case 115200:
+		return B115200;
+	case 230400:
+		return B230400;
+	default:
+		fprintf(stderr, "dsdecode: unsupported baud rate %ld\n", baud);
+		exit(2);
+	}
+}
+
+static int open_input(const char *name, long baud)
+{
+	struct termios tio;
+	int            fd;
+
+	if (strcmp(name, "-") == 0) {
+		return STDIN_FILENO;
+	}
+	fd = open(name, O_RDONLY | O_NOCTTY);
+	if (fd < 0) {
+		die(name);
+	}
+	if (isatty(fd)) {
+		if (tcgetattr(fd, &tio) != 0) {
+			die(name);
+		}
+		cfmakeraw(&tio);
+		cfsetispeed(&tio, baud_to_speed(baud));
+		cfsetospeed(&tio, baud_to_speed(baud));
+		tio.c_cc[VMIN]  = 1;
+		tio.c_cc[VTIME] = 0;
+		if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+			die(name);
+		}
+	}
+	return fd;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: dsdecode [-f csv|col] [-o output] [-b baud] [-q] [input]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t  chunk[READ_CHUNK];
+	static output_t out;
+	ds_decoder_t    dec;
+	const char *    input = "-";
+	long            baud  = 115200;
+	int             quiet = 0;
+	int             opt, fd;
+	unsigned        col;
+	ssize_t         n;
+	struct timespec t0, t1;
+	double          secs;
+
+	out.format       = FORMAT_CSV;
+	out.num_channels = -1;
+
+	while ((opt = getopt(argc, argv, "f:o:b:q")) != -1) {
+		switch (opt) {
+		case 'f':
+			if (strcmp(optarg, "csv") == 0) {
+				out.format = FORMAT_CSV;
+			} else if (strcmp(optarg, "col") == 0) {
+				out.format = FORMAT_COL;
+			} else {
+				usage();
+			}
+			break;
+		case 'o':
+			out.output = optarg;
+			break;
+		case 'b':
+			baud = strtol(optarg, NULL, 10);
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind < argc) {
+		input = argv[optind++];
+	}
+	if (optind != argc || (out.format == FORMAT_COL && !out.output)) {
+		usage();
+	}
+
+	out.csv = stdout;
+	if (out.format == FORMAT_CSV && out.output) {
+		out.csv = fopen(out.output, "w");
+		if (!out.csv) {
+			die(out.output);
+		}
+	}
+
+	fd = open_input(input, baud);
+	ds_decoder_init(&dec);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	while ((n = read(fd, chunk, sizeof(chunk))) != 0) {
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			die(input);
+		}
+		ds_decoder_feed(&dec, chunk, (size_t)n, on_frame, &out);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	if (out.format == FORMAT_CSV) {
+		csv_flush(&out);
+		if (out.csv != stdout) {
+			fclose(out.csv);
+		}
+	} else {
+		for (col = 0u; col < out.num_columns; col++) {
+			fclose(out.col[col]);
+		}
+	}
+
+	if (!quiet) {
+		secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+		fprintf(stderr,
+		        "bytes %llu, frames %llu (keyframes %llu), crc errors %llu, format errors %llu,\n"
+		        "sequence gaps %llu, frames without base %llu, skipped bytes %llu, channel mismatches %llu\n"
+		        "%.3f s, %.1f MB/s\n",
+		        (unsigned long long)dec.stats.bytes,
+		        (unsigned long long)dec.stats.frames,
+		        (unsigned long long)dec.stats.keyframes,
+		        (unsigned long long)dec.stats.crc_errors,
+		        (unsigned long long)dec.stats.format_errors,
+		        (unsigned long long)dec.stats.seq_gaps,
+		        (unsigned long long)dec.stats.no_base,
+		        (unsigned long long)dec.stats.skipped_bytes,
+		        (unsigned long long)out.channel_mismatch,
+		        secs,
+		        secs > 0.0 ? (double)dec.stats.bytes / secs / 1e6 : 0.0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,755 @@
+/*============================================================================
+Filename : membudget.c
+Project : Attiny814Code host tools
+Purpose : membudget, flash and RAM usage of a firmware build per object and
+          per symbol, read from the linker map and the ELF symbol table.
+          Compares the usage with a stored baseline and fails when a
+          budget is exceeded.
+
+Usage   : membudget [-m map] [-b budget] [-d baseline] [-w baseline]
+                    [-n symbols] [-q] elf
+
+          -m  linker map (default: elf with .map extension)
+          -b  budget file, exit status 1 when a limit is exceeded
+          -d  baseline to print the per object differences against
+          -w  write the per object usage as new baseline
+          -n  number of symbols listed, largest first (default 20)
+          -q  print only the totals, differences and budget violations
+
+          flash = text + rodata + data (initial values)
+          ram   = data + bss (stack not included)
+
+Budget  : one limit per line, '#' starts a comment
+
+          # scope   kind    limit
+          total     flash   8192
+          main.o    ram     160
+
+          scope is "total" or an object name as printed in the report,
+          kind one of flash, ram, text, rodata, data, bss.
+
+Baseline: one object per line, written by -w
+
+          object text rodata data bss
+============================================================================*/
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+#define CAT_TEXT 0u
+#define CAT_RODATA 1u
+#define CAT_DATA 2u
+#define CAT_BSS 3u
+#define CAT_COUNT 4u
+#define CAT_NONE 0xFFu
+
+/* budget kinds following the categories */
+#define KIND_FLASH CAT_COUNT
+#define KIND_RAM (CAT_COUNT + 1u)
+#define KIND_COUNT (CAT_COUNT + 2u)
+
+#define LINE_MAX_LEN 1024u
+#define NAME_MAX_LEN 128u
+
+/* ELF32 header fields */
+#define EI_NIDENT 16u
+#define ELFCLASS32 1u
+#define ELFDATA2LSB 1u
+#define SHT_SYMTAB 2u
+#define STT_OBJECT 1u
+#define STT_FUNC 2u
+#define SHN_LORESERVE 0xFF00u
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+typedef struct {
+	char     name[NAME_MAX_LEN];
+	uint32_t size[CAT_COUNT];
+} object_t;
+
+/* input section of the map, for the symbol to object lookup */
+typedef struct {
+	uint32_t addr;
+	uint32_t size;
+	unsigned object;
+} input_t;
+
+typedef struct {
+	char *   name;
+	uint32_t size;
+	uint8_t  cat;
+	char     object[NAME_MAX_LEN];
+} symbol_t;
+
+/*----------------------------------------------------------------------------
+ *     global variables
+ *----------------------------------------------------------------------------*/
+static const char *kind_names[KIND_COUNT] = {"text", "rodata", "data", "bss", "flash", "ram"};
+
+static object_t *objects;
+static unsigned  num_objects;
+static input_t * inputs;
+static unsigned  num_inputs;
+static symbol_t *symbols;
+static unsigned  num_symbols;
+
+/* output section sizes of the ELF file */
+static uint32_t elf_size[CAT_COUNT];
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *----------------------------------------------------------------------------*/
+
+static void *xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		fprintf(stderr, "membudget: out of memory\n");
+		exit(2);
+	}
+	return p;
+}
+
+static uint32_t usage_of(const uint32_t *size, unsigned kind)
+{
+	if (kind == KIND_FLASH) {
+		return size[CAT_TEXT] + size[CAT_RODATA] + size[CAT_DATA];
+	}
+	if (kind == KIND_RAM) {
+		return size[CAT_DATA] + size[CAT_BSS];
+	}
+	return size[kind];
+}
+
+static unsigned find_object(object_t *list, unsigned *count, const char *name, int create)
+{
+	unsigned i;
+
+	for (i = 0u; i < *count; i++) {
+		if (strcmp(list[i].name, name) == 0) {
+			return i;
+		}
+	}
+	if (!create) {
+		return *count;
+	}
+	memset(&list[i], 0, sizeof(list[i]));
+	snprintf(list[i].name, sizeof(list[i].name), "%s", name);
+	(*count)++;
+	return i;
+}
+
+static unsigned add_object(const char *name)
+{
+	if ((num_objects & 63u) == 0u) {
+		objects = xrealloc(objects, (num_objects + 64u) * sizeof(*objects));
+	}
+	return find_object(objects, &num_objects, name, 1);
+}
+
+static int ends_with(const char *s, const char *suffix)
+{
+	size_t n = strlen(s), m = strlen(suffix);
+
+	return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static const char *base_name(const char *path, const char *end)
+{
+	const char *p, *base = path;
+
+	for (p = path; p < end; p++) {
+		if (*p == '/' || *p == '\\') {
+			base = p + 1;
+		}
+	}
+	return base;
+}
+
+/* Object names independent of the build system and host: archives and
+ * toolchain objects by file name, project objects by their path in the
+ * project, CMake's dir/file.c.obj as file.o. */
+static void object_name(const char *raw, char *name)
+{
+	const char *member = strchr(raw, '(');
+	const char *start  = raw;
+	const char *dir;
+	size_t      len;
+
+	if (member && ends_with(raw, ")")) {
+		start = base_name(raw, member);
+	} else if (raw[0] == '/' || raw[0] == '\\' || (raw[0] && raw[1] == ':') || strstr(raw, "..")) {
+		start = base_name(raw, raw + strlen(raw));
+	} else if ((dir = strstr(raw, ".dir/")) != NULL) {
+		start = dir + 5;
+	}
+	snprintf(name, NAME_MAX_LEN, "%s", start);
+
+	len = strlen(name);
+	if (ends_with(name, ".obj")) {
+		len -= 2u;
+		name[len - 1u] = 'o';
+		name[len]      = '\0';
+	}
+	if (ends_with(name, ".c.o") || ends_with(name, ".S.o")) {
+		memmove(&name[len - 4u], &name[len - 2u], 3u);
+	}
+}
+
+static uint8_t output_category(const char *section)
+{
+	if (strcmp(section, ".text") == 0) {
+		return CAT_TEXT;
+	}
+	if (strcmp(section, ".rodata") == 0) {
+		return CAT_RODATA;
+	}
+	if (strcmp(section, ".data") == 0) {
+		return CAT_DATA;
+	}
+	if (strcmp(section, ".bss") == 0 || strcmp(section, ".noinit") == 0) {
+		return CAT_BSS;
+	}
+	return CAT_NONE;
+}
+
+static int is_hex(const char *s)
+{
+	return s[0] == '0' && s[1] == 'x';
+}
+
+static void add_input(uint8_t out, const char *section, uint32_t addr, uint32_t size, const char *raw)
+{
+	char     name[NAME_MAX_LEN];
+	uint8_t  cat = out;
+	unsigned obj;
+
+	if (size == 0u) {
+		return;
+	}
+	/* constants kept in flash by the AVR linker script */
+	if (out == CAT_TEXT && (strncmp(section, ".rodata", 7u) == 0 || strncmp(section, ".progmem", 8u) == 0)) {
+		cat = CAT_RODATA;
+	}
+	if (strcmp(section, "*fill*") == 0) {
+		snprintf(name, sizeof(name), "(fill)");
+	} else if (*raw == '\0') {
+		snprintf(name, sizeof(name), "(linker)");
+	} else {
+		object_name(raw, name);
+	}
+	obj = add_object(name);
+	objects[obj].size[cat] += size;
+
+	if ((num_inputs & 255u) == 0u) {
+		inputs = xrealloc(inputs, (num_inputs + 256u) * sizeof(*inputs));
+	}
+	inputs[num_inputs].addr   = addr;
+	inputs[num_inputs].size   = size;
+	inputs[num_inputs].object = obj;
+	num_inputs++;
+}
+
+/*============================================================================
+static int read_map(const char *path)
+------------------------------------------------------------------------------
+Purpose: Adds the input sections of the memory map to the objects.
+Input  : GNU ld map file
+Output : 0, -1 if the file can not be read or has no memory map
+Notes  : ld prints long input section names on a line of their own, the
+         address, size and object follow on the next line.
+============================================================================*/
+static int read_map(const char *path)
+{
+	char     line[LINE_MAX_LEN], section[LINE_MAX_LEN] = "";
+	char     token[LINE_MAX_LEN], addr_s[32], size_s[32];
+	uint8_t  out     = CAT_NONE;
+	int      in_map  = 0;
+	int      pending = 0;
+	FILE *   f       = fopen(path, "r");
+	char *   p;
+	int      n;
+	unsigned len;
+
+	if (!f) {
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		len = (unsigned)strlen(line);
+		while (len && (line[len - 1u] == '\n' || line[len - 1u] == '\r' || line[len - 1u] == ' ')) {
+			line[--len] = '\0';
+		}
+		if (!in_map) {
+			in_map = strncmp(line, "Linker script and memory map", 28u) == 0;
+			continue;
+		}
+		if (strncmp(line, "OUTPUT(", 7u) == 0) {
+			break;
+		}
+		if (line[0] == '.') {
+			sscanf(line, "%1023s", token);
+			out     = output_category(token);
+			pending = 0;
+			continue;
+		}
+		if (out == CAT_NONE || line[0] != ' ') {
+			continue;
+		}
+
+		p = line;
+		if (!pending) {
+			/* " .section", " COMMON" or " *fill*", not " *(pattern)" */
+			if (line[1] == ' ' || (line[1] == '*' && line[2] == '(') || sscanf(line, "%1023s%n", section, &n) != 1) {
+				continue;
+			}
+			if (section[0] != '.' && strcmp(section, "COMMON") != 0 && strcmp(section, "*fill*") != 0) {
+				continue;
+			}
+			p += n;
+		}
+		if (sscanf(p, "%31s %31s%n", addr_s, size_s, &n) != 2) {
+			pending = !pending && *p == '\0';
+			continue;
+		}
+		pending = 0;
+		if (!is_hex(addr_s) || !is_hex(size_s)) {
+			continue;
+		}
+		p += n;
+		while (*p == ' ') {
+			p++;
+		}
+		add_input(out,
+		          section,
+		          (uint32_t)strtoul(addr_s, NULL, 16),
+		          (uint32_t)strtoul(size_s, NULL, 16),
+		          p);
+	}
+	fclose(f);
+	return in_map ? 0 : -1;
+}
+
+static uint32_t le16(const uint8_t *p)
+{
+	return p[0] | ((uint32_t)p[1] << 8u);
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+	return le16(p) | (le16(p + 2) << 16u);
+}
+
+static const char *symbol_object(uint32_t addr)
+{
+	unsigned i;
+
+	for (i = 0u; i < num_inputs; i++) {
+		if (addr >= inputs[i].addr && addr - inputs[i].addr < inputs[i].size) {
+			return objects[inputs[i].object].name;
+		}
+	}
+	return "?";
+}
+
+/*============================================================================
+static int read_elf(const char *path)
+------------------------------------------------------------------------------
+Purpose: Reads the output section sizes and the sized function and object
+         symbols of an ELF32 little-endian file.
+Input  : ELF file
+Output : 0, -1 on read or format errors
+Notes  : Call after read_map() and before the objects are sorted, symbols
+         are assigned to objects by address.
+============================================================================*/
+static int read_elf(const char *path)
+{
+	FILE *         f = fopen(path, "rb");
+	uint8_t *      elf;
+	long           size;
+	uint32_t       shoff, shentsize, shnum, shstrndx, i, j;
+	const uint8_t *sh, *shstr, *sym, *str;
+
+	if (!f) {
+		return -1;
+	}
+	if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 52 || fseek(f, 0, SEEK_SET) != 0) {
+		fclose(f);
+		errno = EINVAL;
+		return -1;
+	}
+	elf = xrealloc(NULL, (size_t)size);
+	if (fread(elf, 1u, (size_t)size, f) != (size_t)size) {
+		fclose(f);
+		free(elf);
+		return -1;
+	}
+	fclose(f);
+
+	shoff     = le32(&elf[32]);
+	shentsize = le16(&elf[46]);
+	shnum     = le16(&elf[48]);
+	shstrndx  = le16(&elf[50]);
+	if (memcmp(elf, "\177ELF", 4u) != 0 || elf[4] != ELFCLASS32 || elf[5] != ELFDATA2LSB || shentsize < 40u
+	    || shstrndx >= shnum || (uint64_t)shoff + (uint64_t)shnum * shentsize > (uint64_t)size) {
+		free(elf);
+		errno = EINVAL;
+		return -1;
+	}
+	shstr = &elf[le32(&elf[shoff + shstrndx * shentsize + 16u])];
+
+	for (i = 0u; i < shnum; i++) {
+		uint8_t cat;
+
+		sh  = &elf[shoff + i * shentsize];
+		cat = output_category((const char *)&shstr[le32(sh)]);
+		if (cat != CAT_NONE) {
+			elf_size[cat] += le32(&sh[20]);
+		}
+		if (le32(&sh[4]) != SHT_SYMTAB || le32(&sh[24]) >= shnum || le32(&sh[36]) < 16u) {
+			continue;
+		}
+		sym = &elf[le32(&sh[16])];
+		str = &elf[le32(&elf[shoff + le32(&sh[24]) * shentsize + 16u])];
+		for (j = 0u; j < le32(&sh[20]) / le32(&sh[36]); j++, sym += le32(&sh[36])) {
+			uint32_t  shndx = le16(&sym[14]);
+			uint8_t   type  = sym[12] & 0x0Fu;
+			symbol_t *s;
+
+			if (le32(&sym[8]) == 0u || (type != STT_FUNC && type != STT_OBJECT) || shndx >= SHN_LORESERVE
+			    || shndx >= shnum) {
+				continue;
+			}
+			cat = output_category((const char *)&shstr[le32(&elf[shoff + shndx * shentsize])]);
+			if (cat == CAT_NONE) {
+				continue;
+			}
+			if ((num_symbols & 255u) == 0u) {
+				symbols = xrealloc(symbols, (num_symbols + 256u) * sizeof(*symbols));
+			}
+			s         = &symbols[num_symbols++];
+			s->name   = strdup((const char *)&str[le32(sym)]);
+			s->size   = le32(&sym[8]);
+			s->cat    = cat;
+			snprintf(s->object, sizeof(s->object), "%s", symbol_object(le32(&sym[4])));
+		}
+	}
+	free(elf);
+	return 0;
+}
+
+static int compare_objects(const void *a, const void *b)
+{
+	const object_t *x = a, *y = b;
+	uint32_t        fx = usage_of(x->size, KIND_FLASH) + usage_of(x->size, KIND_RAM);
+	uint32_t        fy = usage_of(y->size, KIND_FLASH) + usage_of(y->size, KIND_RAM);
+
+	if (fx != fy) {
+		return fx < fy ? 1 : -1;
+	}
+	return strcmp(x->name, y->name);
+}
+
+static int compare_symbols(const void *a, const void *b)
+{
+	const symbol_t *x = a, *y = b;
+
+	if (x->size != y->size) {
+		return x->size < y->size ? 1 : -1;
+	}
+	return strcmp(x->name, y->name);
+}
+
+static void print_row(const char *name, const uint32_t *size)
+{
+	printf("%-56s %6u %6u %6u %6u %6u %6u\n",
+	       name,
+	       size[CAT_TEXT],
+	       size[CAT_RODATA],
+	       size[CAT_DATA],
+	       size[CAT_BSS],
+	       usage_of(size, KIND_FLASH),
+	       usage_of(size, KIND_RAM));
+}
+
+static void print_header(const char *first)
+{
+	printf("%-56s %6s %6s %6s %6s %6s %6s\n", first, "text", "rodata", "data", "bss", "flash", "ram");
+}
+
+static int read_baseline(const char *path, object_t **list, unsigned *count)
+{
+	char     line[LINE_MAX_LEN], name[NAME_MAX_LEN];
+	uint32_t size[CAT_COUNT];
+	unsigned i;
+	FILE *   f = fopen(path, "r");
+
+	if (!f) {
+		return -1;
+	}
+	*list  = NULL;
+	*count = 0u;
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#'
+		    || sscanf(line, "%127s %u %u %u %u", name, &size[0], &size[1], &size[2], &size[3]) != 1 + CAT_COUNT) {
+			continue;
+		}
+		if ((*count & 63u) == 0u) {
+			*list = xrealloc(*list, (*count + 64u) * sizeof(**list));
+		}
+		i = find_object(*list, count, name, 1);
+		memcpy((*list)[i].size, size, sizeof(size));
+	}
+	fclose(f);
+	return 0;
+}
+
+static int write_baseline(const char *path)
+{
+	unsigned i;
+	FILE *   f = fopen(path, "w");
+
+	if (!f) {
+		return -1;
+	}
+	fprintf(f, "# membudget baseline: object text rodata data bss\n");
+	for (i = 0u; i < num_objects; i++) {
+		fprintf(f,
+		        "%s %u %u %u %u\n",
+		        objects[i].name,
+		        objects[i].size[CAT_TEXT],
+		        objects[i].size[CAT_RODATA],
+		        objects[i].size[CAT_DATA],
+		        objects[i].size[CAT_BSS]);
+	}
+	return fclose(f);
+}
+
+static void print_delta(const char *name, const uint32_t *now, const uint32_t *then)
+{
+	long     d[KIND_COUNT];
+	unsigned k, changed = 0u;
+
+	for (k = 0u; k < KIND_COUNT; k++) {
+		d[k] = (long)usage_of(now, k) - (long)usage_of(then, k);
+		changed |= d[k] != 0;
+	}
+	if (changed) {
+		printf("%-56s %+6ld %+6ld %+6ld %+6ld %+6ld %+6ld\n", name, d[0], d[1], d[2], d[3], d[4], d[5]);
+	}
+}
+
+/* Prints the per object differences to the baseline */
+static void diff_baseline(const object_t *base, unsigned count, const uint32_t *total)
+{
+	static const uint32_t none[CAT_COUNT];
+	uint32_t              base_total[CAT_COUNT] = {0};
+	unsigned              i, k;
+
+	for (i = 0u; i < count; i++) {
+		for (k = 0u; k < CAT_COUNT; k++) {
+			base_total[k] += base[i].size[k];
+		}
+	}
+	print_header("change to baseline");
+	for (i = 0u; i < num_objects; i++) {
+		unsigned j = find_object((object_t *)base, &count, objects[i].name, 0);
+
+		print_delta(objects[i].name, objects[i].size, j < count ? base[j].size : none);
+	}
+	for (i = 0u; i < count; i++) {
+		if (find_object(objects, &num_objects, base[i].name, 0) == num_objects) {
+			print_delta(base[i].name, none, base[i].size);
+		}
+	}
+	print_delta("total", total, base_total);
+	printf("\n");
+}
+
+/*============================================================================
+static int check_budget(const char *path, const uint32_t *total)
+------------------------------------------------------------------------------
+Purpose: Checks the usage against the limits of a budget file.
+Input  : budget file; total usage per category
+Output : number of exceeded limits, -1 if the file is invalid
+Notes  : A limit for an object that is not linked in is met.
+============================================================================*/
+static int check_budget(const char *path, const uint32_t *total)
+{
+	char            line[LINE_MAX_LEN], scope[NAME_MAX_LEN], kind_s[16];
+	unsigned long   limit;
+	unsigned        kind, i, lineno = 0u;
+	int             exceeded = 0;
+	const uint32_t *size;
+	uint32_t        used;
+	FILE *          f = fopen(path, "r");
+
+	if (!f) {
+		fprintf(stderr, "membudget: %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		char *comment = strchr(line, '#');
+
+		lineno++;
+		if (comment) {
+			*comment = '\0';
+		}
+		if (sscanf(line, "%127s", scope) != 1) {
+			continue;
+		}
+		if (sscanf(line, "%127s %15s %lu", scope, kind_s, &limit) != 3) {
+			fprintf(stderr, "membudget: %s:%u: expected: scope kind limit\n", path, lineno);
+			fclose(f);
+			return -1;
+		}
+		for (kind = 0u; kind < KIND_COUNT && strcmp(kind_s, kind_names[kind]) != 0; kind++) {
+		}
+		if (kind == KIND_COUNT) {
+			fprintf(stderr, "membudget: %s:%u: unknown kind %s\n", path, lineno, kind_s);
+			fclose(f);
+			return -1;
+		}
+		if (strcmp(scope, "total") == 0) {
+			size = total;
+		} else if ((i = find_object(objects, &num_objects, scope, 0)) < num_objects) {
+			size = objects[i].size;
+		} else {
+			continue;
+		}
+		used = usage_of(size, kind);
+		if (used > limit) {
+			printf("over budget: %s %s %u > %lu (+%lu)\n", scope, kind_s, used, limit, used - limit);
+			exceeded++;
+		}
+	}
+	fclose(f);
+	return exceeded;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: membudget [-m map] [-b budget] [-d baseline] [-w baseline] [-n symbols] [-q] elf\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *map_path = NULL, *budget_path = NULL, *base_path = NULL, *write_path = NULL;
+	char        map_buf[LINE_MAX_LEN];
+	uint32_t    total[CAT_COUNT] = {0};
+	object_t *  base;
+	unsigned    base_count, i, k;
+	int         opt, list = 20, quiet = 0, exceeded = 0;
+
+	while ((opt = getopt(argc, argv, "m:b:d:w:n:q")) != -1) {
+		switch (opt) {
+		case 'm':
+			map_path = optarg;
+			break;
+		case 'b':
+			budget_path = optarg;
+			break;
+		case 'd':
+			base_path = optarg;
+			break;
+		case 'w':
+			write_path = optarg;
+			break;
+		case 'n':
+			list = atoi(optarg);
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1) {
+		usage();
+	}
+	if (!map_path) {
+		size_t len = strlen(argv[optind]);
+
+		if (ends_with(argv[optind], ".elf")) {
+			len -= 4u;
+		}
+		snprintf(map_buf, sizeof(map_buf), "%.*s.map", (int)len, argv[optind]);
+		map_path = map_buf;
+	}
+
+	errno = 0;
+	if (read_map(map_path) != 0) {
+		fprintf(stderr, "membudget: %s: %s\n", map_path, errno ? strerror(errno) : "no memory map");
+		return 2;
+	}
+	if (read_elf(argv[optind]) != 0) {
+		fprintf(stderr, "membudget: %s: %s\n", argv[optind], strerror(errno));
+		return 2;
+	}
+
+	qsort(objects, num_objects, sizeof(*objects), compare_objects);
+	for (i = 0u; i < num_objects; i++) {
+		for (k = 0u; k < CAT_COUNT; k++) {
+			total[k] += objects[i].size[k];
+		}
+	}
+	if (memcmp(total, elf_size, sizeof(total)) != 0) {
+		fprintf(stderr, "membudget: warning: %s does not match the sections of %s\n", map_path, argv[optind]);
+	}
+
+	if (!quiet) {
+		print_header("object");
+		for (i = 0u; i < num_objects; i++) {
+			print_row(objects[i].name, objects[i].size);
+		}
+		print_row("total", total);
+		printf("\n");
+	}
+
+	if (!quiet && list > 0 && num_symbols) {
+		qsort(symbols, num_symbols, sizeof(*symbols), compare_symbols);
+		printf("%6s %-6s %-40s %s\n", "size", "kind", "symbol", "object");
+		for (i = 0u; i < num_symbols && i < (unsigned)list; i++) {
+			printf("%6u %-6s %-40s %s\n",
+			       symbols[i].size,
+			       kind_names[symbols[i].cat],
+			       symbols[i].name,
+			       symbols[i].object);
+		}
+		printf("\n");
+	}
+
+	if (base_path) {
+		if (read_baseline(base_path, &base, &base_count) != 0) {
+			fprintf(stderr, "membudget: %s: %s\n", base_path, strerror(errno));
+			return 2;
+		}
+		diff_baseline(base, base_count, total);
+		free(base);
+	}
+
+	printf("flash %u bytes, ram %u bytes\n", usage_of(total, KIND_FLASH), usage_of(total, KIND_RAM));
+
+	if (write_path && write_baseline(write_path) != 0) {
+		fprintf(stderr, "membudget: %s: %s\n", write_path, strerror(errno));
+		return 2;
+	}
+	if (budget_path) {
+		exceeded = check_budget(budget_path, total);
+		if (exceeded < 0) {
+			return 2;
+		}
+	}
+	return exceeded ? 1 : 0;
+}
@@ -0,0 +1,569 @@
+/*============================================================================
+Filename : stackusage.c
+Project : Attiny814Code host tools
+Purpose : stackusage, worst case stack depth of main() and of every
+          interrupt handler of an AVR firmware. The call graph and the
+          frame of each function come from the disassembly (avr-objdump -d
+          or the .lss listing of the build), so the QTouch libraries are
+          covered as well. GCC -fstack-usage files raise the frame of a
+          function where they report more and flag dynamic frames.
+
+Usage   : stackusage [-i indirect] [-u su_dir] [-l vector] [-r reserve] [-f]
+                     listing
+
+          -i  targets of the indirect calls, see read_indirect()
+          -u  directory searched for .su files, may be repeated
+          -l  interrupt vector (number or name) running at CPUINT level 1
+              and preempting the other handlers, may be repeated
+          -r  bytes reserved for the stack, exit status 1 when the worst
+              case exceeds it
+          -f  list every function with its frame and depth
+
+          worst case = main + deepest level 0 handler + deepest level 1
+          handler. An interrupt costs its frame plus the 2 byte return
+          address. Unresolved indirect calls and dynamic frames make a
+          depth a lower bound, marked with '+'.
+============================================================================*/
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <ftw.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+#define LINE_MAX_LEN 1024u
+#define NAME_MAX_LEN 96u
+
+/* return address of call, rcall and interrupts on devices up to 128 KB */
+#define RETURN_ADDRESS_SIZE 2u
+
+#define NUM_VECTORS 26u
+
+/* depth search state */
+#define STATE_NEW 0u
+#define STATE_ACTIVE 1u
+#define STATE_DONE 2u
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+typedef struct {
+	char     name[NAME_MAX_LEN];
+	unsigned addr;
+	unsigned frame;      /* pushes and frame allocation */
+	unsigned su_frame;   /* from -fstack-usage, 0 if none */
+	uint8_t  indirect;  /* unresolved icall or ijmp */
+	uint8_t  unbounded; /* indirect, dynamic frame or recursion below */
+	uint8_t  state;
+	unsigned depth;   /* worst case including callees */
+	int      deepest; /* callee on the worst case path, -1 for none */
+} function_t;
+
+typedef struct {
+	int     caller;
+	char    target[NAME_MAX_LEN];
+	int     callee;
+	uint8_t tail; /* jump, no return address */
+} call_t;
+
+/*----------------------------------------------------------------------------
+ *     global variables
+ *----------------------------------------------------------------------------*/
+/* ATtiny814 interrupt vectors, see the device datasheet */
+static const char *vector_names[NUM_VECTORS] = {
+    "RESET",      "CRCSCAN_NMI", "BOD_VLM",    "PORTA_PORT", "PORTB_PORT", "",           "RTC_CNT",
+    "RTC_PIT",    "TCA0_OVF",    "TCA0_HUNF",  "TCA0_CMP0",  "TCA0_CMP1",  "TCA0_CMP2",  "TCB0_INT",
+    "TCD0_OVF",   "TCD0_TRIG",   "AC0_AC",     "ADC0_RESRDY", "ADC0_WCOMP", "TWI0_TWIS", "TWI0_TWIM",
+    "SPI0_INT",   "USART0_RXC",  "USART0_DRE", "USART0_TXC", "NVMCTRL_EE",
+};
+
+static function_t *functions;
+static unsigned    num_functions;
+static call_t *    calls;
+static unsigned    num_calls;
+
+static uint8_t level1[NUM_VECTORS];
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *----------------------------------------------------------------------------*/
+
+static void *xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		fprintf(stderr, "stackusage: out of memory\n");
+		exit(2);
+	}
+	return p;
+}
+
+static int find_function(const char *name)
+{
+	unsigned i;
+
+	for (i = 0u; i < num_functions; i++) {
+		if (strcmp(functions[i].name, name) == 0) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+static function_t *add_function(const char *name, unsigned addr)
+{
+	function_t *f;
+
+	if ((num_functions & 63u) == 0u) {
+		functions = xrealloc(functions, (num_functions + 64u) * sizeof(*functions));
+	}
+	f = &functions[num_functions++];
+	memset(f, 0, sizeof(*f));
+	snprintf(f->name, sizeof(f->name), "%s", name);
+	f->addr    = addr;
+	f->deepest = -1;
+	return f;
+}
+
+static void add_call(int caller, const char *target, uint8_t tail)
+{
+	unsigned i;
+
+	for (i = 0u; i < num_calls; i++) {
+		if (calls[i].caller == caller && strcmp(calls[i].target, target) == 0) {
+			calls[i].tail &= tail;
+			return;
+		}
+	}
+	if ((num_calls & 255u) == 0u) {
+		calls = xrealloc(calls, (num_calls + 256u) * sizeof(*calls));
+	}
+	calls[num_calls].caller = caller;
+	snprintf(calls[num_calls].target, sizeof(calls[num_calls].target), "%s", target);
+	calls[num_calls].tail = tail;
+	num_calls++;
+}
+
+/* Vector number of __vector_N, -1 for other functions */
+static int vector_number(const char *name)
+{
+	char *end;
+	long  n;
+
+	if (strncmp(name, "__vector_", 9u) != 0) {
+		return -1;
+	}
+	n = strtol(name + 9, &end, 10);
+	return *end || n < 0 || n >= (long)NUM_VECTORS ? -1 : (int)n;
+}
+
+/* Function starting at addr, -1 for none. rcall wraps around on devices
+ * with up to 8 KB flash, objdump prints such targets outside the flash. */
+static int function_at(unsigned long addr)
+{
+	unsigned long mask;
+	unsigned      i;
+
+	for (mask = 0xFFFFFFFFul; mask >= 0x7FFu; mask >>= 1u) {
+		for (i = 0u; i < num_functions; i++) {
+			if (functions[i].addr == (addr & mask)) {
+				return (int)i;
+			}
+		}
+	}
+	return -1;
+}
+
+/* Target of a branch from the "; 0x91c <AC_0_init>" comment, as name or as
+ * "@address" if objdump shows no symbol. Returns 0 for branches inside the
+ * function itself. */
+static int branch_target(const char *comment, const char *self, char *target)
+{
+	const char *open = strchr(comment, '<');
+	const char *close;
+	size_t      len = strlen(self);
+
+	if (!open || (close = strchr(open, '>')) == NULL) {
+		return 0;
+	}
+	/* <self+0x1a>, or a local label of the crt code */
+	if (open[1] == '.' || (strncmp(open + 1, self, len) == 0 && (open[len + 1] == '>' || open[len + 1] == '+'))) {
+		return 0;
+	}
+	len = (size_t)(close - open - 1);
+	if (memchr(open + 1, '+', len)) {
+		snprintf(target, NAME_MAX_LEN, "@%lx", strtoul(strstr(comment, "0x") ? strstr(comment, "0x") : "0", NULL, 16));
+		return 1;
+	}
+	if (len >= NAME_MAX_LEN) {
+		len = NAME_MAX_LEN - 1u;
+	}
+	memcpy(target, open + 1, len);
+	target[len] = '\0';
+	return 1;
+}
+
+/*============================================================================
+static int read_listing(const char *path)
+------------------------------------------------------------------------------
+Purpose: Builds the functions and calls from an avr-objdump listing.
+Input  : avr-objdump -d or -S output
+Output : 0, -1 if the file can not be read
+Notes  : The frame of a function is the sum of its pushes, "rcall .+0"
+         (2 bytes each) and the "sbiw/subi r28, n" between reading and
+         writing back SP. Jumps to other functions are tail calls, icall
+         and ijmp are left to read_indirect().
+============================================================================*/
+static int read_listing(const char *path)
+{
+	char        line[LINE_MAX_LEN], name[NAME_MAX_LEN], target[NAME_MAX_LEN];
+	char *      field[5];
+	function_t *f        = NULL;
+	int         in_frame = 0;
+	unsigned    n, value;
+	FILE *      file = fopen(path, "r");
+
+	if (!file) {
+		return -1;
+	}
+	while (fgets(line, sizeof(line), file)) {
+		char *p = line, *tab;
+
+		/* "0000032c <main>:" */
+		if (sscanf(line, "%x <%95[^>]>:", &value, name) == 2 && line[0] != ' ') {
+			if (name[0] != '.') {
+				f        = add_function(name, value);
+				in_frame = 0;
+			}
+			continue;
+		}
+		/* "     1e0:\t9d d3       \trcall\t.+1850   \t; 0x91c <AC_0_init>" */
+		if (!f || line[0] != ' ' || (tab = strchr(line, '\t')) == NULL || tab[-1] != ':') {
+			continue;
+		}
+		for (n = 0u; n < 5u; n++) {
+			field[n] = p;
+			if (p && (p = strchr(p, '\t')) != NULL) {
+				*p++ = '\0';
+			}
+		}
+		if (!field[2]) {
+			continue;
+		}
+		strtok(field[2], " \r\n");
+		if (!field[3]) {
+			field[3] = "";
+		}
+		if (!field[4]) {
+			field[4] = "";
+		}
+
+		if (strcmp(field[2], "push") == 0) {
+			f->frame++;
+		} else if (strcmp(field[2], "rcall") == 0 || strcmp(field[2], "call") == 0) {
+			if (branch_target(field[4], f->name, target)) {
+				add_call((int)(f - functions), target, 0u);
+			} else if (strncmp(field[3], ".+0", 3u) == 0) {
+				f->frame += RETURN_ADDRESS_SIZE;
+			}
+		} else if (strcmp(field[2], "rjmp") == 0 || strcmp(field[2], "jmp") == 0) {
+			if (branch_target(field[4], f->name, target) && strcmp(f->name, "__vectors") != 0) {
+				add_call((int)(f - functions), target, 1u);
+			}
+		} else if (strcmp(field[2], "icall") == 0 || strcmp(field[2], "ijmp") == 0) {
+			f->indirect = 1u;
+		} else if (strcmp(field[2], "in") == 0 && strncmp(field[3], "r28, 0x3d", 9u) == 0) {
+			in_frame = 1;
+		} else if (strcmp(field[2], "out") == 0 && strncmp(field[3], "0x3d", 4u) == 0) {
+			in_frame = 0;
+		} else if (in_frame && (strcmp(field[2], "sbiw") == 0 || strcmp(field[2], "subi") == 0)
+		           && sscanf(field[3], "r28, 0x%x", &value) == 1 && value < 0x80u) {
+			f->frame += value;
+		}
+	}
+	fclose(file);
+	return 0;
+}
+
+/*============================================================================
+static int read_indirect(const char *path)
+------------------------------------------------------------------------------
+Purpose: Adds the targets of indirect calls, which the disassembly does not
+         show.
+Input  : file with one "caller callee [callee ...]" line per function
+         calling through pointers, '#' starts a comment
+Output : 0, -1 if the file can not be read
+Notes  : Each listed callee is counted as a call with return address.
+============================================================================*/
+static int read_indirect(const char *path)
+{
+	char  line[LINE_MAX_LEN];
+	char *name;
+	int   caller;
+	FILE *f = fopen(path, "r");
+
+	if (!f) {
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if ((name = strchr(line, '#')) != NULL) {
+			*name = '\0';
+		}
+		if ((name = strtok(line, " \t\r\n")) == NULL) {
+			continue;
+		}
+		caller = find_function(name);
+		if (caller < 0) {
+			fprintf(stderr, "stackusage: %s: no function %s\n", path, name);
+			continue;
+		}
+		functions[caller].indirect = 0u;
+		while ((name = strtok(NULL, " \t\r\n")) != NULL) {
+			if (find_function(name) < 0) {
+				fprintf(stderr, "stackusage: %s: no function %s\n", path, name);
+			}
+			add_call(caller, name, 0u);
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+/* "main.c:123:6:RTC_CallBack\t12\tstatic" */
+static int read_su(const char *path, const struct stat *sb, int type, struct FTW *ftw)
+{
+	char     line[LINE_MAX_LEN], qualifier[32];
+	char *   name;
+	unsigned size;
+	int      i;
+	FILE *   f;
+	size_t   len = strlen(path);
+
+	(void)sb;
+	(void)ftw;
+	if (type != FTW_F || len < 3u || strcmp(path + len - 3u, ".su") != 0 || (f = fopen(path, "r")) == NULL) {
+		return 0;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		char *tab = strchr(line, '\t');
+
+		if (!tab || sscanf(tab, "%u %31s", &size, qualifier) != 2) {
+			continue;
+		}
+		*tab = '\0';
+		name = strrchr(line, ':');
+		name = name ? name + 1 : line;
+		i    = find_function(name);
+		if (i < 0) {
+			continue;
+		}
+		if (size > functions[i].su_frame) {
+			functions[i].su_frame = size;
+		}
+		if (strncmp(qualifier, "dynamic", 7u) == 0 && strcmp(qualifier, "dynamic,bounded") != 0) {
+			functions[i].unbounded = 1u;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+/*============================================================================
+static unsigned depth_of(int i)
+------------------------------------------------------------------------------
+Purpose: Worst case stack depth of a function and its callees.
+Input  : function index
+Output : bytes, not counting the return address of the call to it
+Notes  : Recursion is reported and cut, the depth is then a lower bound.
+============================================================================*/
+static unsigned depth_of(int i)
+{
+	function_t *f = &functions[i];
+	unsigned    c, d;
+
+	if (f->state == STATE_DONE) {
+		return f->depth;
+	}
+	if (f->state == STATE_ACTIVE) {
+		fprintf(stderr, "stackusage: recursion through %s\n", f->name);
+		f->unbounded = 1u;
+		return 0u;
+	}
+	f->state = STATE_ACTIVE;
+	f->depth = 0u;
+	f->unbounded |= f->indirect;
+	for (c = 0u; c < num_calls; c++) {
+		if (calls[c].caller != i || calls[c].callee < 0) {
+			continue;
+		}
+		d = depth_of(calls[c].callee) + (calls[c].tail ? 0u : RETURN_ADDRESS_SIZE);
+		if (functions[calls[c].callee].unbounded) {
+			f->unbounded = 1u;
+		}
+		if (d > f->depth) {
+			f->depth   = d;
+			f->deepest = calls[c].callee;
+		}
+	}
+	f->depth += f->frame > f->su_frame ? f->frame : f->su_frame;
+	f->state = STATE_DONE;
+	return f->depth;
+}
+
+static void print_entry(int i, unsigned extra)
+{
+	const function_t *f = &functions[i];
+	int               v = vector_number(f->name);
+	char              label[NAME_MAX_LEN + 16u];
+	const char *      sep = "";
+
+	snprintf(label, sizeof(label), "%s%s%s%s", f->name, v >= 0 ? " (" : "", v >= 0 ? vector_names[v] : "", v >= 0 ? ")" : "");
+	printf("%-32s %5u%-1s  ", label, f->depth + extra, f->unbounded ? "+" : "");
+	for (; i >= 0; i = functions[i].deepest) {
+		printf("%s%s", sep, functions[i].name);
+		sep = " > ";
+	}
+	printf("\n");
+}
+
+static int parse_vector(const char *arg)
+{
+	char *   end;
+	long     n = strtol(arg, &end, 0);
+	unsigned v;
+
+	if (*arg && !*end && n >= 0 && n < (long)NUM_VECTORS) {
+		return (int)n;
+	}
+	for (v = 0u; v < NUM_VECTORS; v++) {
+		if (strcmp(arg, vector_names[v]) == 0
+		    || (strncmp(arg, vector_names[v], strlen(vector_names[v])) == 0
+		        && strcmp(arg + strlen(vector_names[v]), "_vect") == 0)) {
+			return (int)v;
+		}
+	}
+	return -1;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: stackusage [-i indirect] [-u su_dir] [-l vector] [-r reserve] [-f] listing\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *su_dirs[16], *indirect = NULL;
+	unsigned    num_su = 0u, c, worst, isr[2] = {0u, 0u};
+	int         opt, i, v, m, list = 0, unbounded = 0, isr_max[2] = {-1, -1};
+	long        reserve = -1;
+
+	while ((opt = getopt(argc, argv, "i:u:l:r:f")) != -1) {
+		switch (opt) {
+		case 'i':
+			indirect = optarg;
+			break;
+		case 'u':
+			if (num_su < sizeof(su_dirs) / sizeof(su_dirs[0])) {
+				su_dirs[num_su++] = optarg;
+			}
+			break;
+		case 'l':
+			v = parse_vector(optarg);
+			if (v < 0) {
+				fprintf(stderr, "stackusage: unknown vector %s\n", optarg);
+				return 2;
+			}
+			level1[v] = 1u;
+			break;
+		case 'r':
+			reserve = strtol(optarg, NULL, 0);
+			break;
+		case 'f':
+			list = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1) {
+		usage();
+	}
+
+	if (read_listing(argv[optind]) != 0) {
+		perror(argv[optind]);
+		return 2;
+	}
+	m = find_function("main");
+	if (m < 0) {
+		fprintf(stderr, "stackusage: %s: no main()\n", argv[optind]);
+		return 2;
+	}
+	if (indirect && read_indirect(indirect) != 0) {
+		perror(indirect);
+		return 2;
+	}
+	for (c = 0u; c < num_su; c++) {
+		if (nftw(su_dirs[c], read_su, 16, FTW_PHYS) != 0) {
+			perror(su_dirs[c]);
+			return 2;
+		}
+	}
+	for (c = 0u; c < num_calls; c++) {
+		calls[c].callee = calls[c].target[0] == '@' ? function_at(strtoul(&calls[c].target[1], NULL, 16))
+		                                            : find_function(calls[c].target);
+	}
+
+	printf("%-32s %6s  %s\n", "entry", "bytes", "deepest path");
+	depth_of(m);
+	print_entry(m, 0u);
+	unbounded |= functions[m].unbounded;
+	for (i = 0; i < (int)num_functions; i++) {
+		v = vector_number(functions[i].name);
+		if (v < 0) {
+			continue;
+		}
+		depth_of(i);
+		print_entry(i, RETURN_ADDRESS_SIZE);
+		if (functions[i].depth + RETURN_ADDRESS_SIZE > isr[level1[v]]) {
+			isr[level1[v]]     = functions[i].depth + RETURN_ADDRESS_SIZE;
+			isr_max[level1[v]] = i;
+		}
+		unbounded |= functions[i].unbounded;
+	}
+
+	if (list) {
+		printf("\n%-40s %5s %5s %6s\n", "function", "frame", "su", "depth");
+		for (i = 0; i < (int)num_functions; i++) {
+			depth_of(i);
+			printf("%-40s %5u %5u %5u%s\n",
+			       functions[i].name,
+			       functions[i].frame,
+			       functions[i].su_frame,
+			       functions[i].depth,
+			       functions[i].unbounded ? "+" : "");
+		}
+	}
+
+	worst = functions[m].depth + isr[0] + isr[1];
+	printf("\nworst case %u%s bytes: main %u", worst, unbounded ? "+" : "", functions[m].depth);
+	for (c = 0u; c < 2u; c++) {
+		if (isr_max[c] >= 0) {
+			printf(" + %s %u", functions[isr_max[c]].name, isr[c]);
+		}
+	}
+	printf("\n");
+
+	if (reserve >= 0 && worst > (unsigned long)reserve) {
+		printf("over budget: stack %u > %ld (+%lu)\n", worst, reserve, worst - (unsigned long)reserve);
+		return 1;
+	}
+	return 0;
+}
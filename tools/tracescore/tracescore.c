@@ -0,0 +1,767 @@
+/*============================================================================
+Filename : tracescore.c
+Project : Attiny814Code host tools
+Purpose : Replays labeled sensor traces through the touch detection core
+          and the gesture engine (src/touch_detect.c and src/gesture.c of
+          the tree it is built from) and scores the gestures the valve
+          acts on against the labeled taps: precision, recall, median and
+          p99 tap to gesture latency, convergence of the edge threshold
+          after a noise burst, host time per sample. A model of the valve
+          of main.c, with the lock of the long-press and the auto close,
+          freezes the edges after each pulse. The gesture engine is also
+          timed apart from the core.
+
+Usage   : tracescore [-c channel] [-k threshold] [-P precision] [-R recall] [-C ms] [-v] trace...
+          tracescore ... -l corpus.txt
+
+          -c  sensor channel of the trace (default 0)
+          -k  key threshold of the key module model (default 100)
+          -P  exit with 1 when the total precision is below
+          -R  exit with 1 when the total recall is below
+          -C  exit with 1 when a threshold converges slower, in ms
+          -l  corpus index: one trace file per line, relative to the index
+          -v  print every actuation
+
+Trace   : CSV of dsdecode with label comments. Lines starting with '#'
+          carry the labels, the first other line is the CSV header; the
+          timestamp and ch<N>_signal, ch<N>_reference columns are used.
+          The key state for the fusion stage (TOUCH_FUSION) comes from a
+          model of the qtlib key module on the same delta, with the key
+          defaults of touch.h.
+
+          # scenario <name>       free text, shown in the report
+          # tap <first> <last>    finger on from tick first to tick last
+          # burst <first> <last>  noise burst from tick first to tick last
+
+          Timestamps count RTC ticks (RTC_WAKE_UP_TIME ms) and may wrap.
+          A tap gesture between first and last + TAP_TOLERANCE ticks plus
+          doubleTapWindow is a hit of the tap, the latency counts from the
+          end of the tap. A double-tap at the release of a tap also hits
+          the tap before, when it ended within that window; one whose
+          second press is not labeled counts as the tap of the first.
+          Other gestures acted on, long-presses included, are false
+          positives; taps without a hit false negatives, also those the
+          lock ignored. The convergence time runs from the end of the
+          burst to the first sample with the edge threshold within
+          CONVERGE_MARGIN of its value before the burst.
+
+          The host time per sample only ranks changes of the core against
+          each other; cycles on the ATtiny814 come from the simavr harness.
+============================================================================*/
+
+#define _DEFAULT_SOURCE
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gesture.h"
+#include "touch_detect.h"
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+#define LINE_MAX_LEN 1024u
+#define NAME_MAX_LEN 64u
+#define PATH_MAX_LEN 512u
+#define MAX_COLUMNS 64u
+#define MAX_TAPS 1024u
+#define MAX_LATENCIES 65536u
+#define MAX_SAMPLES 1000000u
+
+/* ticks after the end of a tap in which an actuation still counts */
+#define TAP_TOLERANCE 4u
+
+/* RTC ticks of a gesture timing in ms, as gesture.c */
+#define GESTURE_TICKS(MS) ((uint32_t)(MS) / RTC_WAKE_UP_TIME)
+
+/* valve auto close, autoCloseTime and timedRunTime of main.c */
+#define AUTO_CLOSE_TICKS (3u * 60000u / RTC_WAKE_UP_TIME)
+#define TIMED_RUN_TICKS (30u * 1000u / RTC_WAKE_UP_TIME)
+
+/* threshold counts above the value before the burst that count as converged */
+#define CONVERGE_MARGIN 2u
+
+/* key module model: hysteresis in % of the key threshold and the samples
+ * of debounce, KEY_0_PARAMS and DEF_TOUCH_DET_INT of touch.h */
+#define KEY_HYSTERESIS 25
+#define KEY_DET_INT 4u
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+typedef struct {
+	uint32_t first, last;
+	int      hit;
+} tap_t;
+
+typedef struct {
+	uint32_t tick;
+	uint16_t steps; /* RTC ticks since the previous sample */
+	uint16_t signal, reference;
+} sample_t;
+
+typedef struct {
+	uint32_t first, last;
+	int      valid;
+} burst_t;
+
+/* Gesture the valve acted on */
+typedef struct {
+	uint32_t tick;
+	uint8_t  gesture;
+} action_t;
+
+/* Valve of main.c */
+typedef struct {
+	uint8_t  on, locked, timed;
+	uint32_t on_ticks;
+} valve_t;
+
+typedef struct {
+	unsigned taps, hits, false_pos, samples;
+	unsigned gestures[4]; /* by GESTURE_ code */
+	double   ns, gesture_ns;
+	double   converge_ms; /* -1 without a burst, HUGE_VAL if it never did */
+} score_t;
+
+/* Parameters and adaptive state of the core at program start */
+typedef struct {
+	uint16_t threshold, level, min, max, on_min, on_max, freeze;
+	uint8_t  factor, attack, release;
+} defaults_t;
+
+/*----------------------------------------------------------------------------
+ *     global variables
+ *----------------------------------------------------------------------------*/
+static defaults_t defaults;
+static unsigned   channel;
+static int16_t    key_threshold = 100; /* KEY_0_PARAMS */
+static int        verbose;
+
+static tap_t    taps[MAX_TAPS];
+static unsigned num_taps;
+static burst_t  burst;
+static double   latencies[MAX_LATENCIES];
+static unsigned num_latencies;
+static sample_t samples[MAX_SAMPLES];
+static unsigned num_samples;
+static uint8_t  edges[MAX_SAMPLES];   /* of the replay */
+static uint8_t  results[MAX_SAMPLES]; /* of the replay */
+static uint8_t  helds[MAX_SAMPLES];   /* of the replay */
+static uint8_t  keys[MAX_SAMPLES];    /* of the key module model */
+static valve_t  valve;
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *----------------------------------------------------------------------------*/
+
+static void save_defaults(void)
+{
+	defaults.threshold = STRONG_EDGE_THRESHOLD;
+	defaults.level     = noiseLevel;
+	defaults.min       = edgeThresholdMin;
+	defaults.max       = edgeThresholdMax;
+	defaults.on_min    = fingerOnMinTime;
+	defaults.on_max    = fingerOnMaxTime;
+	defaults.freeze    = freezeTime;
+	defaults.factor    = noiseFactor;
+	defaults.attack    = noiseAttackShift;
+	defaults.release   = noiseReleaseShift;
+}
+
+/* Power-on state of the core for the next trace */
+static void restart(void)
+{
+	STRONG_EDGE_THRESHOLD = defaults.threshold;
+	noiseLevel            = defaults.level;
+	edgeThresholdMin      = defaults.min;
+	edgeThresholdMax      = defaults.max;
+	fingerOnMinTime       = defaults.on_min;
+	fingerOnMaxTime       = defaults.on_max;
+	freezeTime            = defaults.freeze;
+	noiseFactor           = defaults.factor;
+	noiseAttackShift      = defaults.attack;
+	noiseReleaseShift     = defaults.release;
+	edgeDetectFreeze      = 0u;
+	edgeFreezeCnt         = 0u;
+	touch_detect_reset();
+	gesture_reset();
+	memset(&valve, 0, sizeof(valve));
+}
+
+static double now_ns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+/* Index of a CSV column, -1 if missing */
+static int find_column(char columns[][NAME_MAX_LEN], unsigned count, const char *name)
+{
+	unsigned i;
+
+	for (i = 0u; i < count; i++) {
+		if (strcmp(columns[i], name) == 0) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+/* Splits a CSV line in place, returns the field count */
+static unsigned split(char *line, char **fields, unsigned max)
+{
+	unsigned count = 0u;
+
+	line[strcspn(line, "\r\n")] = '\0';
+	while (count < max) {
+		fields[count++] = line;
+		line            = strchr(line, ',');
+		if (!line) {
+			break;
+		}
+		*line++ = '\0';
+	}
+	return count;
+}
+
+/* Hit of a tap by a gesture at the given tick */
+static void hit(const char *path, tap_t *tap, uint32_t tick, score_t *score)
+{
+	tap->hit = 1;
+	score->hits++;
+	if (num_latencies < MAX_LATENCIES) {
+		latencies[num_latencies++] = (tick > tap->last ? tick - tap->last : 0u) * (double)RTC_WAKE_UP_TIME;
+	}
+	if (verbose) {
+		printf("%s: tick %lu: tap %lu..%lu\n", path, (unsigned long)tick, (unsigned long)tap->first,
+		       (unsigned long)tap->last);
+	}
+}
+
+/* Matches a gesture acted on with the labeled taps. A single tap comes
+ * doubleTapWindow after its release, a double-tap at the release of its
+ * second press and hits the first one as well; a double-tap whose second
+ * press is not labeled hits the first. */
+static void score_action(const char *path, const action_t *act, score_t *score)
+{
+	uint32_t window = TAP_TOLERANCE + GESTURE_TICKS(doubleTapWindow);
+	unsigned i, match = num_taps;
+
+	for (i = 0u; act->gesture != GESTURE_LONG_PRESS && i < num_taps; i++) {
+		if (taps[i].hit || act->tick < taps[i].first) {
+			continue;
+		}
+		if (act->gesture == GESTURE_TAP && act->tick <= taps[i].last + window) {
+			match = i;
+			break;
+		}
+		if (act->gesture == GESTURE_DOUBLE_TAP && act->tick <= taps[i].last + TAP_TOLERANCE) {
+			match = i;
+		}
+	}
+	/* second press of a double-tap not labeled, a water drop: the first
+	 * one was answered */
+	for (i = 0u; act->gesture == GESTURE_DOUBLE_TAP && match == num_taps && i < num_taps; i++) {
+		if (!taps[i].hit && act->tick >= taps[i].first && act->tick <= taps[i].last + window) {
+			match = i;
+		}
+	}
+	if (match == num_taps) {
+		score->false_pos++;
+		if (verbose) {
+			printf("%s: tick %lu: false %s\n", path, (unsigned long)act->tick,
+			       act->gesture == GESTURE_LONG_PRESS ? "long-press" : "actuation");
+		}
+		return;
+	}
+	if (act->gesture == GESTURE_DOUBLE_TAP && match && !taps[match - 1u].hit
+	    && taps[match - 1u].last + window >= taps[match].first) {
+		hit(path, &taps[match - 1u], act->tick, score);
+	}
+	hit(path, &taps[match], act->tick, score);
+}
+
+/*============================================================================
+static int load_trace(const char *path, char *scenario)
+------------------------------------------------------------------------------
+Purpose: Reads the labels and the samples of a trace.
+Input  : trace file; destination of the scenario name
+Output : 0, -1 on errors (reported)
+Notes  : Fills taps and samples.
+============================================================================*/
+static int load_trace(const char *path, char *scenario)
+{
+	char     line[LINE_MAX_LEN], name[NAME_MAX_LEN];
+	char     columns[MAX_COLUMNS][NAME_MAX_LEN];
+	char *   fields[MAX_COLUMNS];
+	unsigned num_columns = 0u, lineno = 0u, count;
+	int      col_ts = -1, col_signal = -1, col_reference = -1;
+	uint32_t tick = 0u, prev_ts = 0u;
+	FILE *   f = fopen(path, "r");
+
+	strcpy(scenario, "-");
+	num_taps    = 0u;
+	num_samples = 0u;
+	burst.valid = 0;
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long a, b;
+
+		lineno++;
+		if (strncmp(line, "# tap", 5u) == 0) {
+			if (sscanf(line, "# tap %lu %lu", &a, &b) != 2 || a > b || num_taps == MAX_TAPS) {
+				fprintf(stderr, "%s:%u: invalid tap label\n", path, lineno);
+				fclose(f);
+				return -1;
+			}
+			taps[num_taps].first = (uint32_t)a;
+			taps[num_taps].last  = (uint32_t)b;
+			taps[num_taps].hit   = 0;
+			num_taps++;
+			continue;
+		}
+		if (strncmp(line, "# burst", 7u) == 0) {
+			if (sscanf(line, "# burst %lu %lu", &a, &b) != 2 || a > b || burst.valid) {
+				fprintf(stderr, "%s:%u: invalid burst label\n", path, lineno);
+				fclose(f);
+				return -1;
+			}
+			burst.first = (uint32_t)a;
+			burst.last  = (uint32_t)b;
+			burst.valid = 1;
+			continue;
+		}
+		if (line[0] == '#') {
+			sscanf(line, "# scenario %63s", scenario);
+			continue;
+		}
+		count = split(line, fields, MAX_COLUMNS);
+		if (!num_columns) {
+			for (num_columns = 0u; num_columns < count; num_columns++) {
+				snprintf(columns[num_columns], NAME_MAX_LEN, "%s", fields[num_columns]);
+			}
+			col_ts = find_column(columns, num_columns, "timestamp");
+			snprintf(name, sizeof(name), "ch%u_signal", channel);
+			col_signal = find_column(columns, num_columns, name);
+			snprintf(name, sizeof(name), "ch%u_reference", channel);
+			col_reference = find_column(columns, num_columns, name);
+			if (col_ts < 0 || col_signal < 0 || col_reference < 0) {
+				fprintf(stderr, "%s: no timestamp, ch%u_signal or ch%u_reference column\n", path, channel, channel);
+				fclose(f);
+				return -1;
+			}
+			continue;
+		}
+		if (count != num_columns) {
+			fprintf(stderr, "%s:%u: %u fields, header has %u\n", path, lineno, count, num_columns);
+			fclose(f);
+			return -1;
+		}
+		if (num_samples == MAX_SAMPLES) {
+			fprintf(stderr, "%s: more than %u samples\n", path, MAX_SAMPLES);
+			fclose(f);
+			return -1;
+		}
+
+		{
+			uint32_t ts    = (uint32_t)strtoul(fields[col_ts], NULL, 0);
+			uint16_t steps = (uint16_t)(ts - prev_ts);
+
+			/* the 16 bit timestamp wraps, a repeated one is the next tick */
+			if (!num_samples) {
+				tick = ts;
+				steps = 1u;
+			} else {
+				steps = steps ? steps : 1u;
+				tick += steps;
+			}
+			prev_ts = ts;
+			samples[num_samples].tick      = tick;
+			samples[num_samples].steps     = steps;
+			samples[num_samples].signal    = (uint16_t)strtoul(fields[col_signal], NULL, 0);
+			samples[num_samples].reference = (uint16_t)strtoul(fields[col_reference], NULL, 0);
+			num_samples++;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+/*============================================================================
+static void key_states(void)
+------------------------------------------------------------------------------
+Purpose: Key state of every loaded sample, a model of the debounce of
+         qtm_key_sensors_process().
+Input  : none
+Output : none
+Notes  : KEY_DET_INT more samples at key_threshold detect, as many below
+         the threshold less the hysteresis release. The release debounce
+         counts as KEY_DETECT, as in main.c.
+============================================================================*/
+static void key_states(void)
+{
+	const int16_t release = key_threshold - key_threshold * KEY_HYSTERESIS / 100;
+	uint8_t       state = KEY_QUIET, count = 0u;
+	unsigned      i;
+
+	for (i = 0u; i < num_samples; i++) {
+		int16_t delta = touch_detect_delta(samples[i].signal, samples[i].reference);
+
+		switch (state) {
+		case KEY_QUIET:
+			if (delta >= key_threshold) {
+				state = KEY_FILTER_IN;
+				count = 0u;
+			}
+			break;
+		case KEY_FILTER_IN:
+			if (delta < key_threshold) {
+				state = KEY_QUIET;
+			} else if (++count >= KEY_DET_INT) {
+				state = KEY_DETECT;
+				count = 0u;
+			}
+			break;
+		default:
+			if (delta >= release) {
+				count = 0u;
+			} else if (++count > KEY_DET_INT) {
+				state = KEY_QUIET;
+			}
+			break;
+		}
+		keys[i] = state;
+	}
+}
+
+/* Valve of main.c: Radiotube_Handle() with its edge freeze */
+static void valve_handle(void)
+{
+	valve.on ^= 1u;
+	if (!valve.on) {
+		valve.on_ticks = 0u;
+		valve.timed    = 0u;
+	}
+	touch_detect_freeze();
+}
+
+/* Auto close of RTC_CallBack(), after the ticks of the core and the
+ * gestures */
+static void valve_tick(void)
+{
+	if (valve.on && ++valve.on_ticks > (valve.timed ? TIMED_RUN_TICKS : AUTO_CLOSE_TICKS)) {
+		valve.on_ticks = 0u;
+		valve_handle();
+	}
+}
+
+/* Radiotube_Gesture(), returns 1 when the gesture is acted on */
+static int valve_gesture(uint8_t gesture)
+{
+	switch (gesture) {
+	case GESTURE_TAP:
+		if (valve.locked) {
+			return 0;
+		}
+		valve_handle();
+		return 1;
+	case GESTURE_DOUBLE_TAP:
+		if (valve.locked) {
+			return 0;
+		}
+		if (!valve.on) {
+			valve_handle();
+		}
+		valve.on_ticks = 0u;
+		valve.timed    = 1u;
+		return 1;
+	case GESTURE_LONG_PRESS:
+		valve.locked ^= 1u;
+		if (valve.locked && valve.on) {
+			valve_handle();
+		}
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*============================================================================
+static void replay(const char *path, score_t *score)
+------------------------------------------------------------------------------
+Purpose: Runs the loaded samples through the core, the gestures and the
+         valve the way main.c does and scores the gestures acted on and
+         the convergence after the burst.
+Input  : trace file, for the messages; score to fill
+Output : none
+Notes  : The RTC ticks come before the measurement. A valve pulse, of a
+         gesture or of the auto close, blanks the edges, the following
+         measurements end the blanking.
+============================================================================*/
+static void replay(const char *path, score_t *score)
+{
+	action_t actions[MAX_TAPS];
+	unsigned num_actions = 0u, i, n;
+	uint8_t  edge, result, gesture;
+	uint16_t before = 0u;
+	double   t0;
+
+	memset(score, 0, sizeof(*score));
+	score->converge_ms = burst.valid ? HUGE_VAL : -1.0;
+	restart();
+
+	t0 = now_ns();
+	for (i = 0u; i < num_samples; i++) {
+		for (n = samples[i].steps; n; n--) {
+			touch_detect_tick();
+			gesture_tick();
+			valve_tick();
+		}
+		score->samples++;
+		touch_detect_key(keys[i]);
+		results[i] = touch_detect_sample(samples[i].signal, samples[i].reference, &edges[i]);
+		helds[i]   = touch_detect_held();
+		gesture    = gesture_sample(edges[i], results[i], helds[i]);
+		if (valve_gesture(gesture) && num_actions < MAX_TAPS) {
+			actions[num_actions].tick    = samples[i].tick;
+			actions[num_actions].gesture = gesture;
+			num_actions++;
+		}
+	}
+	score->ns = now_ns() - t0;
+
+	/* the gestures on the same edges, timed on their own */
+	gesture_reset();
+	t0 = now_ns();
+	for (i = 0u; i < num_samples; i++) {
+		for (n = samples[i].steps; n; n--) {
+			gesture_tick();
+		}
+		score->gestures[gesture_sample(edges[i], results[i], helds[i])]++;
+	}
+	score->gesture_ns = now_ns() - t0;
+
+	/* second pass, the timed one stays free of the bookkeeping */
+	restart();
+	for (i = 0u; burst.valid && i < num_samples; i++) {
+		for (n = samples[i].steps; n; n--) {
+			touch_detect_tick();
+			gesture_tick();
+			valve_tick();
+		}
+		touch_detect_key(keys[i]);
+		result = touch_detect_sample(samples[i].signal, samples[i].reference, &edge);
+		valve_gesture(gesture_sample(edge, result, touch_detect_held()));
+		if (samples[i].tick < burst.first) {
+			before = STRONG_EDGE_THRESHOLD;
+		} else if (samples[i].tick > burst.last && STRONG_EDGE_THRESHOLD <= before + CONVERGE_MARGIN) {
+			score->converge_ms = (double)(samples[i].tick - burst.last) * RTC_WAKE_UP_TIME;
+			break;
+		}
+	}
+
+	score->taps = num_taps;
+	for (i = 0u; i < num_actions; i++) {
+		score_action(path, &actions[i], score);
+	}
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double percentile(unsigned pct)
+{
+	unsigned i;
+
+	if (!num_latencies) {
+		return 0.0;
+	}
+	i = (num_latencies * pct + 99u) / 100u;
+	return latencies[i ? i - 1u : 0u];
+}
+
+static double ratio(unsigned num, unsigned den)
+{
+	return den ? (double)num / den : 1.0;
+}
+
+static void print_score(const char *name, const char *scenario, const score_t *s)
+{
+	char converge[16];
+
+	if (s->converge_ms < 0.0) {
+		strcpy(converge, "-");
+	} else if (s->converge_ms == HUGE_VAL) {
+		strcpy(converge, "never");
+	} else {
+		snprintf(converge, sizeof(converge), "%.0f", s->converge_ms);
+	}
+	printf("%-28s %-14s %5u %5u %5u %5u  %9.3f %6.3f %9s\n",
+	       name,
+	       scenario,
+	       s->taps,
+	       s->hits,
+	       s->false_pos,
+	       s->taps - s->hits,
+	       ratio(s->hits, s->hits + s->false_pos),
+	       ratio(s->hits, s->taps),
+	       converge);
+}
+
+/* Reads the trace list of a corpus index, paths relative to the index */
+static int read_index(const char *index, char ***paths, unsigned *count)
+{
+	char        line[PATH_MAX_LEN], name[PATH_MAX_LEN];
+	const char *slash = strrchr(index, '/');
+	int         dir   = slash ? (int)(slash - index + 1) : 0;
+	FILE *      f     = fopen(index, "r");
+
+	if (!f) {
+		perror(index);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		char **grown;
+		size_t size;
+
+		if (sscanf(line, "%511s", name) != 1 || name[0] == '#') {
+			continue;
+		}
+		grown = realloc(*paths, (*count + 1u) * sizeof(**paths));
+		if (!grown) {
+			fclose(f);
+			return -1;
+		}
+		*paths           = grown;
+		size             = (size_t)dir + strlen(name) + 1u;
+		(*paths)[*count] = malloc(size);
+		if (!(*paths)[*count]) {
+			fclose(f);
+			return -1;
+		}
+		snprintf((*paths)[*count], size, "%.*s%s", dir, index, name);
+		(*count)++;
+	}
+	fclose(f);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	score_t     total, score;
+	char        scenario[NAME_MAX_LEN];
+	char **     paths     = NULL;
+	unsigned    num_paths = 0u, i, n;
+	double      min_precision = 0.0, min_recall = 0.0, max_converge = HUGE_VAL, precision, recall;
+	int         opt;
+
+	while ((opt = getopt(argc, argv, "c:k:P:R:C:l:v")) != -1) {
+		switch (opt) {
+		case 'c':
+			channel = (unsigned)atoi(optarg);
+			break;
+		case 'k':
+			key_threshold = (int16_t)atoi(optarg);
+			break;
+		case 'P':
+			min_precision = atof(optarg);
+			break;
+		case 'R':
+			min_recall = atof(optarg);
+			break;
+		case 'C':
+			max_converge = atof(optarg);
+			break;
+		case 'l':
+			if (read_index(optarg, &paths, &num_paths) != 0) {
+				return 2;
+			}
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			fprintf(stderr,
+			        "usage: tracescore [-c channel] [-k threshold] [-P precision] [-R recall] [-C ms] [-v] [-l corpus] "
+			        "trace...\n");
+			return 2;
+		}
+	}
+	for (; optind < argc; optind++) {
+		char **grown = realloc(paths, (num_paths + 1u) * sizeof(*paths));
+
+		if (!grown) {
+			return 2;
+		}
+		paths              = grown;
+		paths[num_paths++] = argv[optind];
+	}
+	if (!num_paths) {
+		fprintf(stderr, "tracescore: no traces\n");
+		return 2;
+	}
+
+	save_defaults();
+	memset(&total, 0, sizeof(total));
+	total.converge_ms = -1.0;
+	printf("%-28s %-14s %5s %5s %5s %5s  %9s %6s %9s\n", "trace", "scenario", "taps", "hits", "fp", "fn", "precision",
+	       "recall", "conv (ms)");
+	for (i = 0u; i < num_paths; i++) {
+		const char *name = strrchr(paths[i], '/');
+
+		if (load_trace(paths[i], scenario) != 0) {
+			return 2;
+		}
+		key_states();
+		replay(paths[i], &score);
+		print_score(name ? name + 1 : paths[i], scenario, &score);
+		total.taps += score.taps;
+		total.hits += score.hits;
+		total.false_pos += score.false_pos;
+		total.samples += score.samples;
+		total.ns += score.ns;
+		total.gesture_ns += score.gesture_ns;
+		for (n = 0u; n < 4u; n++) {
+			total.gestures[n] += score.gestures[n];
+		}
+		if (score.converge_ms > total.converge_ms) {
+			total.converge_ms = score.converge_ms;
+		}
+	}
+	print_score("total", "", &total);
+
+	qsort(latencies, num_latencies, sizeof(*latencies), compare_double);
+	printf("latency: median %.0f ms, p99 %.0f ms\n", percentile(50u), percentile(99u));
+	printf("%u samples, %.1f ns/sample (host)\n", total.samples, total.samples ? total.ns / total.samples : 0.0);
+	printf("gestures: %u tap, %u double-tap, %u long-press, %.1f ns/sample (host)\n", total.gestures[GESTURE_TAP],
+	       total.gestures[GESTURE_DOUBLE_TAP], total.gestures[GESTURE_LONG_PRESS],
+	       total.samples ? total.gesture_ns / total.samples : 0.0);
+
+	precision = ratio(total.hits, total.hits + total.false_pos);
+	recall    = ratio(total.hits, total.taps);
+	if (precision < min_precision || recall < min_recall) {
+		printf("below precision %.3f / recall %.3f\n", min_precision, min_recall);
+		return 1;
+	}
+	if (total.converge_ms > max_converge) {
+		printf("threshold converges slower than %.0f ms\n", max_converge);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,271 @@
+/*============================================================================
+Filename : main.c
+Project : Attiny814Code host tools
+Purpose : tscmd command line tool. Reads and writes the tuning parameters of
+          the firmware over the UART command channel.
+
+Usage   : tscmd [-d device] [-b baud] [-t timeout_ms] command [args]
+
+          ping                  protocol version and parameter count
+          list                  all parameters with their values
+          get <param>           one parameter, by name or id
+          set <param> <value>   write a parameter, prints the stored value
+          recal                 recalibrate the sensor
+          counters              receiver statistics and application counters
+          perf                  event counters since the last power cycle,
+                                a counter at 65535 has saturated
+          bench [n]             wake-up latency from standby and round trip
+                                time / throughput of n pings (default 100)
+
+          device defaults to $TSCMD_DEVICE, then /dev/ttyUSB0
+============================================================================*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tscmd.h"
+
+/* pings after a pause long enough for the device to enter standby */
+#define BENCH_COLD_PINGS 5
+#define BENCH_PAUSE_US 200000
+
+/* preamble + request + response of a ping */
+#define PING_WIRE_BYTES 15u
+
+static int  fd;
+static int  timeout_ms = 500;
+
+static void usage(void)
+{
+	fprintf(stderr,
+	        "usage: tscmd [-d device] [-b baud] [-t timeout_ms] ping|list|get <param>|set <param> <value>|recal|"
+	        "counters|perf|bench [n]\n");
+	exit(2);
+}
+
+/* Runs a request, exits on transport errors. Returns the device status. */
+static uint8_t request(uint8_t cmd, const uint8_t *payload, uint8_t len, tscmd_response_t *resp)
+{
+	int ret = tscmd_request(fd, cmd, payload, len, resp, timeout_ms);
+
+	if (ret == TSCMD_TIMEOUT) {
+		fprintf(stderr, "tscmd: no response\n");
+		exit(1);
+	}
+	if (ret != TSCMD_OK) {
+		fprintf(stderr, "tscmd: %s\n", strerror(errno));
+		exit(1);
+	}
+	return resp->status;
+}
+
+static int check(uint8_t status)
+{
+	if (status != CMD_STATUS_OK) {
+		fprintf(stderr, "tscmd: %s\n", tscmd_status_name(status));
+		return 1;
+	}
+	return 0;
+}
+
+static unsigned u16(const uint8_t *p)
+{
+	return p[0] | ((unsigned)p[1] << 8u);
+}
+
+static double now_ms(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec * 1e3 + (double)t.tv_nsec * 1e-6;
+}
+
+/* Returns the round trip time of a ping in ms, -1 without response */
+static double ping_ms(void)
+{
+	tscmd_response_t resp;
+	double           t0 = now_ms();
+
+	if (tscmd_request(fd, CMD_PING, NULL, 0u, &resp, timeout_ms) != TSCMD_OK || resp.status != CMD_STATUS_OK) {
+		return -1.0;
+	}
+	return now_ms() - t0;
+}
+
+static int bench(int n)
+{
+	double t, sum = 0.0, max = 0.0, t0;
+	int    i, lost = 0;
+
+	for (i = 0; i < BENCH_COLD_PINGS; i++) {
+		usleep(BENCH_PAUSE_US);
+		t = ping_ms();
+		if (t < 0.0) {
+			lost++;
+			continue;
+		}
+		printf("wake ping %d: %.2f ms\n", i, t);
+	}
+	if (lost) {
+		printf("wake pings without response: %d of %d\n", lost, BENCH_COLD_PINGS);
+	}
+
+	lost = 0;
+	t0   = now_ms();
+	for (i = 0; i < n; i++) {
+		t = ping_ms();
+		if (t < 0.0) {
+			lost++;
+			continue;
+		}
+		sum += t;
+		if (t > max) {
+			max = t;
+		}
+	}
+	t0 = now_ms() - t0;
+	if (lost == n) {
+		fprintf(stderr, "tscmd: no response\n");
+		return 1;
+	}
+	printf("%d pings, %d lost, round trip mean %.2f ms, max %.2f ms\n", n, lost, sum / (n - lost), max);
+	printf("%.1f requests/s, %.0f bytes/s on the wire\n",
+	       (n - lost) / t0 * 1e3,
+	       (double)(n - lost) * PING_WIRE_BYTES / t0 * 1e3);
+	return lost != 0;
+}
+
+static int param_arg(const char *name)
+{
+	int id = tscmd_param_lookup(name);
+
+	if (id < 0) {
+		fprintf(stderr, "tscmd: unknown parameter %s\n", name);
+		exit(2);
+	}
+	return id;
+}
+
+int main(int argc, char **argv)
+{
+	tscmd_response_t resp;
+	const char *     device = getenv("TSCMD_DEVICE");
+	long             baud   = 115200;
+	uint8_t          req[3];
+	int              opt, id;
+	unsigned         i;
+	char *           end;
+	long             value;
+
+	while ((opt = getopt(argc, argv, "d:b:t:")) != -1) {
+		switch (opt) {
+		case 'd':
+			device = optarg;
+			break;
+		case 'b':
+			baud = strtol(optarg, NULL, 10);
+			break;
+		case 't':
+			timeout_ms = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind >= argc) {
+		usage();
+	}
+	if (!device) {
+		device = "/dev/ttyUSB0";
+	}
+
+	fd = tscmd_open(device, baud);
+	if (fd < 0) {
+		fprintf(stderr, "tscmd: %s: %s\n", device, strerror(errno));
+		return 1;
+	}
+
+	argv += optind;
+	argc -= optind;
+
+	if (strcmp(argv[0], "ping") == 0 && argc == 1) {
+		if (check(request(CMD_PING, NULL, 0u, &resp)) || resp.len < 2u) {
+			return 1;
+		}
+		printf("protocol %u, %u parameters\n", resp.payload[0], resp.payload[1]);
+	} else if (strcmp(argv[0], "list") == 0 && argc == 1) {
+		for (i = 0u; i < PARAM_COUNT; i++) {
+			req[0] = (uint8_t)i;
+			if (check(request(CMD_PARAM_READ, req, 1u, &resp))) {
+				return 1;
+			}
+			printf("%-20s %u\n", tscmd_param_name((uint8_t)i), u16(resp.payload));
+		}
+	} else if (strcmp(argv[0], "get") == 0 && argc == 2) {
+		req[0] = (uint8_t)param_arg(argv[1]);
+		if (check(request(CMD_PARAM_READ, req, 1u, &resp))) {
+			return 1;
+		}
+		printf("%u\n", u16(resp.payload));
+	} else if (strcmp(argv[0], "set") == 0 && argc == 3) {
+		id    = param_arg(argv[1]);
+		value = strtol(argv[2], &end, 0);
+		if (*end || value < 0 || value > 0xFFFF) {
+			fprintf(stderr, "tscmd: bad value %s\n", argv[2]);
+			return 2;
+		}
+		req[0] = (uint8_t)id;
+		req[1] = (uint8_t)value;
+		req[2] = (uint8_t)(value >> 8);
+		if (check(request(CMD_PARAM_WRITE, req, 3u, &resp))) {
+			return 1;
+		}
+		printf("%u\n", u16(resp.payload));
+	} else if (strcmp(argv[0], "recal") == 0 && argc == 1) {
+		if (check(request(CMD_RECALIBRATE, NULL, 0u, &resp))) {
+			return 1;
+		}
+	} else if (strcmp(argv[0], "counters") == 0 && argc == 1) {
+		if (check(request(CMD_COUNTERS, NULL, 0u, &resp))) {
+			return 1;
+		}
+		for (i = 0u; i + 1u < resp.len; i += 2u) {
+			const char *name = tscmd_counter_name((uint8_t)(i / 2u));
+
+			if (name) {
+				printf("%-20s %u\n", name, u16(&resp.payload[i]));
+			} else {
+				printf("counter%-13u %u\n", i / 2u, u16(&resp.payload[i]));
+			}
+		}
+	} else if (strcmp(argv[0], "perf") == 0 && argc == 1) {
+		if (check(request(CMD_PERF, NULL, 0u, &resp))) {
+			return 1;
+		}
+		for (i = 0u; i + 1u < resp.len; i += 2u) {
+			const char *name = tscmd_perf_name((uint8_t)(i / 2u));
+
+			if (name) {
+				printf("%-20s %u\n", name, u16(&resp.payload[i]));
+			} else {
+				printf("perf%-16u %u\n", i / 2u, u16(&resp.payload[i]));
+			}
+		}
+	} else if (strcmp(argv[0], "bench") == 0 && argc <= 2) {
+		value = argc == 2 ? strtol(argv[1], &end, 0) : 100;
+		if ((argc == 2 && *end) || value <= 0) {
+			usage();
+		}
+		return bench((int)value);
+	} else {
+		usage();
+	}
+
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,190 @@
+/*============================================================================
+Filename : sim.c
+Project : Attiny814Code host tools
+Purpose : tscmd-sim, runs the firmware command channel (src/uart_command.c)
+          behind a pseudo terminal so tscmd can be used without hardware.
+          The parameter table mirrors the defaults of main.c.
+
+Usage   : tscmd-sim [-n] [-s]
+
+          -n  interleave random traffic with the responses, like the
+              datastreamer does on the real device
+          -s  model standby: a byte arriving while the receiver is idle
+              only wakes the device and is lost
+
+          Prints the pty path to connect to and serves until killed.
+============================================================================*/
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uart_command.h"
+
+/* RTC wake up period of the firmware */
+#define TICK_NS 32000000L
+
+static int master;
+static int noise;
+static int standby;
+
+/* simulated application state, defaults of main.c */
+static uint16_t edge_threshold     = 50;
+static uint8_t  noise_factor       = 6;
+static uint8_t  key_threshold      = 100;
+static uint16_t finger_on_min      = 70;
+static uint16_t finger_on_max      = 500;
+static uint16_t freeze_time        = 300;
+static uint16_t edge_threshold_min = 35;
+static uint16_t edge_threshold_max = 80;
+static uint8_t  noise_attack       = 2;
+static uint8_t  auto_close         = 3;
+static uint8_t  noise_release      = 4;
+static uint16_t double_tap_window  = 250;
+static uint16_t long_press         = 1500;
+static uint8_t  timed_run          = 30;
+static uint16_t recalibrations;
+static uint16_t sim_ticks;
+
+const cmd_param_t cmd_param_table[PARAM_COUNT] = {
+    [PARAM_EDGE_THRESHOLD]     = {&edge_threshold, 2, 0, 1023, 1},
+    [PARAM_NOISE_FACTOR]       = {&noise_factor, 1, 1, 16},
+    [PARAM_KEY_THRESHOLD]      = {&key_threshold, 1, 1, 255},
+    [PARAM_FINGER_ON_MIN]      = {&finger_on_min, 2, 0, 10000},
+    [PARAM_FINGER_ON_MAX]      = {&finger_on_max, 2, 0, 10000},
+    [PARAM_FREEZE_TIME]        = {&freeze_time, 2, 0, 10000},
+    [PARAM_EDGE_THRESHOLD_MIN] = {&edge_threshold_min, 2, 0, 1023},
+    [PARAM_EDGE_THRESHOLD_MAX] = {&edge_threshold_max, 2, 0, 1023},
+    [PARAM_NOISE_ATTACK]       = {&noise_attack, 1, 0, 7},
+    [PARAM_AUTO_CLOSE_TIME]    = {&auto_close, 1, 1, 60},
+    [PARAM_NOISE_RELEASE]      = {&noise_release, 1, 0, 10},
+    [PARAM_DOUBLE_TAP_WINDOW]  = {&double_tap_window, 2, 0, 8160},
+    [PARAM_LONG_PRESS_TIME]    = {&long_press, 2, 0, 8160},
+    [PARAM_TIMED_RUN_TIME]     = {&timed_run, 1, 1, 255},
+};
+
+void cmd_tx_byte(uint8_t data)
+{
+	if (write(master, &data, 1u) != 1) {
+		perror("tscmd-sim: write");
+		exit(1);
+	}
+}
+
+void cmd_recalibrate(void)
+{
+	recalibrations++;
+}
+
+uint8_t cmd_read_counters(uint16_t *counters, uint8_t max_counters)
+{
+	if (max_counters < COUNTER_COUNT) {
+		return 0u;
+	}
+	memset(counters, 0, COUNTER_COUNT * sizeof(*counters));
+	/* the simulator has no touches, report the recalibrations instead */
+	counters[COUNTER_TOUCHES]          = recalibrations;
+	counters[COUNTER_RADIOTUBE_STATE]  = 1u;
+	counters[COUNTER_NOISE_LEVEL]      = (uint16_t)(edge_threshold / noise_factor);
+	counters[COUNTER_RESIDENCY_ACTIVE] = sim_ticks;
+	return COUNTER_COUNT;
+}
+
+static void send_noise(void)
+{
+	/* SOF bytes of both protocols to exercise the resync of the host */
+	static const uint8_t sofs[] = {0xA5u, CMD_RESPONSE_SOF, CMD_REQUEST_SOF};
+	unsigned             n      = (unsigned)rand() % 16u;
+
+	while (n--) {
+		cmd_tx_byte(rand() % 4 ? (uint8_t)rand() : sofs[(unsigned)rand() % sizeof(sofs)]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct termios  tio;
+	struct timespec tick;
+	uint8_t         buf[256];
+	ssize_t         n, i;
+	int             opt;
+
+	while ((opt = getopt(argc, argv, "ns")) != -1) {
+		switch (opt) {
+		case 'n':
+			noise = 1;
+			break;
+		case 's':
+			standby = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: tscmd-sim [-n] [-s]\n");
+			return 2;
+		}
+	}
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+		perror("tscmd-sim: pty");
+		return 1;
+	}
+	if (tcgetattr(master, &tio) == 0) {
+		cfmakeraw(&tio);
+		tcsetattr(master, TCSANOW, &tio);
+	}
+	printf("%s\n", ptsname(master));
+	fflush(stdout);
+
+	cmd_init();
+	clock_gettime(CLOCK_MONOTONIC, &tick);
+	for (;;) {
+		struct timeval  tv = {0, 20000};
+		struct timespec now;
+		fd_set          rd;
+
+		FD_ZERO(&rd);
+		FD_SET(master, &rd);
+		n = select(master + 1, &rd, NULL, NULL, &tv);
+		if (n < 0 && errno != EINTR) {
+			perror("tscmd-sim: select");
+			return 1;
+		}
+		/* measurement period of the firmware */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((now.tv_sec - tick.tv_sec) * 1000000000L + (now.tv_nsec - tick.tv_nsec) >= TICK_NS) {
+			tick = now;
+			cmd_tick();
+			sim_ticks++;
+		}
+		if (noise) {
+			send_noise();
+		}
+		if (n <= 0) {
+			continue;
+		}
+		n = read(master, buf, sizeof(buf));
+		if (n <= 0) {
+			/* no client connected to the slave side yet */
+			usleep(20000);
+			continue;
+		}
+		for (i = 0; i < n; i++) {
+			if (standby && !cmd_rx_busy()) {
+				/* the byte woke the device and was lost, the line is active now */
+				cmd_rx_byte(CMD_WAKE_PREAMBLE);
+				continue;
+			}
+			cmd_rx_byte(buf[i]);
+			cmd_process();
+		}
+	}
+}
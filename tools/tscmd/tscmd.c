@@ -0,0 +1,350 @@
+/*============================================================================
+Filename : tscmd.c
+Project : Attiny814Code host tools
+Purpose : Host side of the UART command channel.
+============================================================================*/
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tscmd.h"
+#include "datastreamer_frame.h"
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* SOF LEN CMD STATUS payload CRC */
+#define RESPONSE_MAX_SIZE (CMD_MAX_LEN + 4u)
+
+/*----------------------------------------------------------------------------
+ *     global variables
+ *----------------------------------------------------------------------------*/
+static const char *param_names[PARAM_COUNT] = {
+    [PARAM_EDGE_THRESHOLD]     = "edge_threshold",
+    [PARAM_NOISE_FACTOR]       = "noise_factor",
+    [PARAM_KEY_THRESHOLD]      = "key_threshold",
+    [PARAM_FINGER_ON_MIN]      = "finger_on_min_ms",
+    [PARAM_FINGER_ON_MAX]      = "finger_on_max_ms",
+    [PARAM_FREEZE_TIME]        = "freeze_time_ms",
+    [PARAM_EDGE_THRESHOLD_MIN] = "edge_threshold_min",
+    [PARAM_EDGE_THRESHOLD_MAX] = "edge_threshold_max",
+    [PARAM_NOISE_ATTACK]       = "noise_attack_shift",
+    [PARAM_AUTO_CLOSE_TIME]    = "auto_close_min",
+    [PARAM_NOISE_RELEASE]      = "noise_release_shift",
+    [PARAM_DOUBLE_TAP_WINDOW]  = "double_tap_window_ms",
+    [PARAM_LONG_PRESS_TIME]    = "long_press_ms",
+    [PARAM_TIMED_RUN_TIME]     = "timed_run_s",
+};
+
+/* receiver statistics first, then the application counters */
+static const char *counter_names[3u + COUNTER_COUNT] = {
+    "cmd_frames",
+    "cmd_crc_errors",
+    "cmd_overruns",
+    [3u + COUNTER_TOUCHES]            = "touches",
+    [3u + COUNTER_FALSE_TOUCHES]      = "false_touches",
+    [3u + COUNTER_ERROR_CODE]         = "error_code",
+    [3u + COUNTER_LOW_BATTERY]        = "low_battery",
+    [3u + COUNTER_SENSOR_STATE]       = "sensor_state",
+    [3u + COUNTER_RADIOTUBE_STATE]    = "radiotube_state",
+    [3u + COUNTER_NOISE_LEVEL]        = "noise_level",
+    [3u + COUNTER_RESIDENCY_ACTIVE]   = "ticks_active",
+    [3u + COUNTER_RESIDENCY_IDLE]     = "ticks_idle",
+    [3u + COUNTER_RESIDENCY_STANDBY]  = "ticks_standby",
+    [3u + COUNTER_RESIDENCY_PWR_DOWN] = "ticks_power_down",
+    [3u + COUNTER_STACK_PEAK]         = "stack_peak",
+};
+
+/* event counters of CMD_PERF */
+static const char *perf_names[PERF_COUNT] = {
+    [PERF_WAKES]           = "wakes",
+    [PERF_ACQUISITIONS]    = "acquisitions",
+    [PERF_REBURSTS]        = "rebursts",
+    [PERF_QTM_ERRORS]      = "qtm_errors",
+    [PERF_EDGES_RISING]    = "edges_rising",
+    [PERF_EDGES_FALLING]   = "edges_falling",
+    [PERF_THRESHOLD_UP]    = "threshold_up",
+    [PERF_THRESHOLD_DOWN]  = "threshold_down",
+    [PERF_TOUCH_TOO_SHORT] = "touches_too_short",
+    [PERF_TOUCH_TOO_LONG]  = "touches_too_long",
+    [PERF_ACTUATIONS]      = "actuations",
+    [PERF_BATTERY_CHECKS]  = "battery_checks",
+    [PERF_WDT_RESETS]      = "watchdog_resets",
+    [PERF_DS_FRAMES]       = "datastreamer_frames",
+};
+
+/*----------------------------------------------------------------------------
+ *   function definitions
+ *----------------------------------------------------------------------------*/
+
+static speed_t baud_to_speed(long baud)
+{
+	switch (baud) {
+	case 9600:
+		return B9600;
+	case 19200:
+		return B19200;
+	case 38400:
+		return B38400;
+	case 57600:
+		return B57600;
+	case 115200:
+		return B115200;
+	case 230400:
+		return B230400;
+	default:
+		return B0;
+	}
+}
+
+/*============================================================================
+int tscmd_open(const char *device, long baud)
+------------------------------------------------------------------------------
+Purpose: Opens a serial device or pty in raw mode.
+Output : file descriptor, -1 on error (errno set)
+============================================================================*/
+int tscmd_open(const char *device, long baud)
+{
+	struct termios tio;
+	speed_t        speed = baud_to_speed(baud);
+	int            fd;
+
+	if (speed == B0) {
+		errno = EINVAL;
+		return -1;
+	}
+	fd = open(device, O_RDWR | O_NOCTTY);
+	if (fd < 0) {
+		return -1;
+	}
+	if (isatty(fd)) {
+		if (tcgetattr(fd, &tio) != 0) {
+			close(fd);
+			return -1;
+		}
+		cfmakeraw(&tio);
+		cfsetispeed(&tio, speed);
+		cfsetospeed(&tio, speed);
+		tio.c_cc[VMIN]  = 1;
+		tio.c_cc[VTIME] = 0;
+		if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+			close(fd);
+			return -1;
+		}
+		tcflush(fd, TCIFLUSH);
+	}
+	return fd;
+}
+
+static int write_all(int fd, const uint8_t *data, size_t len)
+{
+	while (len) {
+		ssize_t n = write(fd, data, len);
+
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		data += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+static long elapsed_ms(const struct timespec *t0)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (long)(t.tv_sec - t0->tv_sec) * 1000 + (t.tv_nsec - t0->tv_nsec) / 1000000;
+}
+
+/* Looks for a response to cmd at the start of buf. Returns the bytes to
+ * drop from buf, 0 if more bytes are needed. resp->cmd is set on a match. */
+static size_t scan_response(const uint8_t *buf, size_t fill, uint8_t cmd, tscmd_response_t *resp)
+{
+	uint16_t crc;
+	size_t   size, i;
+
+	if (buf[0] != CMD_RESPONSE_SOF) {
+		return 1u;
+	}
+	if (fill < 2u) {
+		return 0u;
+	}
+	if (buf[1] < 2u || buf[1] > CMD_MAX_LEN) {
+		return 1u;
+	}
+	size = (size_t)buf[1] + 4u;
+	if (fill < size) {
+		return 0u;
+	}
+	crc = DS_CRC16_INIT;
+	for (i = 1u; i < size - 2u; i++) {
+		crc = ds_crc16_update(crc, buf[i]);
+	}
+	/* a SOF inside other traffic: resync one byte later */
+	if (buf[size - 2u] != (uint8_t)crc || buf[size - 1u] != (uint8_t)(crc >> 8u)) {
+		return 1u;
+	}
+	/* a stale response of an earlier request is dropped */
+	if (buf[2] == (cmd | CMD_RESPONSE_FLAG)) {
+		resp->cmd    = cmd;
+		resp->status = buf[3];
+		resp->len    = (uint8_t)(buf[1] - 2u);
+		memcpy(resp->payload, &buf[4], resp->len);
+	}
+	return size;
+}
+
+/*============================================================================
+int tscmd_request(int fd, uint8_t cmd, const uint8_t *payload, uint8_t len,
+                  tscmd_response_t *resp, int timeout_ms)
+------------------------------------------------------------------------------
+Purpose: Sends a request and waits for its response.
+Input  : device; command; request payload and its length; response
+         destination; timeout
+Output : TSCMD_OK, TSCMD_IO_ERROR or TSCMD_TIMEOUT
+Notes  : The device status of the response is in resp->status.
+============================================================================*/
+int tscmd_request(int fd, uint8_t cmd, const uint8_t *payload, uint8_t len, tscmd_response_t *resp, int timeout_ms)
+{
+	uint8_t         req[CMD_MAX_LEN + 5u];
+	uint8_t         buf[2u * RESPONSE_MAX_SIZE];
+	size_t          fill = 0u, drop;
+	uint16_t        crc;
+	uint8_t         i;
+	struct timespec t0;
+
+	if (len + 1u > CMD_MAX_LEN) {
+		errno = EINVAL;
+		return TSCMD_IO_ERROR;
+	}
+
+	/* the preamble wakes the device from standby and may be lost */
+	req[0] = CMD_WAKE_PREAMBLE;
+	req[1] = CMD_REQUEST_SOF;
+	req[2] = (uint8_t)(len + 1u);
+	req[3] = cmd;
+	if (len) {
+		memcpy(&req[4], payload, len);
+	}
+	crc = DS_CRC16_INIT;
+	for (i = 2u; i < len + 4u; i++) {
+		crc = ds_crc16_update(crc, req[i]);
+	}
+	req[len + 4u] = (uint8_t)crc;
+	req[len + 5u] = (uint8_t)(crc >> 8u);
+
+	if (write_all(fd, req, len + 6u) != 0) {
+		return TSCMD_IO_ERROR;
+	}
+
+	resp->cmd = 0u;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (;;) {
+		struct timeval tv;
+		fd_set         rd;
+		long           left = timeout_ms - elapsed_ms(&t0);
+		ssize_t        n;
+
+		if (left <= 0) {
+			return TSCMD_TIMEOUT;
+		}
+		FD_ZERO(&rd);
+		FD_SET(fd, &rd);
+		tv.tv_sec  = left / 1000;
+		tv.tv_usec = (left % 1000) * 1000;
+		n          = select(fd + 1, &rd, NULL, NULL, &tv);
+		if (n < 0 && errno != EINTR) {
+			return TSCMD_IO_ERROR;
+		}
+		if (n <= 0) {
+			continue;
+		}
+		n = read(fd, &buf[fill], sizeof(buf) - fill);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return TSCMD_IO_ERROR;
+		}
+		if (n == 0) {
+			return TSCMD_IO_ERROR;
+		}
+		fill += (size_t)n;
+
+		while (fill && (drop = scan_response(buf, fill, cmd, resp)) != 0u) {
+			memmove(buf, &buf[drop], fill - drop);
+			fill -= drop;
+			if (resp->cmd == cmd) {
+				return TSCMD_OK;
+			}
+		}
+	}
+}
+
+const char *tscmd_param_name(uint8_t id)
+{
+	return id < PARAM_COUNT ? param_names[id] : NULL;
+}
+
+/* Returns the parameter id of a name or number, -1 if unknown */
+int tscmd_param_lookup(const char *name)
+{
+	char *end;
+	long  id;
+	int   i;
+
+	for (i = 0; i < (int)PARAM_COUNT; i++) {
+		if (strcmp(name, param_names[i]) == 0) {
+			return i;
+		}
+	}
+	id = strtol(name, &end, 0);
+	if (*name && !*end && id >= 0 && id < (long)PARAM_COUNT) {
+		return (int)id;
+	}
+	return -1;
+}
+
+const char *tscmd_counter_name(uint8_t index)
+{
+	return index < 3u + COUNTER_COUNT ? counter_names[index] : NULL;
+}
+
+const char *tscmd_perf_name(uint8_t index)
+{
+	return index < PERF_COUNT ? perf_names[index] : NULL;
+}
+
+const char *tscmd_status_name(uint8_t status)
+{
+	switch (status) {
+	case CMD_STATUS_OK:
+		return "ok";
+	case CMD_STATUS_UNKNOWN_CMD:
+		return "unknown command";
+	case CMD_STATUS_BAD_LENGTH:
+		return "bad length";
+	case CMD_STATUS_BAD_PARAM:
+		return "unknown parameter";
+	case CMD_STATUS_OUT_OF_RANGE:
+		return "value out of range";
+	case CMD_STATUS_READ_ONLY:
+		return "read-only parameter";
+	default:
+		return "unknown status";
+	}
+}
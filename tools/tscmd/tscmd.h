@@ -0,0 +1,56 @@
+/*============================================================================
+Filename : tscmd.h
+Project : Attiny814Code host tools
+Purpose : Host side of the UART command channel defined in
+          include/uart_command.h. Sends requests over a serial device and
+          picks the responses out of the byte stream, skipping datastreamer
+          frames and other traffic.
+============================================================================*/
+
+#ifndef TSCMD_H
+#define TSCMD_H
+
+#include <stdint.h>
+
+#include "uart_command.h"
+#include "perf_counter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*----------------------------------------------------------------------------
+ *     defines
+ *----------------------------------------------------------------------------*/
+/* tscmd_request() results */
+#define TSCMD_OK 0
+#define TSCMD_IO_ERROR -1
+#define TSCMD_TIMEOUT -2
+
+/*----------------------------------------------------------------------------
+ *     type definitions
+ *----------------------------------------------------------------------------*/
+typedef struct {
+	uint8_t cmd;
+	uint8_t status;
+	uint8_t len; /* payload bytes */
+	uint8_t payload[CMD_MAX_LEN];
+} tscmd_response_t;
+
+/*----------------------------------------------------------------------------
+ *   prototypes
+ *----------------------------------------------------------------------------*/
+int         tscmd_open(const char *device, long baud);
+int         tscmd_request(int fd, uint8_t cmd, const uint8_t *payload, uint8_t len, tscmd_response_t *resp,
+                          int timeout_ms);
+const char *tscmd_param_name(uint8_t id);
+int         tscmd_param_lookup(const char *name);
+const char *tscmd_counter_name(uint8_t index);
+const char *tscmd_perf_name(uint8_t index);
+const char *tscmd_status_name(uint8_t status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TSCMD_H */